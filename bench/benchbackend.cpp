@@ -0,0 +1,145 @@
+#include "../src/answercache.h"
+#include "../src/backend.h"
+#include "../src/logger.h"
+#include "../src/stats.h"
+#include "common.h"
+
+#include "benchmark/benchmark.h"
+
+#include <chrono>
+#include <string>
+
+static void BM_Split(benchmark::State& state)
+{
+    const std::string line{"Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1\t10.1.1.1\t0.0.0.0/0"};
+    for (auto _ : state)
+    {
+        auto parts = cppbackend::Backend::split(line, '\t');
+        benchmark::DoNotOptimize(parts);
+    }
+}
+BENCHMARK(BM_Split);
+
+static void BM_FormatResponse(benchmark::State& state)
+{
+    const std::string qname{"2.canberra.testnet"};
+    const std::string qclass{"IN"};
+    const std::string id{"1"};
+    const std::string data{"W2JvYl0gMzM="};
+    const auto abiVersion = static_cast<int>(state.range(0));
+    for (auto _ : state)
+    {
+        auto response = cppbackend::Backend::formatResponse(qname, qclass, id, data, abiVersion);
+        benchmark::DoNotOptimize(response);
+    }
+}
+BENCHMARK(BM_FormatResponse)->DenseRange(1, 3)->ArgName("abi");
+
+static void performQuery(benchmark::State& state, const std::string& qname, bool expected)
+{
+    cppbackend::Backend backend(DB_PATH);
+    std::string output{};
+    for (auto _ : state)
+    {
+        output.clear();
+        const bool result = backend.performQuery(qname, output);
+        if (result != expected)
+        {
+            state.SkipWithError("Unexpected query result");
+            break;
+        }
+        benchmark::DoNotOptimize(output);
+    }
+}
+
+static void BM_PerformQueryHit(benchmark::State& state)
+{
+    performQuery(state, "2.canberra.testnet", true);
+}
+BENCHMARK(BM_PerformQueryHit);
+
+// What a repeated query costs instead of performQuery and formatResponse,
+// from all benchmark threads into one cache of 16 shards
+static void BM_AnswerCacheHit(benchmark::State& state)
+{
+    static cppbackend::Stats stats;
+    static cppbackend::AnswerCache cache(stats);
+    const std::string qname{"2.canberra" + std::to_string(state.thread_index()) + ".testnet"};
+    const auto line = cppbackend::Backend::formatResponse(qname, "IN", "1", "W2JvYl0gMzM=", 3);
+    cache.insert(qname, "IN", 3, line, line.size() - 16, 1, 3600, false, cppbackend::AnswerCache::Clock::now());
+
+    std::string output{};
+    bool timeBased = false;
+    for (auto _ : state)
+    {
+        if (!cache.find(qname, "IN", 3, "4711", cppbackend::AnswerCache::Clock::now(), output, timeBased))
+        {
+            state.SkipWithError("Answer not cached");
+            break;
+        }
+        benchmark::DoNotOptimize(output);
+    }
+}
+BENCHMARK(BM_AnswerCacheHit)->ThreadRange(1, 8);
+
+static void BM_PerformQueryEpochHit(benchmark::State& state)
+{
+    performQuery(state, "2.canberra.oc.testnet", true);
+}
+BENCHMARK(BM_PerformQueryEpochHit);
+
+static void BM_PerformQueryMiss(benchmark::State& state)
+{
+    performQuery(state, "2.invalid.testnet", false);
+}
+BENCHMARK(BM_PerformQueryMiss);
+
+static void BM_PerformQueryMalformed(benchmark::State& state)
+{
+    performQuery(state, "2.canberra.com.au.testnet", false);
+}
+BENCHMARK(BM_PerformQueryMalformed);
+
+static void BM_PerformQueryInvalidPlatform(benchmark::State& state)
+{
+    performQuery(state, "invalid.canberra.testnet", false);
+}
+BENCHMARK(BM_PerformQueryInvalidPlatform);
+
+static void logReceived(benchmark::State& state, cppbackend::LogLevel level)
+{
+    // Rate limit off and a sink that discards, so this is the cost on the query thread
+    cppbackend::Logger logger([](const std::string&) {}, cppbackend::LogLevel::INFO, 0);
+    const std::string line{"Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1"};
+    for (auto _ : state)
+    {
+        logger.log(level, cppbackend::LogCategory::QUERY, "Received '{}'", line);
+    }
+    state.counters["dropped"] = static_cast<double>(logger.getDropped());
+}
+
+static void BM_LogDisabled(benchmark::State& state)
+{
+    logReceived(state, cppbackend::LogLevel::DEBUG);
+}
+BENCHMARK(BM_LogDisabled);
+
+static void BM_LogEnabled(benchmark::State& state)
+{
+    logReceived(state, cppbackend::LogLevel::INFO);
+}
+BENCHMARK(BM_LogEnabled);
+
+// What every query pays for its stats: two clock reads and the relaxed adds,
+// here from all benchmark threads into one Stats as in a threaded backend
+static void BM_StatsRecordQuery(benchmark::State& state)
+{
+    static cppbackend::Stats stats;
+    for (auto _ : state)
+    {
+        const auto started = std::chrono::steady_clock::now();
+        stats.recordQuery(3, cppbackend::QueryClass::HIT, cppbackend::QueryResult::DATA,
+                          std::chrono::steady_clock::now() - started);
+    }
+}
+BENCHMARK(BM_StatsRecordQuery)->ThreadRange(1, 8);
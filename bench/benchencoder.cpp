@@ -0,0 +1,165 @@
+#include "../src/aes128block.h"
+#include "../src/base64/base64.h"
+#include "../src/base64encoder.h"
+#include "../src/encoder.h"
+
+#include "benchmark/benchmark.h"
+
+#include <string>
+#include <vector>
+
+using Implementation = cppbackend::Base64Encoder::Implementation;
+
+static void BM_ToBase64(benchmark::State& state)
+{
+    const std::string original(static_cast<std::size_t>(state.range(0)), 'x');
+    for (auto _ : state)
+    {
+        auto encoded = cppbackend::Encoder::toBase64(original);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ToBase64)->RangeMultiplier(4)->Range(16, 4096);
+
+// The table driven encoder Encoder::toBase64 used before Base64Encoder
+static void BM_Base64Reference(benchmark::State& state)
+{
+    const std::string original(static_cast<std::size_t>(state.range(0)), 'x');
+    for (auto _ : state)
+    {
+        auto encoded = base64_encode(original);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Base64Reference)->RangeMultiplier(4)->Range(16, 4096);
+
+static void base64Implementation(benchmark::State& state, Implementation implementation)
+{
+    if (!cppbackend::Base64Encoder::isSupported(implementation))
+    {
+        state.SkipWithError("Not supported on this CPU");
+        return;
+    }
+
+    const std::string original(static_cast<std::size_t>(state.range(0)), 'x');
+    std::string encoded(cppbackend::Base64Encoder::encodedLength(original.size()), '\0');
+    const auto* in = reinterpret_cast<const unsigned char*>(original.data());
+
+    for (auto _ : state)
+    {
+        switch (implementation)
+        {
+            case Implementation::SCALAR:
+                cppbackend::Base64Encoder::encodeScalar(in, original.size(), &encoded[0]);
+                break;
+            case Implementation::SSSE3:
+                cppbackend::Base64Encoder::encodeSSSE3(in, original.size(), &encoded[0]);
+                break;
+            case Implementation::AVX2:
+                cppbackend::Base64Encoder::encodeAVX2(in, original.size(), &encoded[0]);
+                break;
+        }
+        benchmark::DoNotOptimize(encoded.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_Base64Scalar(benchmark::State& state)
+{
+    base64Implementation(state, Implementation::SCALAR);
+}
+BENCHMARK(BM_Base64Scalar)->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_Base64SSSE3(benchmark::State& state)
+{
+    base64Implementation(state, Implementation::SSSE3);
+}
+BENCHMARK(BM_Base64SSSE3)->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_Base64AVX2(benchmark::State& state)
+{
+    base64Implementation(state, Implementation::AVX2);
+}
+BENCHMARK(BM_Base64AVX2)->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_ToAES128(benchmark::State& state)
+{
+    // Same shape as the .oc.testnet answer: a 10 digit epoch
+    const std::string original{"1600000000"};
+    const std::string password{"SECRET_PASS*****"};
+    for (auto _ : state)
+    {
+        auto encrypted = cppbackend::Encoder::toAES128(original, password);
+        benchmark::DoNotOptimize(encrypted);
+    }
+}
+BENCHMARK(BM_ToAES128);
+
+static void aes128Block(benchmark::State& state, cppbackend::AES128Block::Implementation implementation)
+{
+    if (!cppbackend::AES128Block::isSupported(implementation))
+    {
+        state.SkipWithError("Not supported on this CPU");
+        return;
+    }
+
+    // Includes the base64 step, so this compares directly with BM_ToAES128
+    const std::string original{"1600000000"};
+    const cppbackend::AES128Block cipher("SECRET_PASS*****", implementation);
+    for (auto _ : state)
+    {
+        auto encrypted = cppbackend::Encoder::toAES128(original, cipher);
+        benchmark::DoNotOptimize(encrypted);
+    }
+}
+
+static void BM_AES128BlockCryptoPP(benchmark::State& state)
+{
+    aes128Block(state, cppbackend::AES128Block::Implementation::CRYPTOPP);
+}
+BENCHMARK(BM_AES128BlockCryptoPP);
+
+static void BM_AES128BlockAESNI(benchmark::State& state)
+{
+    aes128Block(state, cppbackend::AES128Block::Implementation::AESNI);
+}
+BENCHMARK(BM_AES128BlockAESNI);
+
+static void aes128Batch(benchmark::State& state, cppbackend::AES128Block::Implementation implementation)
+{
+    if (!cppbackend::AES128Block::isSupported(implementation))
+    {
+        state.SkipWithError("Not supported on this CPU");
+        return;
+    }
+
+    // A burst of distinct epochs; the rate counter gives ns per token
+    std::vector<std::string> plaintexts{};
+    for (int64_t i = 0; i < state.range(0); ++i)
+    {
+        plaintexts.push_back(std::to_string(1600000000 + i));
+    }
+    const cppbackend::AES128Block cipher("SECRET_PASS*****", implementation);
+    std::string arena{};
+    for (auto _ : state)
+    {
+        cppbackend::Encoder::toAES128Batch(plaintexts.data(), plaintexts.size(), cipher, arena);
+        benchmark::DoNotOptimize(arena.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_AES128BatchCryptoPP(benchmark::State& state)
+{
+    aes128Batch(state, cppbackend::AES128Block::Implementation::CRYPTOPP);
+}
+BENCHMARK(BM_AES128BatchCryptoPP)->RangeMultiplier(2)->Range(1, 64);
+
+static void BM_AES128BatchAESNI(benchmark::State& state)
+{
+    aes128Batch(state, cppbackend::AES128Block::Implementation::AESNI);
+}
+BENCHMARK(BM_AES128BatchAESNI)->RangeMultiplier(2)->Range(1, 64);
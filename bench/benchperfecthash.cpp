@@ -0,0 +1,223 @@
+// PerfectHash against std::unordered_map over 10^6 (domain, platform) keys,
+// the key space of a snapshot of a 10^6 row database
+
+#include "../src/perfecthash.h"
+#include "databasegenerator.h"
+
+#include "benchmark/benchmark.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using cppbackend::DatabaseGenerator;
+using cppbackend::PerfectHash;
+
+namespace {
+    constexpr std::size_t KEYS = 1000000;
+    constexpr std::size_t LOOKUPS = 1 << 16;
+
+    struct Key {
+        std::string domain;
+        int platform;
+        // domain and platform in one string, for the map
+        std::string joined;
+    };
+
+    Key makeKey(std::size_t domain, int platform)
+    {
+        auto name = DatabaseGenerator::domainName(domain);
+        auto joined = name + '\0' + std::to_string(platform);
+        return Key{std::move(name), platform, std::move(joined)};
+    }
+
+    const std::vector<Key>& keys()
+    {
+        static const auto all = [] {
+            std::vector<Key> result{};
+            result.reserve(KEYS);
+            for (std::size_t domain = 0; result.size() < KEYS; ++domain)
+            {
+                for (int platform = 1; platform <= DatabaseGenerator::PLATFORMS && result.size() < KEYS; ++platform)
+                {
+                    result.push_back(makeKey(domain, platform));
+                }
+            }
+            return result;
+        }();
+        return all;
+    }
+
+    // Random keys in or out of the set, made before timing starts
+    std::vector<Key> lookups(bool present)
+    {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<std::size_t> index(0, KEYS - 1);
+        std::vector<Key> result{};
+        for (std::size_t i = 0; i < LOOKUPS; ++i)
+        {
+            const auto& key = keys()[index(random)];
+            result.push_back(present ? key : makeKey(KEYS + i, key.platform));
+        }
+        return result;
+    }
+
+    std::uint64_t keySeed(std::uint64_t seed, int platform)
+    {
+        return seed + (static_cast<std::uint64_t>(static_cast<std::uint32_t>(platform)) + 1) * 0xD6E8FEB86659FD93ULL;
+    }
+
+    // The snapshot's layout: records in slot order, each with the fingerprint
+    // of its key, pointing into one string arena
+    struct PerfectHashIndex {
+        struct Record {
+            std::uint32_t fingerprint;
+            std::uint32_t domainOffset;
+            std::uint32_t domainLength;
+            std::int32_t platform;
+        };
+
+        PerfectHash::Table table{};
+        std::vector<Record> records{};
+        std::string domains{};
+
+        PerfectHashIndex()
+        {
+            const auto& all = keys();
+            const auto hashOf = [&all](std::size_t index, std::uint64_t seed) {
+                return PerfectHash::hash(all[index].domain, keySeed(seed, all[index].platform));
+            };
+            table = PerfectHash::build(all.size(), hashOf);
+            records.resize(all.size());
+            for (std::size_t i = 0; i < all.size(); ++i)
+            {
+                const auto slot = table.slots[i];
+                records[slot] = Record{PerfectHash::fingerprint(hashOf(i, table.seed)),
+                                       static_cast<std::uint32_t>(domains.size()),
+                                       static_cast<std::uint32_t>(all[i].domain.size()), all[i].platform};
+                domains += all[i].domain;
+            }
+        }
+
+        [[nodiscard]] const Record* find(std::string_view domain, int platform) const
+        {
+            const auto hash = PerfectHash::hash(domain, keySeed(table.seed, platform));
+            const auto slot = PerfectHash::slot(hash, static_cast<std::uint32_t>(records.size()),
+                                                table.displacements.data(),
+                                                static_cast<std::uint32_t>(table.displacements.size()));
+            const auto& record = records[slot];
+            if (record.fingerprint != PerfectHash::fingerprint(hash))
+            {
+                return nullptr;
+            }
+            return record.platform == platform &&
+                   std::string_view(domains.data() + record.domainOffset, record.domainLength) == domain
+                   ? &record : nullptr;
+        }
+
+        // Displacements and fingerprints; the rest of the records and the
+        // strings are what a snapshot stores anyway
+        [[nodiscard]] std::size_t indexBytes() const
+        {
+            return (table.displacements.size() + records.size()) * sizeof(std::uint32_t);
+        }
+    };
+
+    // Keyed by the joined strings of keys(), mapping to the key's index
+    using KeyMap = std::unordered_map<std::string_view, std::uint32_t>;
+
+    KeyMap buildMap()
+    {
+        KeyMap map{};
+        map.reserve(KEYS);
+        const auto& all = keys();
+        for (std::size_t i = 0; i < all.size(); ++i)
+        {
+            map.emplace(all[i].joined, static_cast<std::uint32_t>(i));
+        }
+        return map;
+    }
+
+    // libstdc++ node: next pointer, the value and the cached hash, plus the bucket array
+    std::size_t mapBytes(const KeyMap& map)
+    {
+        return map.size() * (sizeof(void*) + sizeof(KeyMap::value_type) + sizeof(std::size_t)) +
+               map.bucket_count() * sizeof(void*);
+    }
+}
+
+static void BM_PerfectHashBuild(benchmark::State& state)
+{
+    keys();
+    for (auto _ : state)
+    {
+        PerfectHashIndex index{};
+        benchmark::DoNotOptimize(index.records.data());
+    }
+}
+BENCHMARK(BM_PerfectHashBuild)->Unit(benchmark::kMillisecond);
+
+static void BM_UnorderedMapBuild(benchmark::State& state)
+{
+    keys();
+    for (auto _ : state)
+    {
+        auto map = buildMap();
+        benchmark::DoNotOptimize(map);
+    }
+}
+BENCHMARK(BM_UnorderedMapBuild)->Unit(benchmark::kMillisecond);
+
+static void perfectHashFind(benchmark::State& state, bool present)
+{
+    static const PerfectHashIndex index{};
+    const auto queries = lookups(present);
+    std::size_t next = 0;
+    for (auto _ : state)
+    {
+        const auto& query = queries[next++ % LOOKUPS];
+        benchmark::DoNotOptimize(index.find(query.domain, query.platform));
+    }
+    state.counters["index_bytes_per_key"] = static_cast<double>(index.indexBytes()) / KEYS;
+}
+
+static void unorderedMapFind(benchmark::State& state, bool present)
+{
+    static const auto map = buildMap();
+    const auto queries = lookups(present);
+    std::size_t next = 0;
+    for (auto _ : state)
+    {
+        const auto& query = queries[next++ % LOOKUPS];
+        const auto found = map.find(query.joined);
+        benchmark::DoNotOptimize(found == map.end() ? KEYS : found->second);
+    }
+    state.counters["index_bytes_per_key"] = static_cast<double>(mapBytes(map)) / KEYS;
+}
+
+static void BM_PerfectHashFind(benchmark::State& state)
+{
+    perfectHashFind(state, true);
+}
+BENCHMARK(BM_PerfectHashFind);
+
+static void BM_PerfectHashFindMissing(benchmark::State& state)
+{
+    perfectHashFind(state, false);
+}
+BENCHMARK(BM_PerfectHashFindMissing);
+
+static void BM_UnorderedMapFind(benchmark::State& state)
+{
+    unorderedMapFind(state, true);
+}
+BENCHMARK(BM_UnorderedMapFind);
+
+static void BM_UnorderedMapFindMissing(benchmark::State& state)
+{
+    unorderedMapFind(state, false);
+}
+BENCHMARK(BM_UnorderedMapFindMissing);
@@ -0,0 +1,30 @@
+#include "../src/repository.h"
+#include "common.h"
+
+#include "benchmark/benchmark.h"
+
+#include <string>
+
+static void BM_GetTXTRecordHit(benchmark::State& state)
+{
+    cppbackend::Repository repository(DB_PATH);
+    const std::string domain{"canberra"};
+    for (auto _ : state)
+    {
+        auto record = repository.getTXTRecord(domain, 2);
+        benchmark::DoNotOptimize(record);
+    }
+}
+BENCHMARK(BM_GetTXTRecordHit);
+
+static void BM_GetTXTRecordMiss(benchmark::State& state)
+{
+    cppbackend::Repository repository(DB_PATH);
+    const std::string domain{"notarealdomain"};
+    for (auto _ : state)
+    {
+        auto record = repository.getTXTRecord(domain, 1);
+        benchmark::DoNotOptimize(record);
+    }
+}
+BENCHMARK(BM_GetTXTRecordMiss);
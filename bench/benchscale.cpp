@@ -0,0 +1,155 @@
+// Repository behaviour from 10^3 to 10^7 platform rows.
+// CPPBACKEND_BENCH_MAX_ROWS lowers the upper end for quick runs.
+
+#include "../src/repository.h"
+#include "../src/snapshot.h"
+#include "common.h"
+#include "databasegenerator.h"
+
+#include "benchmark/benchmark.h"
+
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+static void scaleRows(benchmark::internal::Benchmark* benchmark)
+{
+    long maxRows = 10000000;
+    if (const char* limit = std::getenv("CPPBACKEND_BENCH_MAX_ROWS"))
+    {
+        maxRows = std::atol(limit);
+    }
+    for (long rows = 1000; rows <= maxRows; rows *= 10)
+    {
+        benchmark->Arg(rows);
+    }
+    benchmark->ArgName("rows");
+}
+
+static void getTXTRecord(benchmark::State& state, const std::string& path)
+{
+    const auto rows = static_cast<std::size_t>(state.range(0));
+    const auto domains = rows / cppbackend::DatabaseGenerator::PLATFORMS;
+
+    cppbackend::Repository repository(path);
+    std::mt19937 random(1);
+    std::uniform_int_distribution<std::size_t> domain(0, domains - 1);
+    std::uniform_int_distribution<int> platform(1, cppbackend::DatabaseGenerator::PLATFORMS);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto name = cppbackend::DatabaseGenerator::domainName(domain(random));
+        const auto nbr = platform(random);
+        state.ResumeTiming();
+
+        auto record = repository.getTXTRecord(name, nbr);
+        benchmark::DoNotOptimize(record);
+    }
+}
+
+static void BM_ScaleGetTXTRecord(benchmark::State& state)
+{
+    const auto rows = static_cast<std::size_t>(state.range(0));
+    getTXTRecord(state, cppbackend::DatabaseGenerator::cached(benchDataDirectory(), rows));
+}
+BENCHMARK(BM_ScaleGetTXTRecord)->Apply(scaleRows)->Unit(benchmark::kMicrosecond);
+
+static void BM_ScaleGetTXTRecordIndexed(benchmark::State& state)
+{
+    getTXTRecord(state, indexedDatabase(static_cast<std::size_t>(state.range(0))));
+}
+BENCHMARK(BM_ScaleGetTXTRecordIndexed)->Apply(scaleRows)->Unit(benchmark::kMicrosecond);
+
+static void BM_ScaleOpenRepository(benchmark::State& state)
+{
+    const auto rows = static_cast<std::size_t>(state.range(0));
+    const auto path = cppbackend::DatabaseGenerator::cached(benchDataDirectory(), rows);
+
+    for (auto _ : state)
+    {
+        cppbackend::Repository repository(path);
+        benchmark::DoNotOptimize(repository);
+    }
+}
+BENCHMARK(BM_ScaleOpenRepository)->Apply(scaleRows)->Unit(benchmark::kMicrosecond);
+
+// Snapshot of the indexed database, written next to it the first time
+static std::string snapshotFile(std::size_t rows)
+{
+    const auto path = indexedDatabase(rows);
+    const auto snapshotPath = cppbackend::Snapshot::defaultPath(path);
+    const cppbackend::Repository repository(path);
+    cppbackend::Snapshot::open(path, repository, snapshotPath);
+    return snapshotPath;
+}
+
+// Startup without a usable snapshot: every record read and base64 encoded
+static void BM_ScaleSnapshotBuild(benchmark::State& state)
+{
+    const auto path = indexedDatabase(static_cast<std::size_t>(state.range(0)));
+    const cppbackend::Repository repository(path);
+
+    for (auto _ : state)
+    {
+        auto snapshot = cppbackend::Snapshot::build(path, repository);
+        benchmark::DoNotOptimize(snapshot);
+        state.counters["bytes"] = static_cast<double>(snapshot->getSize());
+        state.counters["bytes_per_domain"] = static_cast<double>(snapshot->getSize()) / snapshot->getDomainCount();
+    }
+}
+BENCHMARK(BM_ScaleSnapshotBuild)->Apply(scaleRows)->Unit(benchmark::kMillisecond);
+
+// Startup with one: map, check and validate the file
+static void BM_ScaleSnapshotLoad(benchmark::State& state)
+{
+    const auto rows = static_cast<std::size_t>(state.range(0));
+    const auto snapshotPath = snapshotFile(rows);
+    const auto path = indexedDatabase(rows);
+
+    for (auto _ : state)
+    {
+        auto snapshot = cppbackend::Snapshot::load(snapshotPath, path);
+        benchmark::DoNotOptimize(snapshot);
+    }
+}
+BENCHMARK(BM_ScaleSnapshotLoad)->Apply(scaleRows)->Unit(benchmark::kMillisecond);
+
+// Compare with BM_ScaleGetTXTRecordIndexed, which still has to base64 encode.
+// The queries are made up front, so unlike the SQLite benchmarks no timer
+// pauses are counted in.
+static void BM_ScaleSnapshotFind(benchmark::State& state)
+{
+    constexpr std::size_t QUERIES = 1 << 16;
+    const auto rows = static_cast<std::size_t>(state.range(0));
+    const auto domains = rows / cppbackend::DatabaseGenerator::PLATFORMS;
+    const auto snapshot = cppbackend::Snapshot::load(snapshotFile(rows), indexedDatabase(rows));
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<std::size_t> domain(0, domains - 1);
+    std::uniform_int_distribution<int> platform(1, cppbackend::DatabaseGenerator::PLATFORMS);
+    std::vector<std::pair<std::string, int>> queries{};
+    for (std::size_t i = 0; i < QUERIES; ++i)
+    {
+        queries.emplace_back(cppbackend::DatabaseGenerator::domainName(domain(random)), platform(random));
+    }
+
+    std::size_t next = 0;
+    for (auto _ : state)
+    {
+        const auto& [name, nbr] = queries[next++ % QUERIES];
+        std::string_view answer{};
+        int ttl = 0;
+        if (!snapshot->find(name, nbr, answer, ttl))
+        {
+            state.SkipWithError("Record missing from the snapshot");
+            break;
+        }
+        benchmark::DoNotOptimize(answer);
+    }
+    state.counters["bytes_per_domain"] = static_cast<double>(snapshot->getSize()) / snapshot->getDomainCount();
+}
+BENCHMARK(BM_ScaleSnapshotFind)->Apply(scaleRows)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,119 @@
+// Effect of each RepositoryOptions setting on lookup latency, against the
+// fixture database and an indexed 1M row generated database.
+
+#include "../src/repository.h"
+#include "common.h"
+#include "databasegenerator.h"
+
+#include "benchmark/benchmark.h"
+
+#include <array>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace {
+    // Plain SQLITE_OPEN_READONLY with SQLite's defaults, as before tuning
+    cppbackend::RepositoryOptions untuned()
+    {
+        cppbackend::RepositoryOptions options{};
+        options.noMutex = false;
+        options.mmapSize = 0;
+        options.cacheSizeKiB = 0;
+        options.tempStoreMemory = false;
+        return options;
+    }
+
+    // Each profile is the untuned connection with one setting changed, except
+    // for "default" (RepositoryOptions{}) and "all" (the defaults plus
+    // immutable; shared cache stays off, as SQLite discourages it)
+    std::pair<const char*, cppbackend::RepositoryOptions> profile(int index)
+    {
+        auto options = untuned();
+        switch (index)
+        {
+            case 0:
+                return {"untuned", options};
+            case 1:
+                options.noMutex = true;
+                return {"nomutex", options};
+            case 2:
+                options.immutable = true;
+                return {"immutable", options};
+            case 3:
+                options.mmapSize = cppbackend::RepositoryOptions{}.mmapSize;
+                return {"mmap", options};
+            case 4:
+                options.cacheSizeKiB = cppbackend::RepositoryOptions{}.cacheSizeKiB;
+                return {"cache_size", options};
+            case 5:
+                options.tempStoreMemory = true;
+                return {"temp_store", options};
+            case 6:
+                options.sharedCache = true;
+                return {"shared_cache", options};
+            case 7:
+                return {"default", cppbackend::RepositoryOptions{}};
+            default:
+                options = cppbackend::RepositoryOptions{};
+                options.immutable = true;
+                return {"all", options};
+        }
+    }
+
+    constexpr int PROFILE_COUNT = 9;
+    constexpr std::size_t LARGE_ROWS = 1000000;
+
+    void lookups(benchmark::State& state, const std::string& path,
+                 std::size_t domains, bool fixture)
+    {
+        const auto [name, options] = profile(static_cast<int>(state.range(0)));
+        state.SetLabel(name);
+
+        cppbackend::Repository repository(path, options);
+
+        // The fixture has 5 domains and gaps in its platforms; query known rows
+        static const std::array<std::pair<const char*, int>, 4> fixtureKeys = {{
+                {"canberra", 2}, {"adelaide", 3}, {"perth", 5}, {"brisbane", 1}}};
+
+        std::mt19937 random(1);
+        std::uniform_int_distribution<std::size_t> domain(0, domains - 1);
+        std::uniform_int_distribution<int> platform(1, cppbackend::DatabaseGenerator::PLATFORMS);
+
+        std::size_t i = 0;
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            std::string key{};
+            int nbr = 0;
+            if (fixture)
+            {
+                const auto& fixtureKey = fixtureKeys[i++ % fixtureKeys.size()];
+                key = fixtureKey.first;
+                nbr = fixtureKey.second;
+            }
+            else
+            {
+                key = cppbackend::DatabaseGenerator::domainName(domain(random));
+                nbr = platform(random);
+            }
+            state.ResumeTiming();
+
+            auto record = repository.getTXTRecord(key, nbr);
+            benchmark::DoNotOptimize(record);
+        }
+    }
+}
+
+static void BM_SQLiteProfileSmall(benchmark::State& state)
+{
+    lookups(state, DB_PATH, 0, true);
+}
+BENCHMARK(BM_SQLiteProfileSmall)->DenseRange(0, PROFILE_COUNT - 1)->ArgName("profile");
+
+static void BM_SQLiteProfileLarge(benchmark::State& state)
+{
+    lookups(state, indexedDatabase(LARGE_ROWS),
+            LARGE_ROWS / cppbackend::DatabaseGenerator::PLATFORMS, false);
+}
+BENCHMARK(BM_SQLiteProfileLarge)->DenseRange(0, PROFILE_COUNT - 1)->ArgName("profile");
@@ -0,0 +1,101 @@
+// ZoneTable against a scan over the zone suffixes, at 1, 100 and 10 000
+// zones. The scan is what comparing fixed label positions grows into once
+// there is more than one zone per answer type.
+
+#include "../src/asciicase.h"
+#include "../src/zonetable.h"
+
+#include "benchmark/benchmark.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using cppbackend::AsciiCase;
+using cppbackend::ZoneTable;
+
+namespace {
+    constexpr std::size_t LOOKUPS = 1 << 12;
+
+    // One, two and three label zones, several under each parent
+    std::vector<std::string> zones(std::size_t count)
+    {
+        std::vector<std::string> result{};
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            switch (i % 3)
+            {
+                case 0: result.push_back("zone" + std::to_string(i)); break;
+                case 1: result.push_back("zone" + std::to_string(i) + ".example"); break;
+                default: result.push_back("zone" + std::to_string(i) + ".customer" + std::to_string(i % 16) + ".net");
+            }
+        }
+        return result;
+    }
+
+    // "<platform>.<domain>.<zone>" for random zones, one in eight in none
+    std::vector<std::string> qnames(const std::vector<std::string>& zones)
+    {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<std::size_t> index(0, zones.size() - 1);
+        std::vector<std::string> result{};
+        for (std::size_t i = 0; i < LOOKUPS; ++i)
+        {
+            const auto zone = i % 8 == 7 ? std::string{"unknown.org"} : zones[index(random)];
+            result.push_back("2.domain" + std::to_string(i) + "." + zone);
+        }
+        return result;
+    }
+
+    // The longest suffix of qname, starting at a label, in zones
+    std::size_t scan(const std::vector<std::string>& zones, std::string_view qname)
+    {
+        std::size_t best = zones.size();
+        std::size_t bestLength = 0;
+        for (std::size_t i = 0; i < zones.size(); ++i)
+        {
+            const std::string_view zone = zones[i];
+            if (zone.size() > bestLength && qname.size() > zone.size() &&
+                qname[qname.size() - zone.size() - 1] == '.' &&
+                AsciiCase::equals(qname.substr(qname.size() - zone.size()), zone))
+            {
+                best = i;
+                bestLength = zone.size();
+            }
+        }
+        return best;
+    }
+}
+
+static void BM_ZoneTableMatch(benchmark::State& state)
+{
+    const auto names = zones(static_cast<std::size_t>(state.range(0)));
+    ZoneTable table{};
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        table.add(names[i], static_cast<std::uint32_t>(i));
+    }
+    const auto queries = qnames(names);
+
+    std::size_t next = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(table.match(queries[next++ % LOOKUPS]));
+    }
+}
+BENCHMARK(BM_ZoneTableMatch)->Arg(1)->Arg(100)->Arg(10000);
+
+static void BM_SuffixScanMatch(benchmark::State& state)
+{
+    const auto names = zones(static_cast<std::size_t>(state.range(0)));
+    const auto queries = qnames(names);
+
+    std::size_t next = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(scan(names, queries[next++ % LOOKUPS]));
+    }
+}
+BENCHMARK(BM_SuffixScanMatch)->Arg(1)->Arg(100)->Arg(10000);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../src/repository.h"
+#include "databasegenerator.h"
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+// Set by CMake to the fixture database shipped in test/
+static const std::string DB_PATH {BENCH_DB_PATH};
+
+// Generated databases are cached in CPPBACKEND_BENCH_DATA (default /tmp)
+// because the large ones take a while to build
+inline std::string benchDataDirectory()
+{
+    const char* directory = std::getenv("CPPBACKEND_BENCH_DATA");
+    return directory ? directory : "/tmp";
+}
+
+// Indexed copy of the cached database with the given number of platform rows,
+// made the way 'cppbackend --create-index' does
+inline std::string indexedDatabase(std::size_t rows)
+{
+    const auto path = cppbackend::DatabaseGenerator::cached(benchDataDirectory(), rows);
+    const auto indexed = path + ".indexed";
+    if (access(indexed.c_str(), R_OK) != 0)
+    {
+        cppbackend::Repository::createIndexes(path, indexed);
+    }
+    return indexed;
+}
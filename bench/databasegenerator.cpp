@@ -0,0 +1,175 @@
+#include "databasegenerator.h"
+
+#include "sqlite3.h"
+#include "../src/fmt/format.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+
+namespace cppbackend {
+    namespace {
+        void execute(sqlite3* database, const char* sql)
+        {
+            char* error = nullptr;
+            if (sqlite3_exec(database, sql, nullptr, nullptr, &error) != SQLITE_OK)
+            {
+                const std::string message = error ? error : "unknown error";
+                sqlite3_free(error);
+                throw std::runtime_error(fmt::format("Error generating database: {}", message));
+            }
+        }
+
+        sqlite3_stmt* prepare(sqlite3* database, const char* sql)
+        {
+            sqlite3_stmt* statement = nullptr;
+            if (sqlite3_prepare_v2(database, sql, -1, &statement, nullptr) != SQLITE_OK)
+            {
+                throw std::runtime_error(fmt::format("Error generating database: {}", sqlite3_errmsg(database)));
+            }
+            return statement;
+        }
+
+        void stepInsert(sqlite3* database, sqlite3_stmt* statement)
+        {
+            if (sqlite3_step(statement) != SQLITE_DONE)
+            {
+                throw std::runtime_error(fmt::format("Error generating database: {}", sqlite3_errmsg(database)));
+            }
+            sqlite3_reset(statement);
+        }
+
+        // Fixture-like payload, "[name nbr] number", padded with lowercase words.
+        // Lengths shorter than the unpadded payload produce the unpadded payload.
+        std::string makeTxt(const std::string& name, int nbr, std::size_t length, std::mt19937& random)
+        {
+            std::uniform_int_distribution<int> number(0, 99999);
+            std::uniform_int_distribution<int> letter('a', 'z');
+            std::uniform_int_distribution<int> wordLength(2, 9);
+
+            std::string txt = fmt::format("[{} {}", name, nbr);
+            // Room for a space, a word of up to 9 letters and the closing "] 99999"
+            while (txt.size() + 1 + 9 + 7 <= length)
+            {
+                txt.push_back(' ');
+                for (int i = wordLength(random); i > 0; --i)
+                {
+                    txt.push_back(static_cast<char>(letter(random)));
+                }
+            }
+            txt += fmt::format("] {}", number(random));
+            return txt;
+        }
+    }
+
+    void DatabaseGenerator::generate(const std::string& path, const Options& options)
+    {
+        if (options.minTxtLength == 0 ||
+            options.minTxtLength > options.maxTxtLength ||
+            options.typicalTxtLength < options.minTxtLength ||
+            options.typicalTxtLength > options.maxTxtLength)
+        {
+            throw std::invalid_argument("TXT lengths must satisfy 0 < min <= typical <= max");
+        }
+
+        std::remove(path.c_str());
+
+        sqlite3* database = nullptr;
+        if (sqlite3_open_v2(path.c_str(), &database,
+                            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+        {
+            sqlite3_close_v2(database);
+            throw std::runtime_error(fmt::format("Error creating database '{}'", path));
+        }
+
+        sqlite3_stmt* insertDomain = nullptr;
+        sqlite3_stmt* insertPlatform = nullptr;
+        try {
+            // Same schema as the fixture database, including its lack of indexes
+            execute(database,
+                    "PRAGMA journal_mode=OFF;"
+                    "PRAGMA synchronous=OFF;"
+                    "CREATE TABLE domain ("
+                    " id INTEGER NOT NULL,"
+                    " name VARCHAR NOT NULL,"
+                    " PRIMARY KEY (id));"
+                    "CREATE TABLE platform ("
+                    " id INTEGER NOT NULL,"
+                    " domain_id INTEGER NOT NULL,"
+                    " nbr INTEGER NOT NULL,"
+                    " txt VARCHAR NOT NULL,"
+                    " is_valid BOOLEAN,"
+                    " PRIMARY KEY (id),"
+                    " FOREIGN KEY(domain_id) REFERENCES domain (id),"
+                    " CHECK (is_valid IN (0, 1)));");
+
+            insertDomain = prepare(database, "INSERT INTO domain (id, name) VALUES (?, ?)");
+            insertPlatform = prepare(database,
+                    "INSERT INTO platform (id, domain_id, nbr, txt, is_valid) VALUES (?, ?, ?, ?, 1)");
+
+            std::mt19937 random(options.seed);
+            std::lognormal_distribution<double> txtLength(std::log(static_cast<double>(options.typicalTxtLength)), 0.6);
+
+            execute(database, "BEGIN");
+            sqlite3_int64 platformId = 1;
+            for (std::size_t i = 0; i < options.domains; ++i)
+            {
+                const auto domainId = static_cast<sqlite3_int64>(i + 1);
+                const auto name = domainName(i);
+                sqlite3_bind_int64(insertDomain, 1, domainId);
+                sqlite3_bind_text(insertDomain, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+                stepInsert(database, insertDomain);
+
+                for (int nbr = 1; nbr <= PLATFORMS; ++nbr)
+                {
+                    const auto length = std::clamp(static_cast<std::size_t>(txtLength(random)),
+                                                   options.minTxtLength, options.maxTxtLength);
+                    const auto txt = makeTxt(name, nbr, length, random);
+                    sqlite3_bind_int64(insertPlatform, 1, platformId++);
+                    sqlite3_bind_int64(insertPlatform, 2, domainId);
+                    sqlite3_bind_int(insertPlatform, 3, nbr);
+                    sqlite3_bind_text(insertPlatform, 4, txt.c_str(), -1, SQLITE_TRANSIENT);
+                    stepInsert(database, insertPlatform);
+                }
+            }
+            execute(database, "COMMIT");
+        } catch (...) {
+            sqlite3_finalize(insertDomain);
+            sqlite3_finalize(insertPlatform);
+            sqlite3_close_v2(database);
+            throw;
+        }
+
+        sqlite3_finalize(insertDomain);
+        sqlite3_finalize(insertPlatform);
+        sqlite3_close_v2(database);
+    }
+
+    std::string DatabaseGenerator::cached(const std::string& directory, std::size_t rows)
+    {
+        const auto path = fmt::format("{}/cppbackend_{}_rows.db", directory, rows);
+        if (access(path.c_str(), R_OK) != 0)
+        {
+            Options options{};
+            options.domains = std::max<std::size_t>(1, rows / PLATFORMS);
+
+            // Generate under a temporary name so an interrupted run is not reused
+            const auto partial = path + ".partial";
+            generate(partial, options);
+            if (std::rename(partial.c_str(), path.c_str()) != 0)
+            {
+                throw std::runtime_error(fmt::format("Error moving generated database to '{}'", path));
+            }
+        }
+        return path;
+    }
+
+    std::string DatabaseGenerator::domainName(std::size_t index)
+    {
+        return fmt::format("domain{}", index);
+    }
+}
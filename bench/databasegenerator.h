@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace cppbackend {
+    // Builds SQLite databases with the same schema as test/test.db so the
+    // benchmarks can run against more than the 11 fixture rows.
+    class DatabaseGenerator {
+    public:
+        struct Options {
+            std::size_t domains = 1000;
+            unsigned seed = 1;
+            // TXT payload lengths follow a log-normal distribution around
+            // typicalTxtLength, clamped to this range. 255 is the most a single
+            // TXT character-string can hold.
+            std::size_t minTxtLength = 8;
+            std::size_t typicalTxtLength = 32;
+            std::size_t maxTxtLength = 255;
+        };
+
+        // Creates (or replaces) a database at path with options.domains domains,
+        // each having every platform from 1 to PLATFORMS.
+        static void generate(const std::string& path, const Options& options);
+
+        // Returns a generated database with the given number of platform rows from
+        // directory, generating it the first time it is asked for.
+        static std::string cached(const std::string& directory, std::size_t rows);
+
+        // Name of the domain with the given zero based index in a generated database
+        static std::string domainName(std::size_t index);
+
+        static constexpr int PLATFORMS = 5;
+    };
+}
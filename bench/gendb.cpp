@@ -0,0 +1,59 @@
+// Command line front end for DatabaseGenerator, for building scale test databases
+
+#include "databasegenerator.h"
+
+#include "../src/fmt/format.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " database_path domains [--seed=N] [--min-txt=N] [--typical-txt=N] [--max-txt=N]\n"
+                  << "Each domain gets " << cppbackend::DatabaseGenerator::PLATFORMS << " platform rows." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    cppbackend::DatabaseGenerator::Options options{};
+    try {
+        options.domains = std::stoul(argv[2]);
+        for (int i = 3; i < argc; ++i)
+        {
+            const std::string argument{argv[i]};
+            const auto equals = argument.find('=');
+            const auto name = argument.substr(0, equals);
+            const auto value = equals == std::string::npos ? std::string{} : argument.substr(equals + 1);
+
+            if (name == "--seed") {
+                options.seed = static_cast<unsigned>(std::stoul(value));
+            } else if (name == "--min-txt") {
+                options.minTxtLength = std::stoul(value);
+            } else if (name == "--typical-txt") {
+                options.typicalTxtLength = std::stoul(value);
+            } else if (name == "--max-txt") {
+                options.maxTxtLength = std::stoul(value);
+            } else {
+                std::cerr << fmt::format("Unknown option '{}'", argument) << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        cppbackend::DatabaseGenerator::generate(argv[1], options);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << fmt::format("Generated {} domains, {} platform rows in {:.2f}s",
+                                 options.domains,
+                                 options.domains * cppbackend::DatabaseGenerator::PLATFORMS,
+                                 elapsed.count())
+                  << std::endl;
+    } catch (std::exception& err) {
+        std::cerr << fmt::format("Error generating database: {}", err.what()) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
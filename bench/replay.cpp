@@ -0,0 +1,519 @@
+// Replays a query mix through a real cppbackend process over its stdin/stdout
+// pipes, the same way PowerDNS drives a pipe backend, and reports end to end
+// throughput and round trip latency. Like PowerDNS, it restarts the backend
+// after every FAIL, so the cost of failing answers shows up in the latencies.
+
+#include "databasegenerator.h"
+
+#include "../src/fmt/format.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    enum QueryClass { HIT = 0, MISS, EPOCH, MALFORMED, QUERY_CLASS_COUNT };
+
+    const std::array<const char*, QUERY_CLASS_COUNT> QUERY_CLASS_NAMES = {"hit", "miss", "oc", "malformed"};
+
+    struct ReplayOptions {
+        std::string backendPath{REPLAY_BACKEND_PATH};
+        std::string databasePath{};
+        std::string backendLogPath{"/dev/null"};
+        std::size_t queries = 100000;
+        std::size_t domains = 1000;
+        std::vector<int> abiVersions{1, 2, 3};
+        std::array<unsigned, QUERY_CLASS_COUNT> weights{70, 10, 15, 5};
+        unsigned seed = 1;
+        bool restartOnFail = true;
+        bool json = false;
+    };
+
+    struct Query {
+        QueryClass queryClass;
+        std::string line;
+        // Only lines that break the protocol should get FAIL
+        bool expectFail = false;
+    };
+
+    struct ReplayResult {
+        int abiVersion = 0;
+        double seconds = 0;
+        std::size_t unexpected = 0;
+        std::size_t fails = 0;
+        std::size_t restarts = 0;
+        std::array<std::vector<std::int64_t>, QUERY_CLASS_COUNT> latencies{};
+    };
+
+    void printUsage(const char* program)
+    {
+        std::cout << "Usage: " << program << " [options]\n"
+                  << "  --backend=PATH      cppbackend executable (default: " << REPLAY_BACKEND_PATH << ")\n"
+                  << "  --database=PATH     database made by cppbackend_gendb (default: generate one)\n"
+                  << "  --domains=N         domains to generate, or in the --database (default: 1000)\n"
+                  << "  --queries=N         queries per ABI version (default: 100000)\n"
+                  << "  --abi=LIST          comma separated ABI versions (default: 1,2,3)\n"
+                  << "  --mix=H,M,O,X       weights for hit, miss, oc and malformed (default: 70,10,15,5)\n"
+                  << "  --seed=N            random seed (default: 1)\n"
+                  << "  --backend-log=PATH  where the backend's stderr goes (default: /dev/null)\n"
+                  << "  --no-restart        keep the backend running after a FAIL instead of restarting it\n"
+                  << "  --json              print results as JSON\n";
+    }
+
+    std::vector<unsigned> parseList(const std::string& value)
+    {
+        std::vector<unsigned> values{};
+        std::size_t start = 0;
+        while (start <= value.size())
+        {
+            auto end = value.find(',', start);
+            if (end == std::string::npos)
+            {
+                end = value.size();
+            }
+            values.push_back(static_cast<unsigned>(std::stoul(value.substr(start, end - start))));
+            start = end + 1;
+        }
+        return values;
+    }
+
+    ReplayOptions parseOptions(int argc, char* argv[])
+    {
+        ReplayOptions options{};
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument{argv[i]};
+            const auto equals = argument.find('=');
+            const auto name = argument.substr(0, equals);
+            const auto value = equals == std::string::npos ? std::string{} : argument.substr(equals + 1);
+
+            if (name == "--backend") {
+                options.backendPath = value;
+            } else if (name == "--database") {
+                options.databasePath = value;
+            } else if (name == "--domains") {
+                options.domains = std::stoul(value);
+            } else if (name == "--queries") {
+                options.queries = std::stoul(value);
+            } else if (name == "--abi") {
+                options.abiVersions.clear();
+                for (const auto abi : parseList(value))
+                {
+                    if (abi < 1 || abi > 3)
+                    {
+                        throw std::invalid_argument(fmt::format("Unsupported ABI version {}", abi));
+                    }
+                    options.abiVersions.push_back(static_cast<int>(abi));
+                }
+            } else if (name == "--mix") {
+                const auto weights = parseList(value);
+                if (weights.size() != QUERY_CLASS_COUNT)
+                {
+                    throw std::invalid_argument("--mix needs 4 weights: hit,miss,oc,malformed");
+                }
+                std::copy(weights.begin(), weights.end(), options.weights.begin());
+            } else if (name == "--seed") {
+                options.seed = static_cast<unsigned>(std::stoul(value));
+            } else if (name == "--backend-log") {
+                options.backendLogPath = value;
+            } else if (name == "--no-restart") {
+                options.restartOnFail = false;
+            } else if (name == "--json") {
+                options.json = true;
+            } else {
+                throw std::invalid_argument(fmt::format("Unknown option '{}'", argument));
+            }
+        }
+        return options;
+    }
+
+    std::string formatQuery(const std::string& qname, const std::string& id, int abiVersion)
+    {
+        switch (abiVersion)
+        {
+            case 1:
+                return fmt::format("Q\t{}\tIN\tTXT\t{}\t192.0.2.1", qname, id);
+            case 2:
+                return fmt::format("Q\t{}\tIN\tTXT\t{}\t192.0.2.1\t198.51.100.1", qname, id);
+            default:
+                return fmt::format("Q\t{}\tIN\tTXT\t{}\t192.0.2.1\t198.51.100.1\t0.0.0.0/0", qname, id);
+        }
+    }
+
+    std::vector<Query> buildQueries(const ReplayOptions& options, std::size_t domains, int abiVersion)
+    {
+        std::mt19937 random(options.seed);
+        std::discrete_distribution<int> classes(options.weights.begin(), options.weights.end());
+        std::uniform_int_distribution<std::size_t> domain(0, domains - 1);
+        std::uniform_int_distribution<int> platform(1, cppbackend::DatabaseGenerator::PLATFORMS);
+
+        std::vector<Query> queries{};
+        queries.reserve(options.queries);
+        for (std::size_t i = 0; i < options.queries; ++i)
+        {
+            const auto queryClass = static_cast<QueryClass>(classes(random));
+            const auto id = fmt::format("{}", i + 1);
+            const auto name = cppbackend::DatabaseGenerator::domainName(domain(random));
+
+            switch (queryClass)
+            {
+                case HIT:
+                    queries.push_back({queryClass, formatQuery(fmt::format("{}.{}.testnet", platform(random), name), id, abiVersion)});
+                    break;
+                case MISS:
+                    queries.push_back({queryClass, formatQuery(fmt::format("{}.missing-{}.testnet", platform(random), name), id, abiVersion)});
+                    break;
+                case EPOCH:
+                    queries.push_back({queryClass, formatQuery(fmt::format("{}.{}.oc.testnet", platform(random), name), id, abiVersion)});
+                    break;
+                default:
+                    // Alternate between an unparseable line and a qname outside the zone
+                    if (i % 2 == 0)
+                    {
+                        queries.push_back({queryClass, fmt::format("Q\t{}.testnet\tIN", name), true});
+                    }
+                    else
+                    {
+                        queries.push_back({queryClass, formatQuery(fmt::format("{}.{}.com.au", platform(random), name), id, abiVersion)});
+                    }
+                    break;
+            }
+        }
+        return queries;
+    }
+
+    // A running cppbackend with its stdin and stdout connected to us
+    class BackendProcess {
+    public:
+        BackendProcess(const ReplayOptions& options, const std::string& databasePath)
+        {
+            int toChild[2];
+            int fromChild[2];
+            if (pipe(toChild) != 0 || pipe(fromChild) != 0)
+            {
+                throw std::runtime_error("Unable to create pipes");
+            }
+
+            m_pid = fork();
+            if (m_pid < 0)
+            {
+                throw std::runtime_error("Unable to fork backend process");
+            }
+
+            if (m_pid == 0)
+            {
+                dup2(toChild[0], STDIN_FILENO);
+                dup2(fromChild[1], STDOUT_FILENO);
+                const int log = open(options.backendLogPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+                if (log >= 0)
+                {
+                    dup2(log, STDERR_FILENO);
+                    close(log);
+                }
+                close(toChild[0]);
+                close(toChild[1]);
+                close(fromChild[0]);
+                close(fromChild[1]);
+
+                execl(options.backendPath.c_str(), options.backendPath.c_str(), databasePath.c_str(), nullptr);
+                std::perror("execl");
+                _exit(127);
+            }
+
+            close(toChild[0]);
+            close(fromChild[1]);
+            m_input = toChild[1];
+            m_output = fdopen(fromChild[0], "r");
+        }
+
+        ~BackendProcess()
+        {
+            if (m_input >= 0)
+            {
+                close(m_input);
+            }
+            if (m_output)
+            {
+                std::fclose(m_output);
+            }
+            if (m_pid > 0)
+            {
+                int status = 0;
+                waitpid(m_pid, &status, 0);
+            }
+            free(m_line);
+        }
+
+        BackendProcess(const BackendProcess&) = delete;
+        BackendProcess& operator=(const BackendProcess&) = delete;
+
+        void send(const std::string& line)
+        {
+            m_buffer = line;
+            m_buffer.push_back('\n');
+
+            const char* data = m_buffer.data();
+            std::size_t remaining = m_buffer.size();
+            while (remaining > 0)
+            {
+                const auto written = write(m_input, data, remaining);
+                if (written <= 0)
+                {
+                    throw std::runtime_error("Backend closed its input");
+                }
+                data += written;
+                remaining -= static_cast<std::size_t>(written);
+            }
+        }
+
+        // Returns the next line without its newline
+        std::string_view receive()
+        {
+            const auto length = getline(&m_line, &m_capacity, m_output);
+            if (length < 0)
+            {
+                throw std::runtime_error("Backend closed its output");
+            }
+            auto size = static_cast<std::size_t>(length);
+            if (size > 0 && m_line[size - 1] == '\n')
+            {
+                --size;
+            }
+            return {m_line, size};
+        }
+
+    private:
+        pid_t m_pid = -1;
+        int m_input = -1;
+        FILE* m_output = nullptr;
+        std::string m_buffer{};
+        char* m_line = nullptr;
+        std::size_t m_capacity = 0;
+    };
+
+    std::unique_ptr<BackendProcess> startBackend(const ReplayOptions& options, const std::string& databasePath,
+                                                 int abiVersion)
+    {
+        auto backend = std::make_unique<BackendProcess>(options, databasePath);
+        backend->send(fmt::format("HELO\t{}", abiVersion));
+        const auto banner = backend->receive();
+        if (banner.substr(0, 3) != "OK\t")
+        {
+            throw std::runtime_error(fmt::format("Handshake failed: '{}'", banner));
+        }
+        return backend;
+    }
+
+    ReplayResult replay(const ReplayOptions& options, const std::string& databasePath,
+                        const std::vector<Query>& queries, int abiVersion)
+    {
+        ReplayResult result{};
+        result.abiVersion = abiVersion;
+        for (auto& latencies : result.latencies)
+        {
+            latencies.reserve(queries.size());
+        }
+
+        auto backend = startBackend(options, databasePath, abiVersion);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& query : queries)
+        {
+            const auto sent = std::chrono::steady_clock::now();
+            backend->send(query.line);
+
+            bool gotData = false;
+            while (true)
+            {
+                const auto line = backend->receive();
+                if (line == "END" || line == "FAIL")
+                {
+                    const bool gotFail = line == "FAIL";
+                    const bool expectData = query.queryClass == HIT || query.queryClass == EPOCH;
+                    if (gotData != expectData || gotFail != query.expectFail)
+                    {
+                        ++result.unexpected;
+                    }
+                    if (gotFail)
+                    {
+                        ++result.fails;
+                        // The query that failed waits for the restart, as it would in PowerDNS
+                        if (options.restartOnFail)
+                        {
+                            backend.reset();
+                            backend = startBackend(options, databasePath, abiVersion);
+                            ++result.restarts;
+                        }
+                    }
+                    break;
+                }
+                if (line.substr(0, 5) == "DATA\t")
+                {
+                    gotData = true;
+                }
+            }
+
+            const auto received = std::chrono::steady_clock::now();
+            result.latencies[query.queryClass].push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(received - sent).count());
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return result;
+    }
+
+    // Nearest rank percentile, in microseconds
+    double percentile(const std::vector<std::int64_t>& sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+        auto rank = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size()));
+        rank = std::min(rank, sorted.size() - 1);
+        return static_cast<double>(sorted[rank]) / 1000.0;
+    }
+
+    struct Summary {
+        std::string name;
+        std::size_t count;
+        double p50;
+        double p99;
+        double p999;
+    };
+
+    Summary summarize(const std::string& name, std::vector<std::int64_t> latencies)
+    {
+        std::sort(latencies.begin(), latencies.end());
+        return {name, latencies.size(),
+                percentile(latencies, 0.50), percentile(latencies, 0.99), percentile(latencies, 0.999)};
+    }
+
+    std::vector<Summary> summarize(const ReplayResult& result)
+    {
+        std::vector<Summary> summaries{};
+        std::vector<std::int64_t> all{};
+        for (int i = 0; i < QUERY_CLASS_COUNT; ++i)
+        {
+            all.insert(all.end(), result.latencies[i].begin(), result.latencies[i].end());
+            summaries.push_back(summarize(QUERY_CLASS_NAMES[i], result.latencies[i]));
+        }
+        summaries.insert(summaries.begin(), summarize("all", std::move(all)));
+        return summaries;
+    }
+
+    void printText(const std::vector<ReplayResult>& results)
+    {
+        for (const auto& result : results)
+        {
+            const auto summaries = summarize(result);
+            std::cout << fmt::format("ABI {}: {:.0f} qps, {} unexpected answers, {} FAIL, {} restarts\n",
+                                     result.abiVersion,
+                                     static_cast<double>(summaries[0].count) / result.seconds,
+                                     result.unexpected, result.fails, result.restarts);
+            std::cout << fmt::format("  {:<10} {:>10} {:>10} {:>10} {:>10}\n", "class", "count", "p50 us", "p99 us", "p999 us");
+            for (const auto& summary : summaries)
+            {
+                std::cout << fmt::format("  {:<10} {:>10} {:>10.1f} {:>10.1f} {:>10.1f}\n",
+                                         summary.name, summary.count, summary.p50, summary.p99, summary.p999);
+            }
+        }
+    }
+
+    void printJson(const std::vector<ReplayResult>& results)
+    {
+        std::cout << "{\"runs\": [";
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& result = results[i];
+            const auto summaries = summarize(result);
+            std::cout << fmt::format("{}{{\"abi\": {}, \"seconds\": {:.6f}, \"qps\": {:.1f}, \"unexpected\": {}, "
+                                     "\"fails\": {}, \"restarts\": {}, \"classes\": {{",
+                                     i == 0 ? "" : ", ",
+                                     result.abiVersion, result.seconds,
+                                     static_cast<double>(summaries[0].count) / result.seconds,
+                                     result.unexpected, result.fails, result.restarts);
+            for (std::size_t j = 0; j < summaries.size(); ++j)
+            {
+                const auto& summary = summaries[j];
+                std::cout << fmt::format("{}\"{}\": {{\"count\": {}, \"p50_us\": {:.3f}, \"p99_us\": {:.3f}, \"p999_us\": {:.3f}}}",
+                                         j == 0 ? "" : ", ",
+                                         summary.name, summary.count, summary.p50, summary.p99, summary.p999);
+            }
+            std::cout << "}}";
+        }
+        std::cout << "]}" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    ReplayOptions options{};
+    try {
+        options = parseOptions(argc, argv);
+    } catch (std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // A dead backend must surface as an error from write(), not kill us
+    signal(SIGPIPE, SIG_IGN);
+
+    std::string databasePath = options.databasePath;
+    const bool generated = databasePath.empty();
+
+    try {
+        if (generated)
+        {
+            databasePath = fmt::format("/tmp/cppbackend_replay_{}.db", getpid());
+            cppbackend::DatabaseGenerator::Options generatorOptions{};
+            generatorOptions.domains = options.domains;
+            generatorOptions.seed = options.seed;
+            cppbackend::DatabaseGenerator::generate(databasePath, generatorOptions);
+        }
+
+        std::vector<ReplayResult> results{};
+        for (const auto abiVersion : options.abiVersions)
+        {
+            const auto queries = buildQueries(options, options.domains, abiVersion);
+            results.push_back(replay(options, databasePath, queries, abiVersion));
+        }
+
+        if (options.json) {
+            printJson(results);
+        } else {
+            printText(results);
+        }
+    } catch (std::exception& err) {
+        std::cerr << fmt::format("Error in replay: {}", err.what()) << std::endl;
+        if (generated)
+        {
+            std::remove(databasePath.c_str());
+        }
+        return EXIT_FAILURE;
+    }
+
+    if (generated)
+    {
+        std::remove(databasePath.c_str());
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+#include "aes128block.h"
+#include "cryptopp/config.h"
+#include "cryptopp/cpu.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if (CRYPTOPP_BOOL_X86 || CRYPTOPP_BOOL_X32 || CRYPTOPP_BOOL_X64) && (defined(__GNUC__) || defined(__clang__))
+#define CPPBACKEND_AES_X86 1
+#include <immintrin.h>
+#endif
+
+namespace cppbackend {
+    namespace {
+#ifdef CPPBACKEND_AES_X86
+        __attribute__((target("aes,sse2")))
+        __m128i expandStep(__m128i key, __m128i generated)
+        {
+            generated = _mm_shuffle_epi32(generated, _MM_SHUFFLE(3, 3, 3, 3));
+            key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+            key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+            key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+            return _mm_xor_si128(key, generated);
+        }
+
+        // The round constant has to be an immediate, hence the unrolling
+        __attribute__((target("aes,sse2")))
+        void expandKey(const unsigned char* key, unsigned char* roundKeys)
+        {
+            auto* rk = reinterpret_cast<__m128i*>(roundKeys);
+            rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+            rk[1] = expandStep(rk[0], _mm_aeskeygenassist_si128(rk[0], 0x01));
+            rk[2] = expandStep(rk[1], _mm_aeskeygenassist_si128(rk[1], 0x02));
+            rk[3] = expandStep(rk[2], _mm_aeskeygenassist_si128(rk[2], 0x04));
+            rk[4] = expandStep(rk[3], _mm_aeskeygenassist_si128(rk[3], 0x08));
+            rk[5] = expandStep(rk[4], _mm_aeskeygenassist_si128(rk[4], 0x10));
+            rk[6] = expandStep(rk[5], _mm_aeskeygenassist_si128(rk[5], 0x20));
+            rk[7] = expandStep(rk[6], _mm_aeskeygenassist_si128(rk[6], 0x40));
+            rk[8] = expandStep(rk[7], _mm_aeskeygenassist_si128(rk[7], 0x80));
+            rk[9] = expandStep(rk[8], _mm_aeskeygenassist_si128(rk[8], 0x1b));
+            rk[10] = expandStep(rk[9], _mm_aeskeygenassist_si128(rk[9], 0x36));
+        }
+
+        __attribute__((target("aes,sse2")))
+        void encryptBlock(const unsigned char* roundKeys, const unsigned char* in, unsigned char* out)
+        {
+            const auto* rk = reinterpret_cast<const __m128i*>(roundKeys);
+            __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), rk[0]);
+            for (int round = 1; round < 10; ++round)
+            {
+                block = _mm_aesenc_si128(block, rk[round]);
+            }
+            block = _mm_aesenclast_si128(block, rk[10]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), block);
+        }
+
+        // Round-major over the lanes: the count blocks are independent, so the
+        // CPU can keep several aesenc in flight instead of waiting on each one
+        __attribute__((target("aes,sse2")))
+        void encryptBlocks(const unsigned char* roundKeys, const unsigned char* in, unsigned char* out,
+                           std::size_t count)
+        {
+            const auto* rk = reinterpret_cast<const __m128i*>(roundKeys);
+            __m128i blocks[AES128Block::LANES];
+            for (std::size_t lane = 0; lane < count; ++lane)
+            {
+                blocks[lane] = _mm_xor_si128(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + lane * AES128Block::BLOCK_SIZE)),
+                        rk[0]);
+            }
+            for (int round = 1; round < 10; ++round)
+            {
+                for (std::size_t lane = 0; lane < count; ++lane)
+                {
+                    blocks[lane] = _mm_aesenc_si128(blocks[lane], rk[round]);
+                }
+            }
+            for (std::size_t lane = 0; lane < count; ++lane)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + lane * AES128Block::BLOCK_SIZE),
+                                 _mm_aesenclast_si128(blocks[lane], rk[10]));
+            }
+        }
+#endif
+    }
+
+    AES128Block::AES128Block(const std::string& key)
+        : AES128Block(key, isSupported(Implementation::AESNI) ? Implementation::AESNI : Implementation::CRYPTOPP)
+    {
+    }
+
+    AES128Block::AES128Block(const std::string& key, Implementation implementation)
+        : m_key{key},
+          m_implementation{implementation}
+    {
+        if (key.length() != KEY_LENGTH)
+        {
+            throw std::invalid_argument("Password does not meet length requirement");
+        }
+        if (!isSupported(implementation))
+        {
+            throw std::logic_error("AES-NI is not supported on this CPU");
+        }
+
+        const auto* keyBytes = reinterpret_cast<const unsigned char*>(key.data());
+        if (implementation == Implementation::AESNI)
+        {
+#ifdef CPPBACKEND_AES_X86
+            expandKey(keyBytes, m_roundKeys);
+#endif
+        }
+        else
+        {
+            m_cryptopp.SetKey(keyBytes, KEY_LENGTH);
+        }
+    }
+
+    void AES128Block::pad(const unsigned char* plaintext, std::size_t length, unsigned char* block)
+    {
+        if (length >= BLOCK_SIZE)
+        {
+            throw std::invalid_argument("Plaintext does not fit in a single padded block");
+        }
+
+        // PKCS#7: fill the rest of the block with the number of padding bytes
+        std::memcpy(block, plaintext, length);
+        std::memset(block + length, static_cast<int>(BLOCK_SIZE - length), BLOCK_SIZE - length);
+    }
+
+    void AES128Block::encrypt(const unsigned char* plaintext, std::size_t length, unsigned char* out) const
+    {
+        unsigned char block[BLOCK_SIZE];
+        pad(plaintext, length, block);
+
+#ifdef CPPBACKEND_AES_X86
+        if (m_implementation == Implementation::AESNI)
+        {
+            encryptBlock(m_roundKeys, block, out);
+            return;
+        }
+#endif
+        m_cryptopp.ProcessBlock(block, out);
+    }
+
+    void AES128Block::encryptBatch(const std::string* plaintexts, std::size_t count, unsigned char* out) const
+    {
+        alignas(16) unsigned char blocks[LANES * BLOCK_SIZE];
+        for (std::size_t first = 0; first < count; first += LANES)
+        {
+            const auto lanes = std::min(LANES, count - first);
+            for (std::size_t lane = 0; lane < lanes; ++lane)
+            {
+                const auto& plaintext = plaintexts[first + lane];
+                pad(reinterpret_cast<const unsigned char*>(plaintext.data()), plaintext.length(),
+                    blocks + lane * BLOCK_SIZE);
+            }
+
+            auto* cipherText = out + first * BLOCK_SIZE;
+#ifdef CPPBACKEND_AES_X86
+            if (m_implementation == Implementation::AESNI)
+            {
+                encryptBlocks(m_roundKeys, blocks, cipherText, lanes);
+                continue;
+            }
+#endif
+            for (std::size_t lane = 0; lane < lanes; ++lane)
+            {
+                m_cryptopp.ProcessBlock(blocks + lane * BLOCK_SIZE, cipherText + lane * BLOCK_SIZE);
+            }
+        }
+    }
+
+    bool AES128Block::isSupported(Implementation implementation)
+    {
+        if (implementation == Implementation::CRYPTOPP)
+        {
+            return true;
+        }
+#ifdef CPPBACKEND_AES_X86
+        static const bool hasAESNI = CryptoPP::HasAESNI();
+        return hasAESNI;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "cryptopp/aes.h"
+
+#include <cstddef>
+#include <string>
+
+namespace cppbackend {
+    // AES-128 with a key schedule expanded once, for plaintexts that fit in a
+    // single block. With a zero IV and PKCS#7 padding, CBC mode on a plaintext
+    // shorter than 16 bytes is exactly one AES encryption of the padded block,
+    // so this gives the same ciphertext as the Crypto++ filter pipeline in
+    // Encoder::toAES128 without any of its setup. Uses AES-NI when the CPU
+    // has it and Crypto++'s block cipher otherwise.
+    class AES128Block {
+    public:
+        enum class Implementation { CRYPTOPP, AESNI };
+
+        static constexpr std::size_t BLOCK_SIZE = 16;
+        static constexpr std::size_t KEY_LENGTH = 16;
+        static constexpr std::size_t LANES = 8;
+
+        explicit AES128Block(const std::string& key);
+        AES128Block(const std::string& key, Implementation implementation);
+
+        // Pads plaintext (length < BLOCK_SIZE) with PKCS#7 and writes its
+        // BLOCK_SIZE bytes of ciphertext to out
+        void encrypt(const unsigned char* plaintext, std::size_t length, unsigned char* out) const;
+        // Same as calling encrypt on each plaintext, writing count consecutive
+        // blocks to out. With AES-NI the rounds of up to LANES blocks are
+        // interleaved so the latency of each aesenc is hidden.
+        void encryptBatch(const std::string* plaintexts, std::size_t count, unsigned char* out) const;
+
+        [[nodiscard]] const std::string& getKey() const { return m_key; }
+        [[nodiscard]] Implementation getImplementation() const { return m_implementation; }
+
+        [[nodiscard]] static bool isSupported(Implementation implementation);
+    private:
+        static void pad(const unsigned char* plaintext, std::size_t length, unsigned char* block);
+
+        std::string m_key;
+        Implementation m_implementation;
+        // AES-NI round keys, 11 rounds of 16 bytes
+        alignas(16) unsigned char m_roundKeys[11 * BLOCK_SIZE] = {};
+        CryptoPP::AES::Encryption m_cryptopp;
+    };
+}
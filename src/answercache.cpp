@@ -0,0 +1,279 @@
+#include "answercache.h"
+#include "perfecthash.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+namespace cppbackend {
+    namespace {
+        bool matches(const std::string& key, std::string_view qname, std::string_view qclass)
+        {
+            return key.size() == qname.size() + 1 + qclass.size() &&
+                   key.compare(0, qname.size(), qname) == 0 &&
+                   key[qname.size()] == '\t' &&
+                   key.compare(qname.size() + 1, std::string::npos, qclass) == 0;
+        }
+    }
+
+    AnswerCache::AnswerCache(Stats& stats, const AnswerCacheOptions& options)
+        : m_stats{stats}
+    {
+        if (options.shards == 0 || (options.shards & (options.shards - 1)) != 0)
+        {
+            throw std::invalid_argument(fmt::format("Answer cache shards must be a power of two, received {}",
+                                                    options.shards));
+        }
+        if (options.capacity == 0)
+        {
+            return;
+        }
+
+        // Exactly options.capacity entries, spread as evenly as the shards allow
+        m_shardCount = options.shards;
+        while (m_shardCount > options.capacity)
+        {
+            m_shardCount /= 2;
+        }
+        const auto smallest = options.capacity / m_shardCount;
+        const auto larger = options.capacity % m_shardCount;
+        if (smallest + 1 >= EMPTY / 2)
+        {
+            throw std::invalid_argument(fmt::format("Answer cache capacity {} is too large", options.capacity));
+        }
+        m_capacity = options.capacity;
+
+        m_shards = std::make_unique<Shard[]>(m_shardCount);
+        for (std::size_t i = 0; i < m_shardCount; ++i)
+        {
+            auto& shard = m_shards[i];
+            shard.capacity = smallest + (i < larger ? 1 : 0);
+            std::size_t slots = 2;
+            while (slots < shard.capacity * 2)
+            {
+                slots *= 2;
+            }
+            shard.entries.resize(shard.capacity);
+            shard.slots.assign(slots, EMPTY);
+        }
+    }
+
+    bool AnswerCache::find(std::string_view qname, std::string_view qclass, int abiVersion, std::string_view id,
+                           Clock::time_point now, std::string& line, bool& timeBased)
+    {
+        if (!m_shards)
+        {
+            return false;
+        }
+
+        const auto hash = hashOf(qname, qclass, abiVersion);
+        auto& shard = shardOf(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        const auto index = shard.slots[findSlot(shard, hash, qname, qclass, abiVersion)];
+        if (index == EMPTY)
+        {
+            m_stats.recordAnswerCache(CacheEvent::MISS);
+            return false;
+        }
+        auto& entry = shard.entries[index];
+        if (now >= entry.expires)
+        {
+            erase(shard, index);
+            entry.live = false;
+            m_stats.recordAnswerCache(CacheEvent::EXPIRY);
+            m_stats.recordAnswerCache(CacheEvent::MISS);
+            return false;
+        }
+
+        // Whole seconds since the answer was made, as a resolver counts down
+        const auto elapsed = std::max<std::chrono::seconds::rep>(
+                0, std::chrono::duration_cast<std::chrono::seconds>(now - entry.inserted).count());
+        char ttl[24];
+        const auto ttlEnd = std::to_chars(ttl, ttl + sizeof(ttl), entry.ttl - elapsed).ptr;
+
+        entry.referenced = true;
+        line.assign(entry.line, 0, entry.ttlOffset);
+        line.append(ttl, ttlEnd);
+        line.append(entry.line, entry.ttlOffset, entry.idOffset - entry.ttlOffset);
+        line.append(id);
+        line.append(entry.line, entry.idOffset, std::string::npos);
+        timeBased = entry.timeBased;
+        m_stats.recordAnswerCache(CacheEvent::HIT);
+        return true;
+    }
+
+    void AnswerCache::insert(std::string_view qname, std::string_view qclass, int abiVersion,
+                             std::string_view line, std::size_t idOffset, std::size_t idLength,
+                             int ttl, bool timeBased, Clock::time_point now)
+    {
+        const auto ttlStart = idOffset < 2 ? std::string_view::npos : line.rfind('\t', idOffset - 2);
+        if (idOffset + idLength > line.size() || ttlStart == std::string_view::npos || line[idOffset - 1] != '\t')
+        {
+            throw std::invalid_argument(fmt::format("The id at {} of length {} does not follow a TTL in the {} byte "
+                                                    "line", idOffset, idLength, line.size()));
+        }
+        if (!m_shards || ttl <= 0)
+        {
+            return;
+        }
+
+        auto expires = now + std::chrono::seconds(ttl);
+        if (timeBased)
+        {
+            // The answer is only right during the second it was made in
+            const Clock::time_point nextSecond = std::chrono::floor<std::chrono::seconds>(now) + std::chrono::seconds(1);
+            expires = std::min(expires, nextSecond);
+        }
+
+        const auto hash = hashOf(qname, qclass, abiVersion);
+        auto& shard = shardOf(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto slot = findSlot(shard, hash, qname, qclass, abiVersion);
+        auto index = shard.slots[slot];
+        if (index == EMPTY)
+        {
+            index = claim(shard, now);
+            // Claiming may have moved slots around
+            slot = findSlot(shard, hash, qname, qclass, abiVersion);
+            shard.slots[slot] = index;
+        }
+
+        auto& entry = shard.entries[index];
+        entry.hash = hash;
+        entry.key.assign(qname);
+        entry.key += '\t';
+        entry.key.append(qclass);
+        entry.abiVersion = abiVersion;
+        entry.ttlOffset = ttlStart + 1;
+        entry.line.assign(line.substr(0, entry.ttlOffset));
+        entry.line += '\t';
+        entry.line.append(line.substr(idOffset + idLength));
+        entry.idOffset = entry.ttlOffset + 1;
+        entry.ttl = ttl;
+        entry.inserted = now;
+        entry.expires = expires;
+        entry.timeBased = timeBased;
+        entry.referenced = false;
+        entry.live = true;
+    }
+
+    std::size_t AnswerCache::clear()
+    {
+        std::size_t dropped = 0;
+        for (std::size_t i = 0; i < m_shardCount; ++i)
+        {
+            auto& shard = m_shards[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (std::size_t index = 0; index < shard.used; ++index)
+            {
+                auto& entry = shard.entries[index];
+                dropped += entry.live ? 1 : 0;
+                entry.live = false;
+                entry.referenced = false;
+            }
+            std::fill(shard.slots.begin(), shard.slots.end(), EMPTY);
+            shard.used = 0;
+            shard.hand = 0;
+        }
+        return dropped;
+    }
+
+    std::size_t AnswerCache::getSize() const
+    {
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < m_shardCount; ++i)
+        {
+            auto& shard = m_shards[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += static_cast<std::size_t>(std::count_if(
+                    shard.entries.begin(), shard.entries.begin() + static_cast<std::ptrdiff_t>(shard.used),
+                    [](const Entry& entry) { return entry.live; }));
+        }
+        return size;
+    }
+
+    AnswerCache::Shard& AnswerCache::shardOf(std::uint64_t hash) const
+    {
+        // The low bits pick the slot, so the shard comes from the high ones
+        return m_shards[(hash >> 32) & (m_shardCount - 1)];
+    }
+
+    std::size_t AnswerCache::findSlot(const Shard& shard, std::uint64_t hash, std::string_view qname,
+                                      std::string_view qclass, int abiVersion)
+    {
+        const auto mask = shard.slots.size() - 1;
+        for (auto slot = static_cast<std::size_t>(hash) & mask;; slot = (slot + 1) & mask)
+        {
+            const auto index = shard.slots[slot];
+            if (index == EMPTY)
+            {
+                return slot;
+            }
+            const auto& entry = shard.entries[index];
+            if (entry.hash == hash && entry.abiVersion == abiVersion && matches(entry.key, qname, qclass))
+            {
+                return slot;
+            }
+        }
+    }
+
+    void AnswerCache::erase(Shard& shard, std::uint32_t entry)
+    {
+        const auto mask = shard.slots.size() - 1;
+        auto hole = static_cast<std::size_t>(shard.entries[entry].hash) & mask;
+        while (shard.slots[hole] != entry)
+        {
+            hole = (hole + 1) & mask;
+        }
+
+        // Backward shift: an entry later in the run moves into the hole when
+        // the hole is between its home slot and where it is now
+        for (auto slot = (hole + 1) & mask; shard.slots[slot] != EMPTY; slot = (slot + 1) & mask)
+        {
+            const auto home = static_cast<std::size_t>(shard.entries[shard.slots[slot]].hash) & mask;
+            if (((slot - home) & mask) >= ((slot - hole) & mask))
+            {
+                shard.slots[hole] = shard.slots[slot];
+                hole = slot;
+            }
+        }
+        shard.slots[hole] = EMPTY;
+    }
+
+    std::uint32_t AnswerCache::claim(Shard& shard, Clock::time_point now)
+    {
+        if (shard.used < shard.capacity)
+        {
+            return static_cast<std::uint32_t>(shard.used++);
+        }
+
+        // Every entry is passed at most twice: once to clear its flag, once to take it
+        while (true)
+        {
+            const auto index = static_cast<std::uint32_t>(shard.hand);
+            shard.hand = (shard.hand + 1) % shard.capacity;
+            auto& entry = shard.entries[index];
+            if (!entry.live)
+            {
+                return index;
+            }
+            if (now >= entry.expires || !entry.referenced)
+            {
+                m_stats.recordAnswerCache(now >= entry.expires ? CacheEvent::EXPIRY : CacheEvent::EVICTION);
+                erase(shard, index);
+                entry.live = false;
+                return index;
+            }
+            entry.referenced = false;
+        }
+    }
+
+    std::uint64_t AnswerCache::hashOf(std::string_view qname, std::string_view qclass, int abiVersion)
+    {
+        return PerfectHash::hash(qname, PerfectHash::hash(qclass, static_cast<std::uint64_t>(abiVersion)));
+    }
+}
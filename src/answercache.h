@@ -0,0 +1,115 @@
+#pragma once
+
+#include "stats.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppbackend {
+    struct AnswerCacheOptions {
+        static constexpr std::size_t DEFAULT_CAPACITY = 65536;
+        static constexpr std::size_t DEFAULT_SHARDS = 16;
+
+        // Answers kept at most, 0 to cache none
+        std::size_t capacity = DEFAULT_CAPACITY;
+        // Each with its own lock; a power of two. Fewer are used when capacity
+        // is smaller, so every shard holds at least one answer.
+        std::size_t shards = DEFAULT_SHARDS;
+    };
+
+    // The DATA lines of recent answers, by (qname, qclass, ABI version), so a
+    // repeated query skips the zone match, the lookup, the encryption and the
+    // formatting. The id PowerDNS gives each query is spliced in on the way
+    // out, and so is the TTL left, so a cache downstream never keeps an
+    // answer longer than the record's TTL from when it was made. Entries live
+    // for the answer's TTL, and time-based answers at most until the second
+    // they were made in ends.
+    //
+    // A bounded number of entries per shard, evicted with the CLOCK algorithm:
+    // a hit only sets a flag, and the hand clears flags until it finds an entry
+    // without one. Entries and their strings are reused, so a hit copies into
+    // the caller's string without allocating and a replacement seldom does.
+    // Safe to use from several threads at once.
+    class AnswerCache {
+    public:
+        using Clock = std::chrono::system_clock;
+
+        // Throws std::invalid_argument unless options.shards is a power of two
+        AnswerCache(Stats& stats, const AnswerCacheOptions& options = {});
+
+        AnswerCache(const AnswerCache&) = delete;
+        AnswerCache& operator=(const AnswerCache&) = delete;
+
+        // Writes the cached DATA line with id and the TTL left filled in to
+        // line, reusing its storage, and sets timeBased as it was inserted
+        [[nodiscard]] bool find(std::string_view qname, std::string_view qclass, int abiVersion, std::string_view id,
+                                Clock::time_point now, std::string& line, bool& timeBased);
+        // line is the DATA line as sent, with the query's id at idOffset and
+        // the TTL in the field before it. Answers with a TTL of 0 are not kept.
+        void insert(std::string_view qname, std::string_view qclass, int abiVersion,
+                    std::string_view line, std::size_t idOffset, std::size_t idLength,
+                    int ttl, bool timeBased, Clock::time_point now);
+        // Drops every answer, keeping the memory for the next ones. Returns
+        // how many there were.
+        std::size_t clear();
+
+        [[nodiscard]] std::size_t getCapacity() const { return m_capacity; }
+        [[nodiscard]] std::size_t getSize() const;
+    private:
+        static constexpr std::uint32_t EMPTY = 0xFFFFFFFF;
+
+        struct Entry {
+            std::uint64_t hash = 0;
+            // qname, '\t', qclass: neither holds a tab, the pipe splits on them
+            std::string key{};
+            int abiVersion = 0;
+            // The DATA line without the TTL and the id
+            std::string line{};
+            std::size_t ttlOffset = 0;
+            std::size_t idOffset = 0;
+            int ttl = 0;
+            Clock::time_point inserted{};
+            Clock::time_point expires{};
+            bool timeBased = false;
+            // Set by hits, cleared as the CLOCK hand passes
+            bool referenced = false;
+            // False once found expired or cleared, for the hand to reuse
+            bool live = false;
+        };
+
+        struct Shard {
+            std::mutex mutex{};
+            // Never fewer than one
+            std::size_t capacity = 0;
+            std::vector<Entry> entries{};
+            std::size_t used = 0;
+            std::size_t hand = 0;
+            // Open addressing with linear probing: entry indexes or EMPTY, at
+            // most half full
+            std::vector<std::uint32_t> slots{};
+        };
+
+        Stats& m_stats;
+        std::size_t m_capacity = 0;
+        std::size_t m_shardCount = 0;
+        std::unique_ptr<Shard[]> m_shards;
+
+        [[nodiscard]] Shard& shardOf(std::uint64_t hash) const;
+        // The slot holding the entry for the key, or the empty slot where it would go
+        static std::size_t findSlot(const Shard& shard, std::uint64_t hash, std::string_view qname,
+                                    std::string_view qclass, int abiVersion);
+        // Empties the slot of entry, moving later entries of its probe run back
+        static void erase(Shard& shard, std::uint32_t entry);
+        // An entry to reuse: a never used one, else the first the hand finds
+        // dropped, expired or not referenced since it last passed
+        std::uint32_t claim(Shard& shard, Clock::time_point now);
+
+        static std::uint64_t hashOf(std::string_view qname, std::string_view qclass, int abiVersion);
+    };
+}
@@ -0,0 +1,79 @@
+#include "answerhandler.h"
+#include "encoder.h"
+
+#include "fmt/format.h"
+
+#include <chrono>
+#include <stdexcept>
+
+namespace cppbackend {
+    bool TxtHandler::answer(int platform, std::string_view domain, std::string& out, int& ttl) const
+    {
+        return m_records.findAnswer(domain, platform, &out, ttl);
+    }
+
+    bool EpochHandler::answer(int platform, std::string_view domain, std::string& out, int& ttl) const
+    {
+        if (!m_records.findAnswer(domain, platform, nullptr, ttl))
+        {
+            return false;
+        }
+
+        const auto cipher = m_keys.getCipher(platform);
+        if (!cipher)
+        {
+            return false;
+        }
+
+        const auto now = std::chrono::system_clock::now();
+        const auto epoch = now.time_since_epoch();
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(epoch);
+
+        OperationTimer timer{m_stats, Operation::ENCRYPT};
+        out = Encoder::toAES128(
+                fmt::format("{}", seconds.count()),
+                *cipher);
+        return true;
+    }
+
+    void AnswerHandlerRegistry::add(const std::string& name, Factory factory)
+    {
+        if (!m_factories.emplace(name, std::move(factory)).second)
+        {
+            throw std::invalid_argument(fmt::format("There already is an answer handler called '{}'", name));
+        }
+    }
+
+    std::unique_ptr<AnswerHandler> AnswerHandlerRegistry::create(const std::string& name,
+                                                                 const AnswerContext& context) const
+    {
+        const auto found = m_factories.find(name);
+        if (found == m_factories.end())
+        {
+            throw std::invalid_argument(fmt::format("Unknown answer handler '{}', expected one of: {}",
+                                                    name, fmt::join(getNames(), ", ")));
+        }
+        return found->second(context);
+    }
+
+    std::vector<std::string> AnswerHandlerRegistry::getNames() const
+    {
+        std::vector<std::string> names{};
+        for (const auto& [name, factory] : m_factories)
+        {
+            names.push_back(name);
+        }
+        return names;
+    }
+
+    const AnswerHandlerRegistry& AnswerHandlerRegistry::builtIn()
+    {
+        static const auto registry = [] {
+            AnswerHandlerRegistry result{};
+            result.add("txt", [](const AnswerContext& context) { return std::make_unique<TxtHandler>(context); });
+            result.add("epoch", [](const AnswerContext& context) { return std::make_unique<EpochHandler>(context); });
+            return result;
+        }();
+        return registry;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "keystore.h"
+#include "stats.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppbackend {
+    // Where handlers look records up; the backend answers from its snapshot
+    // when it has one and from SQLite otherwise
+    class RecordSource {
+    public:
+        virtual ~RecordSource() = default;
+
+        // The base64 answer (when answer is set) and TTL of a record
+        virtual bool findAnswer(std::string_view domain, int platform, std::string* answer, int& ttl) const = 0;
+    };
+
+    // What a handler may use, all owned by the backend and outliving it
+    struct AnswerContext {
+        const RecordSource& records;
+        const KeyStore& keys;
+        Stats& stats;
+    };
+
+    // Answers the qnames "<platform>.<domain>.<zone>" of the zones it was
+    // selected for. One instance serves all of them from several threads at
+    // once, so any cache it keeps must be safe to share.
+    class AnswerHandler {
+    public:
+        virtual ~AnswerHandler() = default;
+
+        // Sets out and ttl; false when there is no answer
+        [[nodiscard]] virtual bool answer(int platform, std::string_view domain, std::string& out, int& ttl) const = 0;
+        // Whether the answer changes with the clock rather than with the records
+        [[nodiscard]] virtual bool isTimeBased() const { return false; }
+    };
+
+    // The record's TXT, base64 encoded
+    class TxtHandler : public AnswerHandler {
+    public:
+        explicit TxtHandler(const AnswerContext& context) : m_records{context.records} {}
+
+        [[nodiscard]] bool answer(int platform, std::string_view domain, std::string& out, int& ttl) const override;
+    private:
+        const RecordSource& m_records;
+    };
+
+    // The current epoch in seconds, AES encrypted with the platform's key,
+    // for domains that have a record
+    class EpochHandler : public AnswerHandler {
+    public:
+        explicit EpochHandler(const AnswerContext& context)
+            : m_records{context.records},
+              m_keys{context.keys},
+              m_stats{context.stats}
+        {}
+
+        [[nodiscard]] bool answer(int platform, std::string_view domain, std::string& out, int& ttl) const override;
+        [[nodiscard]] bool isTimeBased() const override { return true; }
+    private:
+        const RecordSource& m_records;
+        const KeyStore& m_keys;
+        Stats& m_stats;
+    };
+
+    // Handler names, as zones refer to them, and how to make each handler.
+    // The backend makes one instance of every handler its zones name.
+    class AnswerHandlerRegistry {
+    public:
+        using Factory = std::function<std::unique_ptr<AnswerHandler>(const AnswerContext&)>;
+
+        // Throws std::invalid_argument when name is taken
+        void add(const std::string& name, Factory factory);
+        // Throws std::invalid_argument naming the handlers there are when
+        // there is none called name
+        [[nodiscard]] std::unique_ptr<AnswerHandler> create(const std::string& name, const AnswerContext& context) const;
+        [[nodiscard]] std::vector<std::string> getNames() const;
+
+        // "txt" and "epoch"
+        static const AnswerHandlerRegistry& builtIn();
+    private:
+        std::map<std::string, Factory> m_factories{};
+    };
+}
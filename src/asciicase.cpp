@@ -0,0 +1,52 @@
+#include "asciicase.h"
+
+#include <cstring>
+
+namespace cppbackend {
+    bool AsciiCase::equals(std::string_view left, std::string_view right)
+    {
+        if (left.size() != right.size())
+        {
+            return false;
+        }
+
+        std::size_t position = 0;
+        for (; position + sizeof(std::uint64_t) <= left.size(); position += sizeof(std::uint64_t))
+        {
+            std::uint64_t leftWord;
+            std::uint64_t rightWord;
+            std::memcpy(&leftWord, left.data() + position, sizeof(leftWord));
+            std::memcpy(&rightWord, right.data() + position, sizeof(rightWord));
+            if (foldWord(leftWord) != foldWord(rightWord))
+            {
+                return false;
+            }
+        }
+        if (position < left.size())
+        {
+            std::uint64_t leftWord = 0;
+            std::uint64_t rightWord = 0;
+            std::memcpy(&leftWord, left.data() + position, left.size() - position);
+            std::memcpy(&rightWord, right.data() + position, right.size() - position);
+            return foldWord(leftWord) == foldWord(rightWord);
+        }
+        return true;
+    }
+
+    void AsciiCase::lower(std::string_view text, std::string& out)
+    {
+        out.resize(text.size());
+        std::size_t position = 0;
+        for (; position + sizeof(std::uint64_t) <= text.size(); position += sizeof(std::uint64_t))
+        {
+            std::uint64_t word;
+            std::memcpy(&word, text.data() + position, sizeof(word));
+            word = foldWord(word);
+            std::memcpy(out.data() + position, &word, sizeof(word));
+        }
+        for (; position < text.size(); ++position)
+        {
+            out[position] = fold(text[position]);
+        }
+    }
+}
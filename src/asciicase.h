@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cppbackend {
+    // ASCII case folding eight bytes at a time. DNS names compare without
+    // regard to ASCII case (RFC 4343); bytes outside A-Z, including every
+    // non-ASCII byte, are left as they are.
+    class AsciiCase {
+    public:
+        // Lowercases every byte of word at once, without branches
+        static constexpr std::uint64_t foldWord(std::uint64_t word)
+        {
+            constexpr std::uint64_t ONES = 0x0101010101010101ULL;
+            // Adding to the low seven bits of a byte never carries into the next
+            // byte, and sets its top bit when the byte is past the bound
+            const std::uint64_t low = word & (0x7F * ONES);
+            const std::uint64_t aboveZ = low + (0x7F - 'Z') * ONES;
+            const std::uint64_t fromA = low + (0x80 - 'A') * ONES;
+            const std::uint64_t upper = fromA & ~aboveZ & ~word & (0x80 * ONES);
+            // 0x80 >> 2 is 0x20, the case bit
+            return word | (upper >> 2);
+        }
+
+        static constexpr char fold(char c)
+        {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+        }
+
+        // True when left and right differ at most in ASCII case
+        static bool equals(std::string_view left, std::string_view right);
+        // Writes text in lowercase to out, reusing out's storage
+        static void lower(std::string_view text, std::string& out);
+    };
+}
@@ -1,17 +1,226 @@
 #include "backend.h"
 #include "encoder.h"
+#include "logger.h"
 #include "repository.h"
 
 #include "fmt/core.h"
+#include <atomic>
+#include <charconv>
+#include <limits>
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <chrono>
 
 namespace cppbackend {
-    Backend::Backend(const std::string& dbPath)
-        : m_repository(dbPath)
+    namespace {
+        // Lock-free, so setting it from a signal handler is safe
+        std::atomic<bool> keyReloadRequested{false};
+        std::atomic<bool> statsDumpRequested{false};
+    }
+
+    Backend::Backend(const std::string& dbPath, const RepositoryOptions& options, const KeyOptions& keys,
+                     const SnapshotOptions& snapshot, const ZoneOptions& zones, const AnswerCacheOptions& cache)
+        : m_dbPath{dbPath},
+          m_defaultTTL{options.defaultTTL},
+          m_repositoryOptions{options},
+          m_repository(dbPath, options),
+          m_keyOptions{keys},
+          m_keys{loadKeys()},
+          m_answerCache{m_stats, cache},
+          m_snapshotOptions{snapshot}
+    {
+        loadZones(zones);
+        if (m_snapshotOptions.enabled)
+        {
+            reloadSnapshot();
+        }
+    }
+
+    Backend::~Backend()
+    {
+        // The builder uses the members, so it finishes its build first
+        {
+            std::lock_guard<std::mutex> lock(m_snapshotMutex);
+            m_snapshotRequested = false;
+        }
+        if (m_snapshotBuilder.joinable())
+        {
+            m_snapshotBuilder.join();
+        }
+    }
+
+    std::string Backend::getSnapshotPath() const
+    {
+        return m_snapshotOptions.path.empty() ? Snapshot::defaultPath(m_dbPath) : m_snapshotOptions.path;
+    }
+
+    void Backend::reloadSnapshot()
+    {
+        if (!m_snapshotOptions.enabled)
+        {
+            return;
+        }
+
+        const auto path = getSnapshotPath();
+        const auto current = getSnapshot();
+        if (current && current->getIdentity() == DatabaseIdentity::of(m_dbPath))
+        {
+            Logger::global().log(LogLevel::INFO, LogCategory::REPOSITORY,
+                                 "Snapshot '{}' is up to date, keeping it", path);
+            return;
+        }
+
+        try {
+            std::shared_ptr<const Snapshot> snapshot = Snapshot::load(path, m_dbPath);
+            Logger::global().log(LogLevel::INFO, LogCategory::REPOSITORY,
+                                 "Mapped snapshot '{}': {} records of {} domains, {} bytes", path,
+                                 snapshot->getRecordCount(), snapshot->getDomainCount(), snapshot->getSize());
+            publishSnapshot(std::move(snapshot));
+            return;
+        } catch (std::runtime_error&) {
+            // Missing, stale or damaged: all mean building a new one
+        }
+
+        // The current one has the previous records, SQLite has these
+        if (current)
+        {
+            publishSnapshot(nullptr);
+        }
+        Logger::global().log(LogLevel::INFO, LogCategory::REPOSITORY,
+                             "Answering from SQLite while snapshot '{}' is built", path);
+        requestSnapshotBuild();
+    }
+
+    void Backend::waitForSnapshot() const
+    {
+        std::unique_lock<std::mutex> lock(m_snapshotMutex);
+        m_snapshotBuilt.wait(lock, [this]() { return !m_snapshotBuilding; });
+    }
+
+    void Backend::requestSnapshotBuild()
+    {
+        std::lock_guard<std::mutex> lock(m_snapshotMutex);
+        m_snapshotRequested = true;
+        if (m_snapshotBuilding)
+        {
+            return;
+        }
+        if (m_snapshotBuilder.joinable())
+        {
+            // Done building, only its return is left
+            m_snapshotBuilder.join();
+        }
+        m_snapshotBuilding = true;
+        m_snapshotBuilder = std::thread(&Backend::buildSnapshots, this);
+    }
+
+    void Backend::buildSnapshots()
+    {
+        const auto path = getSnapshotPath();
+        std::unique_lock<std::mutex> lock(m_snapshotMutex);
+        while (m_snapshotRequested)
+        {
+            m_snapshotRequested = false;
+            lock.unlock();
+
+            try {
+                const auto started = std::chrono::steady_clock::now();
+                // Its own connection, so the pool doesn't keep one for every build
+                const Repository repository(m_dbPath, m_repositoryOptions);
+                std::shared_ptr<const Snapshot> snapshot = Snapshot::build(m_dbPath, repository);
+                const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - started);
+                Logger::global().log(LogLevel::INFO, LogCategory::REPOSITORY,
+                                     "Built snapshot '{}': {} records of {} domains, {} bytes in {} ms",
+                                     path, snapshot->getRecordCount(), snapshot->getDomainCount(),
+                                     snapshot->getSize(), elapsed.count());
+                try {
+                    snapshot->save(path);
+                } catch (std::runtime_error& err) {
+                    // Only the next start is slower
+                    Logger::global().log(LogLevel::WARNING, LogCategory::REPOSITORY, "{}", err.what());
+                }
+                publishSnapshot(std::move(snapshot));
+            } catch (std::exception& err) {
+                Logger::global().log(LogLevel::ERROR, LogCategory::REPOSITORY,
+                                     "Answering from SQLite, building snapshot '{}' failed: {}", path, err.what());
+            }
+
+            lock.lock();
+        }
+        m_snapshotBuilding = false;
+        m_snapshotBuilt.notify_all();
+    }
+
+    void Backend::publishSnapshot(std::shared_ptr<const Snapshot> snapshot)
+    {
+        std::atomic_store_explicit(&m_snapshot, std::move(snapshot), std::memory_order_release);
+        m_answerCache.clear();
+    }
+
+    std::map<int, std::string> Backend::loadKeys() const
+    {
+        if (!m_keyOptions.file.empty())
+        {
+            return KeyStore::readFile(m_keyOptions.file);
+        }
+        if (m_keyOptions.fromDatabase)
+        {
+            return m_repository.local().getPlatformKeys();
+        }
+        return {{KeyStore::DEFAULT_PLATFORM, PASSWORD}};
+    }
+
+    void Backend::loadZones(const ZoneOptions& options)
     {
+        auto zones = options.file.empty() ? std::vector<Zone>{} : ZoneTable::readFile(options.file);
+        zones.insert(zones.end(), options.zones.begin(), options.zones.end());
+        if (zones.empty())
+        {
+            zones = ZoneTable::DEFAULT_ZONES;
+        }
+
+        const AnswerContext context{*this, m_keys, m_stats};
+        std::map<std::string, std::uint32_t> handlerIndexes{};
+        for (const auto& zone : zones)
+        {
+            try {
+                auto [handler, added] = handlerIndexes.emplace(zone.handler,
+                                                               static_cast<std::uint32_t>(m_handlers.size()));
+                if (added)
+                {
+                    m_handlers.push_back(AnswerHandlerRegistry::builtIn().create(zone.handler, context));
+                }
+                m_zones.add(zone.name, handler->second);
+            } catch (std::invalid_argument& err) {
+                if (zone.source.empty())
+                {
+                    throw;
+                }
+                throw std::invalid_argument(fmt::format("{}: {}", zone.source, err.what()));
+            }
+        }
+        Logger::global().log(LogLevel::INFO, LogCategory::CONTROL, "Serving {} zones with {} handlers",
+                             m_zones.getZoneCount(), m_handlers.size());
+    }
+
+    void Backend::reloadKeys()
+    {
+        m_keys.replace(loadKeys());
+        // Epoch answers were encrypted with the previous keys
+        m_answerCache.clear();
+    }
+
+    void Backend::requestKeyReload()
+    {
+        keyReloadRequested.store(true, std::memory_order_relaxed);
+    }
+
+    void Backend::requestStatsDump()
+    {
+        statsDumpRequested.store(true, std::memory_order_relaxed);
     }
 
     InputResult Backend::performHandshake(std::istream& input)
@@ -33,95 +242,296 @@ namespace cppbackend {
 
             const auto banner = fmt::format("{}CPP backend starting",
                                             HANDSHAKE_RESPONSE_SUCCESS);
-            writeResponse(banner);
+            endResponse(std::cout, banner);
 
             return InputResult(true, banner);
         }
         else
         {
-            writeLog(fmt::format("Received '{}'", line));
+            Logger::global().log(LogLevel::WARNING, LogCategory::PROTOCOL, "Bad handshake '{}'", line);
 
             const auto banner = RESPONSE_FAIL;
-            writeResponse(banner);
+            endResponse(std::cout, banner);
 
             return InputResult(false, banner);
         }
     }
 
-    std::vector<InputResult> Backend::readFromInput(std::istream& input) const
+    std::vector<InputResult> Backend::readFromInput(std::istream& input, std::ostream& output)
     {
-        std::vector<InputResult> results{};
+        std::vector<InputResult> failures{};
+        auto& logger = Logger::global();
 
         std::string line;
+        // Kept across queries, so a cached answer is copied into capacity it already has
+        std::string answer{};
+        std::size_t linesSinceSample = 0;
         while (std::getline(input, line))
         {
-            writeLog(fmt::format("Received '{}'", line));
+            if (++linesSinceSample == PAGE_CACHE_SAMPLE_LINES)
+            {
+                samplePageCache();
+                linesSinceSample = 0;
+            }
+            if (keyReloadRequested.exchange(false, std::memory_order_relaxed))
+            {
+                try {
+                    reloadKeys();
+                    logger.log(LogLevel::INFO, LogCategory::KEYS, "Reloaded keys, generation {}", m_keys.getGeneration());
+                } catch (std::exception& err) {
+                    logger.log(LogLevel::ERROR, LogCategory::KEYS, "Keeping the current keys, reload failed: {}", err.what());
+                }
+            }
+            if (statsDumpRequested.exchange(false, std::memory_order_relaxed))
+            {
+                // After the log lines already queued, so the dump isn't split by them
+                logger.flush();
+                samplePageCache();
+                std::cerr << m_stats.toPrometheus() << std::flush;
+            }
+
+            const auto started = std::chrono::steady_clock::now();
+            const auto finish = [this, started](QueryClass queryClass, QueryResult result) {
+                m_stats.recordQuery(m_abi, queryClass, result, std::chrono::steady_clock::now() - started);
+            };
+
+            logger.log(LogLevel::DEBUG, LogCategory::QUERY, "Received '{}'", line);
+
+            // "CMD\t<command>": PowerDNS relays every line up to END to the operator
+            if (m_abi >= MIN_COMMAND_ABI_VERSION &&
+                line.size() > REQUEST_COMMAND.size() && line[REQUEST_COMMAND.size()] == '\t' &&
+                line.compare(0, REQUEST_COMMAND.size(), REQUEST_COMMAND) == 0)
+            {
+                output << performCommand(line.substr(REQUEST_COMMAND.size() + 1));
+                endResponse(output, RESPONSE_END);
+
+                continue;
+            }
 
             std::vector<std::string> parsed = Backend::split(line, '\t');
             if (parsed.size() != Backend::getABIParameterCount(m_abi))
             {
-                writeResponse("LOG\tReceived unparseable line");
-
-                const auto banner = RESPONSE_FAIL;
-                writeResponse(banner);
+                logger.log(LogLevel::WARNING, LogCategory::PROTOCOL, "Unparseable line '{}'", line);
+                writeResponse(output, "LOG\tReceived unparseable line");
+                endResponse(output, RESPONSE_FAIL);
 
-                results.emplace_back(InputResult{false, banner});
+                failures.emplace_back(InputResult{false, fmt::format("Unparseable line '{}'", line)});
+                finish(QueryClass::MALFORMED, QueryResult::FAIL);
 
                 continue;
             }
 
-            const auto type = parsed[0];
-            const auto qname = parsed[1];
-            const auto qclass = parsed[2];
-            const auto qtype = parsed[3];
-            const auto id = parsed[4];
+            const auto& type = parsed[0];
+            const auto& qname = parsed[1];
+            const auto& qclass = parsed[2];
+            const auto& qtype = parsed[3];
+            const auto& id = parsed[4];
 
             if (type != "Q")
             {
-                writeResponse(fmt::format("LOG\tReceived a bad request type: '{}'", type));
+                logger.log(LogLevel::WARNING, LogCategory::PROTOCOL, "Bad request type '{}'", type);
+                writeResponse(output, fmt::format("LOG\tReceived a bad request type: '{}'", type));
+                endResponse(output, RESPONSE_FAIL);
+                failures.emplace_back(InputResult{false, fmt::format("Bad request type '{}'", type)});
+                finish(QueryClass::MALFORMED, QueryResult::FAIL);
 
-                const auto banner = RESPONSE_FAIL;
-                writeResponse(banner);
-                results.emplace_back(InputResult{false, banner});
+                continue;
+            }
+
+            // There is never data of other types, and saying so with a bare END
+            // keeps PowerDNS from treating the backend as failed
+            if (!isAnsweredType(qtype))
+            {
+                endResponse(output, RESPONSE_END);
+                finish(QueryClass::MISS, QueryResult::END);
 
                 continue;
             }
 
-            if (qtype != "TXT")
+            // Taken before the answer is made, so an epoch answer is never
+            // kept past the second it belongs to
+            const auto now = AnswerCache::Clock::now();
+            bool timeBased = false;
+            if (!m_answerCache.find(qname, qclass, m_abi, id, now, answer, timeBased))
             {
-                writeResponse(fmt::format("LOG\tReceived a '{}' type message. Can only process 'TXT' type messages", qtype));
+                std::string data{};
+                int ttl = 0;
+                if (!performQuery(qname, data, ttl))
+                {
+                    // No such name, or not one of ours: an answer, not an error.
+                    // FAIL is kept for lines we can't parse, since PowerDNS treats
+                    // it as a backend fault and may restart the co-process.
+                    endResponse(output, RESPONSE_END);
+                    finish(QueryClass::MISS, QueryResult::END);
 
-                const auto banner = RESPONSE_FAIL;
-                writeResponse(banner);
-                results.emplace_back(InputResult{false, banner});
+                    continue;
+                }
 
-                continue;
+                answer = formatResponse(qname, qclass, id, data, m_abi, ttl);
+                timeBased = isEpochQuery(qname);
+                // The line ends with the id, a tab and the quoted answer
+                const auto idOffset = answer.size() - data.size() - 3 - id.size();
+                m_answerCache.insert(qname, qclass, m_abi, answer, idOffset, id.size(), ttl, timeBased, now);
             }
 
-            std::string output{};
-            if (!performQuery(qname, output))
+            if (m_queryLog)
             {
-                writeResponse(fmt::format("LOG\tqname '{}' is invalid", qname));
+                m_queryLog->record(qname);
+            }
 
-                const auto banner = RESPONSE_FAIL;
-                writeResponse(banner);
-                results.emplace_back(InputResult{false, banner});
+            writeResponse(output, answer);
 
-                continue;
+            logger.log(LogLevel::DEBUG, LogCategory::QUERY, "End of data");
+
+            endResponse(output, RESPONSE_END);
+            finish(timeBased ? QueryClass::EPOCH : QueryClass::HIT, QueryResult::DATA);
+        }
+        samplePageCache();
+
+        return failures;
+    }
+
+    WarmUpResult Backend::warmUp(const std::vector<std::string>& qnames, std::chrono::milliseconds budget)
+    {
+        const auto& repository = m_repository.local();
+        const auto hitsBefore = repository.getPageCacheHits();
+        const auto missesBefore = repository.getPageCacheMisses();
+        const auto started = std::chrono::steady_clock::now();
+        const auto deadline = started + budget;
+
+        WarmUpResult result{};
+        std::string output{};
+        for (const auto& qname : qnames)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                result.complete = false;
+                break;
+            }
+            ++result.queries;
+            output.clear();
+            try {
+                if (performQuery(qname, output))
+                {
+                    ++result.answered;
+                }
+            } catch (std::exception& err) {
+                // Only warming up; the real query will report it
+                Logger::global().log(LogLevel::DEBUG, LogCategory::QUERY, "Warm-up of '{}' failed: {}", qname, err.what());
             }
+        }
 
-            auto banner = formatResponse(qname, qclass, id, output, m_abi);
-            writeResponse(banner);
-            results.emplace_back(InputResult{true, banner});
+        result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        // reload() may swap the connection, but never during a warm-up
+        const auto hits = repository.getPageCacheHits() - hitsBefore;
+        result.pagesLoaded = repository.getPageCacheMisses() - missesBefore;
+        if (hits + result.pagesLoaded > 0)
+        {
+            result.pageCacheHitRatio = static_cast<double>(hits) / static_cast<double>(hits + result.pagesLoaded);
+        }
+        samplePageCache();
 
-            writeLog("End of data");
+        return result;
+    }
 
-            banner = RESPONSE_END;
-            writeResponse(banner);
-            results.emplace_back(InputResult{true, banner});
+    void Backend::samplePageCache()
+    {
+        const auto& repository = m_repository.local();
+        m_stats.setPageCache(m_pageCacheHitsBefore + repository.getPageCacheHits(),
+                             m_pageCacheMissesBefore + repository.getPageCacheMisses());
+    }
+
+    std::string Backend::performCommand(const std::string& command)
+    {
+        auto& logger = Logger::global();
+        logger.log(LogLevel::INFO, LogCategory::CONTROL, "Command '{}'", command);
+
+        std::vector<std::string> words{};
+        for (auto& word : split(command, ' '))
+        {
+            if (!word.empty())
+            {
+                words.push_back(std::move(word));
+            }
+        }
+        const auto name = words.empty() ? std::string{} : words[0];
+        const auto argument = words.size() > 1 ? words[1] : std::string{};
+
+        try {
+            if (name == "help" && words.size() == 1)
+            {
+                return COMMAND_HELP;
+            }
+            if (name == "stats" && words.size() == 1)
+            {
+                samplePageCache();
+                return m_stats.toPrometheus();
+            }
+            if (name == "cache-flush" && words.size() == 1)
+            {
+                const auto released = m_repository.local().releaseCache();
+                return fmt::format("Released {} bytes of page cache and {} cached answers\n",
+                                   released, m_answerCache.clear());
+            }
+            if (name == "cache-warm" && words.size() == 1)
+            {
+                const auto started = std::chrono::steady_clock::now();
+                const auto rows = m_repository.local().warmCache();
+                const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - started);
+                return fmt::format("Read {} records in {} ms\n", rows, elapsed.count());
+            }
+            if (name == "reload" && words.size() == 1)
+            {
+                // The new connection counts from 0, so carry the old one's totals
+                samplePageCache();
+                m_repository.reload();
+                m_pageCacheHitsBefore = m_stats.getPageCacheHits();
+                m_pageCacheMissesBefore = m_stats.getPageCacheMisses();
+                samplePageCache();
+                m_answerCache.clear();
+                reloadSnapshot();
+                reloadKeys();
+                logger.log(LogLevel::INFO, LogCategory::CONTROL, "Reloaded the database, keys generation {}",
+                           m_keys.getGeneration());
+                return fmt::format("Reloaded the database and keys, keys generation {}\n", m_keys.getGeneration());
+            }
+            if (name == "capture-save" && words.size() == 1)
+            {
+                if (!m_queryLog)
+                {
+                    return "Not capturing, start with --capture-file to capture\n";
+                }
+                return fmt::format("Wrote {} qnames to '{}'\n", m_queryLog->save(), m_queryLog->getPath());
+            }
+            if (name == "log-level" && words.size() <= 2)
+            {
+                if (!argument.empty())
+                {
+                    logger.setLevel(Logger::parseLevel(argument));
+                }
+                return fmt::format("Log level {}\n", Logger::toString(logger.getLevel()));
+            }
+            if (name == "log-rate" && words.size() <= 2)
+            {
+                if (!argument.empty())
+                {
+                    std::size_t parsed = 0;
+                    const auto rate = std::stoul(argument, &parsed);
+                    if (parsed != argument.size() || rate > std::numeric_limits<std::uint32_t>::max())
+                    {
+                        throw std::invalid_argument(fmt::format("'{}' is not a rate", argument));
+                    }
+                    logger.setRateLimit(static_cast<std::uint32_t>(rate));
+                }
+                return fmt::format("Log rate {} per second\n", logger.getRateLimit());
+            }
+        } catch (std::exception& err) {
+            logger.log(LogLevel::WARNING, LogCategory::CONTROL, "Command '{}' failed: {}", command, err.what());
+            return fmt::format("Error: {}\n", err.what());
         }
 
-        return results;
+        return fmt::format("Unknown command '{}', use 'help' for the list\n", command);
     }
 
     int Backend::getABIParameterCount(int abiVersion)
@@ -153,104 +563,133 @@ namespace cppbackend {
                                         const std::string& qclass,
                                         const std::string& id,
                                         const std::string& data,
-                                        int abiVersion)
+                                        int abiVersion,
+                                        int ttl)
     {
         std::string output;
         if (abiVersion == 1 || abiVersion == 2)
         {
-            output = fmt::format("DATA\t{}\t{}\tTXT\t3600\t{}\t\"{}\"",
-                                 qname, qclass, id, data);
+            output = fmt::format("DATA\t{}\t{}\tTXT\t{}\t{}\t\"{}\"",
+                                 qname, qclass, ttl, id, data);
         }
         else if (abiVersion == 3)
         {
-            output = fmt::format("DATA\t21\t1\t{}\t{}\tTXT\t3600\t{}\t\"{}\"",
-                                 qname, qclass, id, data);
+            output = fmt::format("DATA\t21\t1\t{}\t{}\tTXT\t{}\t{}\t\"{}\"",
+                                 qname, qclass, ttl, id, data);
         }
 
         return output;
     }
 
-    void Backend::writeLog(const std::string& message)
+    bool Backend::findAnswer(std::string_view domain, int platform, std::string* answer, int& ttl) const
+    {
+        OperationTimer timer{m_stats, Operation::LOOKUP};
+
+        if (const auto snapshot = getSnapshot())
+        {
+            std::string_view found{};
+            // An empty TXT is no answer, as with SQLite below
+            if (!snapshot->find(domain, platform, found, ttl) || found.empty())
+            {
+                ttl = m_defaultTTL;
+                return false;
+            }
+            if (ttl == Snapshot::NO_TTL)
+            {
+                ttl = m_defaultTTL;
+            }
+            if (answer)
+            {
+                answer->assign(found);
+            }
+            return true;
+        }
+
+        const auto txtRecord = m_repository.getTXTRecord(std::string(domain), platform, ttl);
+        if (txtRecord.empty())
+        {
+            return false;
+        }
+        if (answer)
+        {
+            *answer = Encoder::toBase64(txtRecord);
+        }
+        return true;
+    }
+
+    bool Backend::isEpochQuery(std::string_view qname) const
     {
-        std::cerr << message << std::endl;
+        const auto zone = matchZone(qname);
+        return zone && m_handlers[zone.value]->isTimeBased();
     }
 
-    void Backend::writeResponse(const std::string& message)
+    ZoneTable::Match Backend::matchZone(std::string_view qname) const
     {
-        std::cout << message << std::endl;
+        // The zone is what follows "<platform>.<domain>.", so 1.oc.testnet is
+        // domain oc under testnet although oc.testnet is a zone too
+        const auto first = qname.find('.');
+        const auto second = first == std::string_view::npos ? first : qname.find('.', first + 1);
+        if (second == std::string_view::npos)
+        {
+            return {};
+        }
+        const auto zone = m_zones.match(qname, second);
+        return zone.prefixLength == second ? zone : ZoneTable::Match{};
+    }
+
+    bool Backend::isAnsweredType(const std::string& qtype)
+    {
+        return qtype == QTYPE_TXT || qtype == QTYPE_ANY;
+    }
+
+    void Backend::writeResponse(std::ostream& output, const std::string& message)
+    {
+        output << message << '\n';
+    }
+
+    void Backend::endResponse(std::ostream& output, const std::string& message)
+    {
+        // One flush per answer; PowerDNS waits for the END or FAIL line anyway
+        output << message << '\n';
+        output.flush();
     }
 
     bool Backend::performQuery(const std::string& qname, std::string& out) const
+    {
+        int ttl = 0;
+        return performQuery(qname, out, ttl);
+    }
+
+    bool Backend::performQuery(const std::string& qname, std::string& out, int& ttl) const
     {
         if (qname.empty())
         {
             return false;
         }
 
-        const auto parts = split(qname, '.');
-        const auto numParts = parts.size();
-
-        // TODO: De-duplicate this code - move into a lambda
-        if (numParts == 3 &&
-            parts[2] == "testnet")
+        const auto zone = matchZone(qname);
+        if (!zone)
         {
-            const auto platform = parts[0];
-            int platformNbr = 0;
-            try {
-                platformNbr = std::stoi(platform);
-                if (platformNbr < 1 || platformNbr > 5)
-                {
-                    return false;
-                }
-            } catch (...) {
-                return false;
-            }
-
-            const auto domain = parts[1];
-
-            const auto txtRecord = m_repository.getTXTRecord(domain, platformNbr);
-            if (txtRecord.empty())
-            {
-                return false;
-            }
-
-            out = Encoder::toBase64(txtRecord);
-            return true;
+            return false;
         }
-        else if (numParts == 4 &&
-                (parts[2] == "oc" && parts[3] == "testnet"))
+        const auto prefix = std::string_view(qname).substr(0, zone.prefixLength);
+        const auto dot = prefix.find('.');
+
+        int platformNbr = 0;
+        const auto platform = prefix.substr(0, dot);
+        const auto parsed = std::from_chars(platform.data(), platform.data() + platform.size(), platformNbr);
+        if (parsed.ec != std::errc{} || parsed.ptr != platform.data() + platform.size() ||
+            platformNbr < 1 || platformNbr > 5)
         {
-            const auto platform = parts[0];
-            int platformNbr = 0;
-            try {
-                platformNbr = std::stoi(platform);
-                if (platformNbr < 1 || platformNbr > 5)
-                {
-                    return false;
-                }
-            } catch (...) {
-                return false;
-            }
-
-            const auto domain = parts[1];
-
-            const auto txtRecord = m_repository.getTXTRecord(domain, platformNbr);
-            if (txtRecord.empty())
-            {
-                return false;
-            }
-
-            const auto now = std::chrono::system_clock::now();
-            const auto epoch = now.time_since_epoch();
-            const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(epoch);
+            return false;
+        }
 
-            out = Encoder::toAES128(
-                    fmt::format("{}", seconds.count()),
-                    PASSWORD);
-            return true;
+        const auto domain = prefix.substr(dot + 1);
+        if (domain.empty())
+        {
+            return false;
         }
 
-        // Not 3 or 4 parts as expected, so an invalid request
-        return false;
+        return m_handlers[zone.value]->answer(platformNbr, domain, out, ttl);
     }
 }
@@ -1,8 +1,24 @@
 #pragma once
 
-#include "repository.h"
+#include "answercache.h"
+#include "answerhandler.h"
+#include "keystore.h"
+#include "querylog.h"
+#include "repositorypool.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "zonetable.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <iostream>
@@ -22,46 +38,188 @@ namespace cppbackend {
         const std::string m_message;
     };
 
-    class Backend {
+    struct WarmUpResult {
+        std::size_t queries = 0;
+        std::size_t answered = 0;
+        std::chrono::milliseconds elapsed{0};
+        // Database pages read into the page cache, and the share of page
+        // lookups the cache already had, during the warm-up
+        std::int64_t pagesLoaded = 0;
+        double pageCacheHitRatio = 0.0;
+        // False when the time budget ran out before every qname was resolved
+        bool complete = true;
+    };
+
+    class Backend : private RecordSource {
     public:
-        explicit Backend(const std::string& dbPath);
-        ~Backend() = default;
+        explicit Backend(const std::string& dbPath,
+                         const RepositoryOptions& options = {},
+                         const KeyOptions& keys = {},
+                         const SnapshotOptions& snapshot = {},
+                         const ZoneOptions& zones = {},
+                         const AnswerCacheOptions& cache = {});
+        // Waits for a snapshot build in the background to finish
+        ~Backend() override;
 
         [[nodiscard]] InputResult performHandshake(std::istream& input);
-        [[nodiscard]] std::vector<InputResult> readFromInput(std::istream& input) const;
+        // Answers every line of input on output until input ends. Returns the
+        // lines answered with FAIL, each with why; answers are not kept, so a
+        // long-running pipe doesn't hold on to them.
+        [[nodiscard]] std::vector<InputResult> readFromInput(std::istream& input, std::ostream& output = std::cout);
+
+        // Re-reads the keys from where KeyOptions points and swaps them in.
+        // On failure the current keys stay in use and the error is thrown.
+        void reloadKeys();
+        // Async-signal-safe: asks readFromInput to reload the keys before it
+        // handles the next line. main() calls this from its SIGHUP handler.
+        static void requestKeyReload();
+
+        // Swaps in the snapshot for the database as it is now, unless the
+        // current one was made from the same database. A snapshot file that
+        // matches is mapped right away. Otherwise SQLite answers while a thread
+        // builds a new one, since a large table takes longer than PowerDNS
+        // waits for HELO, and the snapshot is swapped in once it is done.
+        // Lookups in flight finish on the previous one, which is freed after
+        // the last of them. Only when SnapshotOptions::enabled.
+        void reloadSnapshot();
+        // The snapshot lookups use, nullptr when they go to SQLite
+        [[nodiscard]] std::shared_ptr<const Snapshot> getSnapshot() const
+        {
+            return std::atomic_load_explicit(&m_snapshot, std::memory_order_acquire);
+        }
+        // Blocks until no snapshot is being built
+        void waitForSnapshot() const;
+        // Async-signal-safe: asks readFromInput to write getStats() to stderr
+        // before it handles the next line. main() calls this from its SIGUSR1 handler.
+        static void requestStatsDump();
+
+        // Resolves qnames through performQuery, so their database pages are
+        // cached before the first real query. Stops early when budget runs out.
+        WarmUpResult warmUp(const std::vector<std::string>& qnames, std::chrono::milliseconds budget);
+        // Records the qname of every answered query in log, which must outlive
+        // the backend's use of it. nullptr stops recording.
+        void setQueryLog(QueryLog* log) { m_queryLog = log; }
+
+        // Runs one line of the CMD channel (ABI 3, from `pdns_control
+        // backend-cmd`) and returns its output, one or more '\n'-terminated
+        // lines. Errors are reported in the output rather than thrown, since
+        // PowerDNS only relays the text to the operator. See COMMAND_HELP.
+        [[nodiscard]] std::string performCommand(const std::string& command);
 
+        // Latencies and counters for everything this backend has answered
+        [[nodiscard]] const Stats& getStats() const { return m_stats; }
+
+        // Safe to call from several threads at once; each thread gets its own
+        // database connection from the pool
         [[nodiscard]] bool performQuery(const std::string& qname, std::string& out) const;
+        // Also sets ttl to the answer's TTL in seconds
+        [[nodiscard]] bool performQuery(const std::string& qname, std::string& out, int& ttl) const;
 
         [[nodiscard]] inline int getAbiVersion() const { return m_abi; }
 
+        static std::vector<std::string> split(const std::string& s, char delimiter);
+        static std::string formatResponse(const std::string& qname,
+                                          const std::string& qclass,
+                                          const std::string& id,
+                                          const std::string& data,
+                                          int abiVersion,
+                                          int ttl = RepositoryOptions::DEFAULT_TTL);
+
+        // Whether readFromInput answers this qtype. The only records are TXT,
+        // so ANY gets the TXT set too; anything else gets an empty END.
+        [[nodiscard]] static bool isAnsweredType(const std::string& qtype);
+        // Whether qname asks for an encrypted epoch rather than a stored record
+        [[nodiscard]] bool isEpochQuery(std::string_view qname) const;
+
         static inline std::string const HANDSHAKE_REQUEST_ABI1 = "HELO\t1";
         static inline std::string const HANDSHAKE_REQUEST_ABI2 = "HELO\t2";
         static inline std::string const HANDSHAKE_REQUEST_ABI3 = "HELO\t3";
         static inline std::string const HANDSHAKE_RESPONSE_SUCCESS = "OK\t";
         static inline std::string const RESPONSE_FAIL = "FAIL";
         static inline std::string const RESPONSE_END = "END";
+        static inline std::string const QTYPE_TXT = "TXT";
+        static inline std::string const QTYPE_ANY = "ANY";
+        static inline std::string const REQUEST_COMMAND = "CMD";
+        static inline std::string const COMMAND_HELP =
+                "help                 this list\n"
+                "stats                latency histograms and counters in Prometheus text format\n"
+                "cache-flush          free the database page cache of the query connection and drop the cached answers\n"
+                "cache-warm           read every record once to fill the database page cache\n"
+                "reload               reopen the database and reload the keys\n"
+                "capture-save         write the captured qnames to the capture file now\n"
+                "log-level [LEVEL]    show or set the log level: off, error, warning, info or debug\n"
+                "log-rate [N]         show or set the log messages per category per second, 0 for no limit\n";
     private:
         static constexpr int MIN_ABI_VERSION = 1;
         static constexpr int MAX_ABI_VERSION = 3;
         static constexpr int ABI_PARAMS[] = {6, 7, 8};
+        // The first ABI version whose pipe carries CMD lines
+        static constexpr int MIN_COMMAND_ABI_VERSION = 3;
+        // Lines between copies of the page cache counters into m_stats
+        static constexpr std::size_t PAGE_CACHE_SAMPLE_LINES = 1024;
 
         // Yep, put the password in the source code. Terrible idea, especially in the
         // header. This is a proof of concept project, not production code. Forgive me.
         // Also, the password is padded with * to bring it to the minimum 16 characters
-        // required for AES-128.
+        // required for AES-128. Only used for every platform when KeyOptions names no
+        // key source.
         static inline std::string const PASSWORD = "SECRET_PASS*****";
 
         int m_abi = 0;
-        Repository m_repository;
+        const std::string m_dbPath;
+        const int m_defaultTTL;
+        const RepositoryOptions m_repositoryOptions;
+        RepositoryPool m_repository;
+        // Page cache counts of the query thread's connections before its
+        // current one, so the totals in m_stats keep growing across reloads
+        std::int64_t m_pageCacheHitsBefore = 0;
+        std::int64_t m_pageCacheMissesBefore = 0;
+        const KeyOptions m_keyOptions;
+        KeyStore m_keys;
+        // Recording only takes relaxed atomics, so the const query path may update it
+        mutable Stats m_stats;
+        QueryLog* m_queryLog = nullptr;
+        // In front of performQuery for readFromInput; cleared whenever the
+        // records or keys may have changed
+        AnswerCache m_answerCache;
+
+        const SnapshotOptions m_snapshotOptions;
+        // Only read and replaced with the std::atomic_ functions. Each lookup
+        // holds a reference, so a replaced snapshot lives until the last
+        // lookup on it ends.
+        std::shared_ptr<const Snapshot> m_snapshot{};
+        // The builder runs while a build is requested, so a reload during a
+        // build makes it build once more for the database as it is then
+        mutable std::mutex m_snapshotMutex;
+        mutable std::condition_variable m_snapshotBuilt;
+        bool m_snapshotRequested = false;
+        bool m_snapshotBuilding = false;
+        std::thread m_snapshotBuilder;
+
+        // Every zone served, its value the index of its handler here
+        ZoneTable m_zones{};
+        std::vector<std::unique_ptr<AnswerHandler>> m_handlers{};
+
+        std::map<int, std::string> loadKeys() const;
+        [[nodiscard]] std::string getSnapshotPath() const;
+        // Starts the builder thread unless it is running already
+        void requestSnapshotBuild();
+        void buildSnapshots();
+        void publishSnapshot(std::shared_ptr<const Snapshot> snapshot);
+        // Makes one handler of each name the zones use. Throws
+        // std::invalid_argument for a bad or repeated zone or an unknown handler.
+        void loadZones(const ZoneOptions& options);
+        // The zone of a "<platform>.<domain>.<zone>" qname, with
+        // "<platform>.<domain>" as its prefix; no zone for any other qname
+        [[nodiscard]] ZoneTable::Match matchZone(std::string_view qname) const;
+        void samplePageCache();
+        // The base64 answer (when answer is set) and TTL of a record, from the
+        // snapshot when there is one
+        bool findAnswer(std::string_view domain, int platform, std::string* answer, int& ttl) const override;
 
         static int getABIParameterCount(int abiVersion);
-        static std::vector<std::string> split(const std::string& s, char delimiter);
-        static std::string formatResponse(const std::string& qname,
-                                          const std::string& qclass,
-                                          const std::string& id,
-                                          const std::string& data,
-                                          int abiVersion);
-        static void writeLog(const std::string& message);
-        static void writeResponse(const std::string& message);
+        // Responses are flushed once per answer, by endResponse with its END or FAIL
+        static void writeResponse(std::ostream& output, const std::string& message);
+        static void endResponse(std::ostream& output, const std::string& message);
     };
 }
@@ -0,0 +1,251 @@
+#include "base64encoder.h"
+#include "cryptopp/config.h"
+#include "cryptopp/cpu.h"
+
+#include <stdexcept>
+
+// The vector paths follow Wojciech Muła's "Faster Base64 Encoding with SIMD"
+// (http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html): shuffle each
+// 3 byte group into a 32 bit lane, split it into four 6 bit indices with two
+// multiplies, then map the indices to ASCII with one byte shuffle.
+#if (CRYPTOPP_BOOL_X86 || CRYPTOPP_BOOL_X32 || CRYPTOPP_BOOL_X64) && (defined(__GNUC__) || defined(__clang__))
+#define CPPBACKEND_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+namespace cppbackend {
+    namespace {
+        constexpr char ALPHABET[] =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                "abcdefghijklmnopqrstuvwxyz"
+                "0123456789+/";
+
+        using EncodeFunction = void (*)(const unsigned char*, std::size_t, char*);
+
+        Base64Encoder::Implementation detectImplementation()
+        {
+#ifdef CPPBACKEND_BASE64_X86
+            if (CryptoPP::HasAVX2())
+            {
+                return Base64Encoder::Implementation::AVX2;
+            }
+            if (CryptoPP::HasSSSE3())
+            {
+                return Base64Encoder::Implementation::SSSE3;
+            }
+#endif
+            return Base64Encoder::Implementation::SCALAR;
+        }
+
+#ifdef CPPBACKEND_BASE64_X86
+        __attribute__((target("ssse3")))
+        __m128i encodeBlockSSSE3(__m128i in)
+        {
+            // [?|LKJ|IHG|FED|CBA] -> one 3 byte group per 32 bit lane, arranged
+            // so the multiplies below can pull out the 6 bit fields
+            in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10,
+                                                   7, 8, 6, 7,
+                                                   4, 5, 3, 4,
+                                                   1, 2, 0, 1));
+
+            const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+            const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+            const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+            const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+            const __m128i indices = _mm_or_si128(t1, t3);
+
+            // Map 0..25, 26..51, 52..61, 62 and 63 to a shuffle slot holding the
+            // offset from the index to its ASCII character
+            __m128i slot = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+            const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+            slot = _mm_or_si128(slot, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+            const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                                                  '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                  '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                  '/' - 63, 'A', 0, 0);
+
+            return _mm_add_epi8(_mm_shuffle_epi8(offsets, slot), indices);
+        }
+
+        __attribute__((target("avx2")))
+        __m256i encodeBlockAVX2(__m256i in)
+        {
+            // Same steps as encodeBlockSSSE3, on two 12 byte groups at once
+            in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                         10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+            const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+            const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+            const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+            const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+            const __m256i indices = _mm256_or_si256(t1, t3);
+
+            __m256i slot = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+            const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+            slot = _mm256_or_si256(slot, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+
+            const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                                                     '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                     '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                     '/' - 63, 'A', 0, 0,
+                                                     'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                                                     '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                     '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                     '/' - 63, 'A', 0, 0);
+
+            return _mm256_add_epi8(_mm256_shuffle_epi8(offsets, slot), indices);
+        }
+
+        // Encodes whole 12 byte groups while a full 16 byte load stays inside
+        // the input, returning how many input bytes were consumed
+        __attribute__((target("ssse3")))
+        std::size_t encodeBlocksSSSE3(const unsigned char* in, std::size_t length, char* out)
+        {
+            std::size_t consumed = 0;
+            while (length - consumed >= 16)
+            {
+                const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + consumed));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), encodeBlockSSSE3(block));
+                consumed += 12;
+                out += 16;
+            }
+            return consumed;
+        }
+
+        __attribute__((target("avx2")))
+        std::size_t encodeBlocksAVX2(const unsigned char* in, std::size_t length, char* out)
+        {
+            // Two 16 byte loads, 12 bytes apart, so 28 bytes must be readable
+            std::size_t consumed = 0;
+            while (length - consumed >= 28)
+            {
+                const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + consumed));
+                const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + consumed + 12));
+                const __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), encodeBlockAVX2(block));
+                consumed += 24;
+                out += 32;
+            }
+            return consumed;
+        }
+
+        void encodeWithSSSE3(const unsigned char* in, std::size_t length, char* out)
+        {
+            const auto consumed = encodeBlocksSSSE3(in, length, out);
+            Base64Encoder::encodeScalar(in + consumed, length - consumed, out + consumed / 3 * 4);
+        }
+
+        void encodeWithAVX2(const unsigned char* in, std::size_t length, char* out)
+        {
+            auto consumed = encodeBlocksAVX2(in, length, out);
+            // AVX2 implies SSSE3; finish the 16..27 byte tail 12 bytes at a time
+            consumed += encodeBlocksSSSE3(in + consumed, length - consumed, out + consumed / 3 * 4);
+            Base64Encoder::encodeScalar(in + consumed, length - consumed, out + consumed / 3 * 4);
+        }
+#endif
+
+        EncodeFunction selectEncoder()
+        {
+            switch (detectImplementation())
+            {
+#ifdef CPPBACKEND_BASE64_X86
+                case Base64Encoder::Implementation::AVX2:
+                    return &encodeWithAVX2;
+                case Base64Encoder::Implementation::SSSE3:
+                    return &encodeWithSSSE3;
+#endif
+                default:
+                    return &Base64Encoder::encodeScalar;
+            }
+        }
+    }
+
+    void Base64Encoder::encode(const unsigned char* in, std::size_t length, char* out)
+    {
+        static const EncodeFunction encoder = selectEncoder();
+        encoder(in, length, out);
+    }
+
+    void Base64Encoder::encodeScalar(const unsigned char* in, std::size_t length, char* out)
+    {
+        std::size_t i = 0;
+        for (; i + 3 <= length; i += 3)
+        {
+            const unsigned int group = (in[i] << 16u) | (in[i + 1] << 8u) | in[i + 2];
+            *out++ = ALPHABET[(group >> 18u) & 0x3fu];
+            *out++ = ALPHABET[(group >> 12u) & 0x3fu];
+            *out++ = ALPHABET[(group >> 6u) & 0x3fu];
+            *out++ = ALPHABET[group & 0x3fu];
+        }
+
+        const std::size_t remaining = length - i;
+        if (remaining == 1)
+        {
+            const unsigned int group = in[i] << 16u;
+            *out++ = ALPHABET[(group >> 18u) & 0x3fu];
+            *out++ = ALPHABET[(group >> 12u) & 0x3fu];
+            *out++ = '=';
+            *out++ = '=';
+        }
+        else if (remaining == 2)
+        {
+            const unsigned int group = (in[i] << 16u) | (in[i + 1] << 8u);
+            *out++ = ALPHABET[(group >> 18u) & 0x3fu];
+            *out++ = ALPHABET[(group >> 12u) & 0x3fu];
+            *out++ = ALPHABET[(group >> 6u) & 0x3fu];
+            *out++ = '=';
+        }
+    }
+
+#ifdef CPPBACKEND_BASE64_X86
+    void Base64Encoder::encodeSSSE3(const unsigned char* in, std::size_t length, char* out)
+    {
+        if (!isSupported(Implementation::SSSE3))
+        {
+            throw std::logic_error("SSSE3 base64 encoding is not supported on this CPU");
+        }
+
+        encodeWithSSSE3(in, length, out);
+    }
+
+    void Base64Encoder::encodeAVX2(const unsigned char* in, std::size_t length, char* out)
+    {
+        if (!isSupported(Implementation::AVX2))
+        {
+            throw std::logic_error("AVX2 base64 encoding is not supported on this CPU");
+        }
+
+        encodeWithAVX2(in, length, out);
+    }
+#else
+    void Base64Encoder::encodeSSSE3(const unsigned char*, std::size_t, char*)
+    {
+        throw std::logic_error("SSSE3 base64 encoding is not supported on this CPU");
+    }
+
+    void Base64Encoder::encodeAVX2(const unsigned char*, std::size_t, char*)
+    {
+        throw std::logic_error("AVX2 base64 encoding is not supported on this CPU");
+    }
+#endif
+
+    Base64Encoder::Implementation Base64Encoder::getImplementation()
+    {
+        static const Implementation implementation = detectImplementation();
+        return implementation;
+    }
+
+    bool Base64Encoder::isSupported(Implementation implementation)
+    {
+        switch (implementation)
+        {
+            case Implementation::SCALAR:
+                return true;
+            case Implementation::SSSE3:
+                return getImplementation() != Implementation::SCALAR;
+            default:
+                return getImplementation() == Implementation::AVX2;
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+namespace cppbackend {
+    // Standard (RFC 4648, padded) base64 encoder that writes into a caller
+    // sized buffer. encode() picks the widest implementation the CPU supports
+    // the first time it is called; the others are public so tests and
+    // benchmarks can compare them.
+    class Base64Encoder {
+    public:
+        enum class Implementation { SCALAR, SSSE3, AVX2 };
+
+        static constexpr std::size_t encodedLength(std::size_t length)
+        {
+            return (length + 2) / 3 * 4;
+        }
+
+        // Writes exactly encodedLength(length) characters to out
+        static void encode(const unsigned char* in, std::size_t length, char* out);
+
+        static void encodeScalar(const unsigned char* in, std::size_t length, char* out);
+        static void encodeSSSE3(const unsigned char* in, std::size_t length, char* out);
+        static void encodeAVX2(const unsigned char* in, std::size_t length, char* out);
+
+        [[nodiscard]] static Implementation getImplementation();
+        [[nodiscard]] static bool isSupported(Implementation implementation);
+    };
+}
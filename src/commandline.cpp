@@ -0,0 +1,157 @@
+#include "commandline.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace cppbackend {
+    namespace {
+        long long parseNumber(const std::string& name, const std::string& value)
+        {
+            try {
+                std::size_t used = 0;
+                const auto number = std::stoll(value, &used);
+                if (used == value.size() && number >= 0)
+                {
+                    return number;
+                }
+            } catch (...) {
+            }
+            throw std::invalid_argument(fmt::format("Option {} needs a non-negative number, received '{}'", name, value));
+        }
+    }
+
+    CommandLineOptions CommandLine::parse(int argc, const char* const argv[])
+    {
+        CommandLineOptions options{};
+        bool createIndex = false;
+        std::vector<std::string> positional{};
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument{argv[i]};
+            if (argument.rfind("--", 0) != 0)
+            {
+                positional.push_back(argument);
+                continue;
+            }
+
+            const auto equals = argument.find('=');
+            const auto name = argument.substr(0, equals);
+            const bool hasValue = equals != std::string::npos;
+            const auto value = hasValue ? argument.substr(equals + 1) : std::string{};
+
+            if (name == "--create-index" && !hasValue) {
+                createIndex = true;
+            } else if (name == "--mmap-size" && hasValue) {
+                options.repository.mmapSize = parseNumber(name, value);
+            } else if (name == "--cache-size" && hasValue) {
+                // PRAGMA cache_size takes a signed int
+                const auto cacheSize = parseNumber(name, value);
+                if (cacheSize > std::numeric_limits<int>::max())
+                {
+                    throw std::invalid_argument(fmt::format("Option {} is above the largest SQLite cache size", name));
+                }
+                options.repository.cacheSizeKiB = static_cast<int>(cacheSize);
+            } else if (name == "--ttl" && hasValue) {
+                // RFC 2181: TTLs are at most 2^31 - 1
+                const auto ttl = parseNumber(name, value);
+                if (ttl > std::numeric_limits<std::int32_t>::max())
+                {
+                    throw std::invalid_argument(fmt::format("Option {} is above the largest DNS TTL", name));
+                }
+                options.repository.defaultTTL = static_cast<int>(ttl);
+            } else if (name == "--temp-store" && (value == "memory" || value == "default")) {
+                options.repository.tempStoreMemory = value == "memory";
+            } else if (name == "--immutable" && !hasValue) {
+                options.repository.immutable = true;
+            } else if (name == "--shared-cache" && !hasValue) {
+                options.repository.sharedCache = true;
+            } else if (name == "--mutex" && !hasValue) {
+                options.repository.noMutex = false;
+            } else if (name == "--log-level" && hasValue) {
+                options.logLevel = Logger::parseLevel(value);
+            } else if (name == "--log-rate" && hasValue) {
+                options.logRateLimit = static_cast<std::uint32_t>(
+                        std::min<long long>(parseNumber(name, value), std::numeric_limits<std::uint32_t>::max()));
+            } else if (name == "--stats-socket" && hasValue && !value.empty()) {
+                options.statsSocketPath = value;
+            } else if (name == "--snapshot" && (!hasValue || !value.empty())) {
+                options.snapshot.enabled = true;
+                options.snapshot.path = value;
+            } else if (name == "--warmup-file" && hasValue && !value.empty()) {
+                options.warmupFile = value;
+            } else if (name == "--warmup-time" && hasValue) {
+                options.warmupTimeMs = parseNumber(name, value);
+            } else if (name == "--capture-file" && hasValue && !value.empty()) {
+                options.captureFile = value;
+            } else if (name == "--key-file" && hasValue && !value.empty()) {
+                options.keys.file = value;
+            } else if (name == "--answer-cache" && hasValue) {
+                options.answerCache.capacity = static_cast<std::size_t>(parseNumber(name, value));
+            } else if (name == "--zone" && hasValue) {
+                options.zones.zones.push_back(ZoneTable::parseZone(value));
+            } else if (name == "--zone-file" && hasValue && !value.empty()) {
+                options.zones.file = value;
+            } else if (name == "--keys-from-database" && !hasValue) {
+                options.keys.fromDatabase = true;
+            } else {
+                throw std::invalid_argument(fmt::format("Unknown or malformed option '{}'", argument));
+            }
+        }
+
+        if (!options.keys.file.empty() && options.keys.fromDatabase)
+        {
+            throw std::invalid_argument("Use either --key-file or --keys-from-database, not both");
+        }
+
+        const std::size_t expected = createIndex ? 2 : 1;
+        if (positional.size() != expected)
+        {
+            throw std::invalid_argument(fmt::format("Expected {} database path(s), received {}",
+                                                    expected, positional.size()));
+        }
+
+        options.dbPath = positional[0];
+        if (createIndex)
+        {
+            options.createIndexPath = positional[1];
+        }
+
+        return options;
+    }
+
+    std::string CommandLine::usage(const std::string& program)
+    {
+        return fmt::format(
+                "Usage: {0} [options] database_path\n"
+                "       {0} --create-index database_path new_database_path\n"
+                "Options:\n"
+                "  --mmap-size=BYTES      SQLite mmap_size, 0 to disable (default: 268435456)\n"
+                "  --cache-size=KIB       SQLite page cache size, 0 for SQLite's default (default: 16384)\n"
+                "  --temp-store=memory|default  SQLite temp_store (default: memory)\n"
+                "  --immutable            open the database as immutable; only if nothing writes it while running\n"
+                "  --shared-cache         use SQLite's shared cache mode\n"
+                "  --mutex                keep SQLite's per-connection mutex\n"
+                "  --ttl=SECONDS          TTL for records without their own ttl (default: 3600)\n"
+                "  --log-level=LEVEL      off, error, warning, info or debug (default: info)\n"
+                "  --log-rate=N           log messages per category per second, 0 for no limit (default: 1000)\n"
+                "  --stats-socket=PATH    serve latency and counter stats in Prometheus text format on this unix socket\n"
+                "  --answer-cache=N       keep the DATA lines of up to N recent answers, 0 to disable (default: 65536)\n"
+                "  --snapshot[=PATH]      answer from a snapshot of the database, kept at PATH (default: database_path.snapshot)\n"
+                "  --warmup-file=PATH     resolve the qnames in this file before answering HELO\n"
+                "  --warmup-time=MS       longest time to spend warming up (default: 1500)\n"
+                "  --capture-file=PATH    write the most recently answered qnames here when the input ends\n"
+                "  --key-file=PATH        per-platform AES keys, one 'platform=key' or 'default=key' per line\n"
+                "  --keys-from-database   per-platform AES keys from the platform_key (nbr, key) table\n"
+                "  --zone=NAME:HANDLER    serve NAME with the txt or epoch answer handler; repeatable\n"
+                "                         (default: testnet:txt and oc.testnet:epoch unless --zone-file is given)\n"
+                "  --zone-file=PATH       zones to serve, one 'name handler' per line\n"
+                "Send SIGHUP to reload the keys without a restart, and SIGUSR1 to write the stats to stderr.",
+                program);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "answercache.h"
+#include "keystore.h"
+#include "logger.h"
+#include "repository.h"
+#include "snapshot.h"
+#include "zonetable.h"
+
+#include <cstdint>
+#include <string>
+
+namespace cppbackend {
+    struct CommandLineOptions {
+        std::string dbPath{};
+        RepositoryOptions repository{};
+        KeyOptions keys{};
+        SnapshotOptions snapshot{};
+        ZoneOptions zones{};
+        AnswerCacheOptions answerCache{};
+        LogLevel logLevel = LogLevel::INFO;
+        std::uint32_t logRateLimit = Logger::DEFAULT_RATE_LIMIT;
+        // Serve the stats on a unix socket here, none when empty
+        std::string statsSocketPath{};
+
+        static constexpr std::int64_t DEFAULT_WARMUP_TIME_MS = 1500;
+        // Qnames to resolve before answering HELO, and how long that may take.
+        // PowerDNS waits at most pipe-timeout (2000 ms by default) for the answer.
+        std::string warmupFile{};
+        std::int64_t warmupTimeMs = DEFAULT_WARMUP_TIME_MS;
+        // Where to write the answered qnames when the input ends, none when empty
+        std::string captureFile{};
+
+        // Set by --create-index: write an indexed copy of dbPath here and exit
+        std::string createIndexPath{};
+    };
+
+    class CommandLine {
+    public:
+        // Throws std::invalid_argument for unknown options or bad values
+        static CommandLineOptions parse(int argc, const char* const argv[]);
+        static std::string usage(const std::string& program);
+    };
+}
@@ -1,5 +1,5 @@
 #include "encoder.h"
-#include "base64/base64.h"
+#include "base64encoder.h"
 #include "cryptopp/cryptlib.h"
 #include "cryptopp/rijndael.h"
 #include "cryptopp/aes.h"
@@ -10,7 +10,9 @@
 namespace cppbackend {
     std::string Encoder::toBase64(const std::string &s)
     {
-        return base64_encode(s);
+        std::string encoded(Base64Encoder::encodedLength(s.size()), '\0');
+        Base64Encoder::encode(reinterpret_cast<const unsigned char*>(s.data()), s.size(), &encoded[0]);
+        return encoded;
     }
 
     std::string Encoder::toAES128(const std::string &s, const std::string& password)
@@ -37,4 +39,39 @@ namespace cppbackend {
 
         return toBase64(cipherText);
     }
+
+    std::string Encoder::toAES128(const std::string &s, const AES128Block& cipher)
+    {
+        if (s.length() >= AES128Block::BLOCK_SIZE)
+        {
+            return toAES128(s, cipher.getKey());
+        }
+
+        unsigned char cipherText[AES128Block::BLOCK_SIZE];
+        cipher.encrypt(reinterpret_cast<const unsigned char*>(s.data()), s.length(), cipherText);
+
+        std::string encoded(Base64Encoder::encodedLength(AES128Block::BLOCK_SIZE), '\0');
+        Base64Encoder::encode(cipherText, AES128Block::BLOCK_SIZE, &encoded[0]);
+        return encoded;
+    }
+
+    void Encoder::toAES128Batch(const std::string* plaintexts, std::size_t count,
+                                const AES128Block& cipher, std::string& arena)
+    {
+        static_assert(Base64Encoder::encodedLength(AES128Block::BLOCK_SIZE) == AES128_TOKEN_LENGTH);
+
+        // Ciphertext goes in blocks of LANES on the stack, then straight into the arena
+        unsigned char cipherText[AES128Block::LANES * AES128Block::BLOCK_SIZE];
+        arena.resize(count * AES128_TOKEN_LENGTH);
+        for (std::size_t first = 0; first < count; first += AES128Block::LANES)
+        {
+            const auto lanes = std::min(AES128Block::LANES, count - first);
+            cipher.encryptBatch(plaintexts + first, lanes, cipherText);
+            for (std::size_t lane = 0; lane < lanes; ++lane)
+            {
+                Base64Encoder::encode(cipherText + lane * AES128Block::BLOCK_SIZE, AES128Block::BLOCK_SIZE,
+                                      &arena[(first + lane) * AES128_TOKEN_LENGTH]);
+            }
+        }
+    }
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "aes128block.h"
+
 #include <string>
 
 namespace cppbackend {
@@ -7,6 +9,17 @@ namespace cppbackend {
     public:
         static std::string toBase64(const std::string &s);
         static std::string toAES128(const std::string &s, const std::string& password);
+        // Same result as toAES128(s, cipher.getKey()). Plaintexts shorter than a
+        // block, such as the epoch tokens, skip the Crypto++ filter pipeline.
+        static std::string toAES128(const std::string &s, const AES128Block& cipher);
+        // Encrypts count single-block plaintexts into one arena of fixed width
+        // tokens: token i is arena.substr(i * AES128_TOKEN_LENGTH, AES128_TOKEN_LENGTH)
+        // and equals toAES128(plaintexts[i], cipher). The arena is reused, so a
+        // caller that keeps it across bursts does not allocate once it is large enough.
+        static void toAES128Batch(const std::string* plaintexts, std::size_t count,
+                                  const AES128Block& cipher, std::string& arena);
+
+        static constexpr std::size_t AES128_TOKEN_LENGTH = 24;
     private:
         static constexpr int PASSWORD_LENGTH_128 = 16;
     };
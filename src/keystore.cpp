@@ -0,0 +1,136 @@
+#include "keystore.h"
+
+#include "fmt/format.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace cppbackend {
+    KeyStore::KeyStore(const std::map<int, std::string>& keys)
+    {
+        replace(keys);
+    }
+
+    std::shared_ptr<const AES128Block> KeyStore::getCipher(int platform) const
+    {
+        if (platform < MIN_PLATFORM || platform > MAX_PLATFORM)
+        {
+            return nullptr;
+        }
+        auto set = std::atomic_load_explicit(&m_current, std::memory_order_acquire);
+        const auto* cipher = set->ciphers[platform].get();
+        if (!cipher)
+        {
+            return nullptr;
+        }
+        // Shares the set's ownership, so the set outlives a replace while this is held
+        return std::shared_ptr<const AES128Block>(std::move(set), cipher);
+    }
+
+    void KeyStore::replace(const std::map<int, std::string>& keys)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const auto current = std::atomic_load_explicit(&m_current, std::memory_order_relaxed);
+        std::shared_ptr<const KeySet> set = build(keys, current ? current->generation + 1 : 1);
+
+        std::atomic_store_explicit(&m_current, std::move(set), std::memory_order_release);
+    }
+
+    std::uint64_t KeyStore::getGeneration() const
+    {
+        return std::atomic_load_explicit(&m_current, std::memory_order_acquire)->generation;
+    }
+
+    std::unique_ptr<KeyStore::KeySet> KeyStore::build(const std::map<int, std::string>& keys, std::uint64_t generation)
+    {
+        for (const auto& [platform, key] : keys)
+        {
+            if (platform != DEFAULT_PLATFORM && (platform < MIN_PLATFORM || platform > MAX_PLATFORM))
+            {
+                throw std::invalid_argument(fmt::format("Key for platform {} is outside {} to {}",
+                                                        platform, MIN_PLATFORM, MAX_PLATFORM));
+            }
+            if (key.length() != AES128Block::KEY_LENGTH)
+            {
+                throw std::invalid_argument(fmt::format("Key for platform {} must be {} characters, received {}",
+                                                        platform, AES128Block::KEY_LENGTH, key.length()));
+            }
+        }
+
+        auto set = std::make_unique<KeySet>();
+        set->generation = generation;
+
+        const auto fallback = keys.find(DEFAULT_PLATFORM);
+        for (int platform = MIN_PLATFORM; platform <= MAX_PLATFORM; ++platform)
+        {
+            auto key = keys.find(platform);
+            if (key == keys.end())
+            {
+                key = fallback;
+            }
+            if (key != keys.end())
+            {
+                set->ciphers[platform] = std::make_unique<const AES128Block>(key->second);
+            }
+        }
+
+        return set;
+    }
+
+    std::map<int, std::string> KeyStore::readFile(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error(fmt::format("Error opening key file '{}'", path));
+        }
+
+        std::map<int, std::string> keys{};
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            ++lineNumber;
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            // Everything after the first '=' is the key, which may itself contain '='
+            const auto equals = line.find('=');
+            if (equals == std::string::npos)
+            {
+                throw std::invalid_argument(fmt::format("{}:{}: expected 'platform=key'", path, lineNumber));
+            }
+
+            const auto name = line.substr(0, equals);
+            int platform = DEFAULT_PLATFORM;
+            if (name != DEFAULT_NAME)
+            {
+                try {
+                    std::size_t used = 0;
+                    platform = std::stoi(name, &used);
+                    if (used != name.size() || platform == DEFAULT_PLATFORM)
+                    {
+                        throw std::invalid_argument(name);
+                    }
+                } catch (...) {
+                    throw std::invalid_argument(fmt::format("{}:{}: '{}' is not a platform number or '{}'",
+                                                            path, lineNumber, name, DEFAULT_NAME));
+                }
+            }
+
+            if (!keys.emplace(platform, line.substr(equals + 1)).second)
+            {
+                throw std::invalid_argument(fmt::format("{}:{}: duplicate key for '{}'", path, lineNumber, name));
+            }
+        }
+
+        return keys;
+    }
+}
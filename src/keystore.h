@@ -0,0 +1,68 @@
+#pragma once
+
+#include "aes128block.h"
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace cppbackend {
+    // Where the per-platform encryption keys come from. With neither set, every
+    // platform uses the built-in key.
+    struct KeyOptions {
+        // Lines of "platform=key", "default=key" for platforms without their own
+        std::string file{};
+        // Rows of the platform_key table in the served database
+        bool fromDatabase = false;
+    };
+
+    // The AES key for each platform, with its schedule expanded once. replace()
+    // publishes a whole new set with a single atomic store, so lookups never
+    // see a half-updated set. A cipher shares ownership of its set, so a
+    // replaced set, and the retired keys in it, is freed once the last thread
+    // still holding one of its ciphers lets go.
+    class KeyStore {
+    public:
+        static constexpr int DEFAULT_PLATFORM = 0;
+        static constexpr int MIN_PLATFORM = 1;
+        static constexpr int MAX_PLATFORM = 5;
+
+        // Throws std::invalid_argument for a platform out of range or a key of
+        // the wrong length
+        explicit KeyStore(const std::map<int, std::string>& keys);
+
+        KeyStore(const KeyStore&) = delete;
+        KeyStore& operator=(const KeyStore&) = delete;
+
+        // nullptr when the platform has no key and there is no default
+        [[nodiscard]] std::shared_ptr<const AES128Block> getCipher(int platform) const;
+
+        // Validates every key before publishing, so a bad set leaves the current one in place
+        void replace(const std::map<int, std::string>& keys);
+
+        // Incremented by every successful replace
+        [[nodiscard]] std::uint64_t getGeneration() const;
+
+        // Throws std::runtime_error when the file can't be read and
+        // std::invalid_argument for a malformed line
+        static std::map<int, std::string> readFile(const std::string& path);
+
+        static inline std::string const DEFAULT_NAME = "default";
+    private:
+        struct KeySet {
+            std::uint64_t generation = 0;
+            std::array<std::unique_ptr<const AES128Block>, MAX_PLATFORM + 1> ciphers{};
+        };
+
+        // Read and replaced with std::atomic_load/std::atomic_store
+        std::shared_ptr<const KeySet> m_current;
+
+        // Serialises replace, so each set gets the next generation
+        std::mutex m_mutex;
+
+        static std::unique_ptr<KeySet> build(const std::map<int, std::string>& keys, std::uint64_t generation);
+    };
+}
@@ -0,0 +1,71 @@
+#include "labelpool.h"
+#include "perfecthash.h"
+
+#include "fmt/format.h"
+
+#include <stdexcept>
+
+namespace cppbackend {
+    namespace {
+        constexpr std::size_t INITIAL_SLOTS = 64;
+    }
+
+    std::uint32_t LabelPool::intern(std::string_view label)
+    {
+        if (label.size() > MAX_LENGTH)
+        {
+            throw std::invalid_argument(fmt::format("Labels are at most {} bytes, received {}", MAX_LENGTH, label.size()));
+        }
+        if ((m_count + 1) * 2 > m_slots.size())
+        {
+            grow();
+        }
+
+        const auto slot = findSlot(label);
+        if (m_slots[slot] != NOT_FOUND)
+        {
+            return m_slots[slot];
+        }
+
+        if (m_buffer.size() + 1 + label.size() >= NOT_FOUND)
+        {
+            throw std::runtime_error("Label pool is full: the labels need more than 4 GiB");
+        }
+        const auto offset = static_cast<std::uint32_t>(m_buffer.size());
+        m_buffer.push_back(static_cast<char>(label.size()));
+        m_buffer.append(label);
+        m_slots[slot] = offset;
+        ++m_count;
+        return offset;
+    }
+
+    std::uint32_t LabelPool::find(std::string_view label) const
+    {
+        return m_slots.empty() ? NOT_FOUND : m_slots[findSlot(label)];
+    }
+
+    std::size_t LabelPool::findSlot(std::string_view label) const
+    {
+        const auto mask = m_slots.size() - 1;
+        for (auto slot = static_cast<std::size_t>(PerfectHash::hash(label, 0)) & mask;; slot = (slot + 1) & mask)
+        {
+            if (m_slots[slot] == NOT_FOUND || get(m_slots[slot]) == label)
+            {
+                return slot;
+            }
+        }
+    }
+
+    void LabelPool::grow()
+    {
+        const auto previous = std::move(m_slots);
+        m_slots.assign(previous.empty() ? INITIAL_SLOTS : previous.size() * 2, NOT_FOUND);
+        for (const auto offset : previous)
+        {
+            if (offset != NOT_FOUND)
+            {
+                m_slots[findSlot(get(offset))] = offset;
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppbackend {
+    // Interned strings in one contiguous buffer, each stored once as a length
+    // byte followed by its bytes and named by its 32-bit offset. Millions of
+    // domain names then cost a few buffer doublings rather than an allocation
+    // each, and the buffer can be written out as is. Not thread-safe.
+    class LabelPool {
+    public:
+        // One length byte; DNS names are at most 253 characters anyway
+        static constexpr std::size_t MAX_LENGTH = 255;
+        static constexpr std::uint32_t NOT_FOUND = 0xFFFFFFFF;
+
+        // Offset of label, adding it the first time. Throws std::invalid_argument
+        // when label is longer than MAX_LENGTH and std::runtime_error when the
+        // buffer would outgrow 32-bit offsets.
+        std::uint32_t intern(std::string_view label);
+        // Offset of label, or NOT_FOUND when it was never interned
+        [[nodiscard]] std::uint32_t find(std::string_view label) const;
+
+        [[nodiscard]] std::string_view get(std::uint32_t offset) const { return get(m_buffer.data(), offset); }
+        // The label at offset in a copy of getBuffer()
+        static std::string_view get(const char* buffer, std::uint32_t offset)
+        {
+            return std::string_view(buffer + offset + 1, static_cast<unsigned char>(buffer[offset]));
+        }
+
+        [[nodiscard]] const std::string& getBuffer() const { return m_buffer; }
+        [[nodiscard]] std::size_t getCount() const { return m_count; }
+    private:
+        std::string m_buffer{};
+        std::size_t m_count = 0;
+        // Open addressing with linear probing: offsets, or NOT_FOUND for empty
+        // slots. Kept at most half full.
+        std::vector<std::uint32_t> m_slots{};
+
+        [[nodiscard]] std::size_t findSlot(std::string_view label) const;
+        void grow();
+    };
+}
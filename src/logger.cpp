@@ -0,0 +1,227 @@
+#include "logger.h"
+
+#include <ctime>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace cppbackend {
+    namespace {
+        void writeToStderr(const std::string& lines)
+        {
+            const char* data = lines.data();
+            std::size_t remaining = lines.size();
+            while (remaining > 0)
+            {
+                const auto written = ::write(STDERR_FILENO, data, remaining);
+                if (written <= 0)
+                {
+                    return;
+                }
+                data += written;
+                remaining -= static_cast<std::size_t>(written);
+            }
+        }
+    }
+
+    Logger::Logger(Sink sink, LogLevel level, std::uint32_t rateLimit)
+        : m_sink{sink ? std::move(sink) : Sink{writeToStderr}},
+          m_level{static_cast<int>(level)},
+          m_rateLimit{rateLimit},
+          m_slots{std::make_unique<Slot[]>(SLOTS)}
+    {
+        for (std::size_t i = 0; i < SLOTS; ++i)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_thread = std::thread(&Logger::run, this);
+    }
+
+    Logger::~Logger()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        m_thread.join();
+    }
+
+    Logger& Logger::global()
+    {
+        static Logger logger{};
+        return logger;
+    }
+
+    void Logger::flush()
+    {
+        const auto target = m_enqueuePosition.load(std::memory_order_acquire);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_flushRequested = true;
+        m_wake.notify_one();
+        m_drained.wait(lock, [this, target]() { return m_drainedPosition >= target; });
+    }
+
+    bool Logger::admit(LogCategory category)
+    {
+        const auto limit = m_rateLimit.load(std::memory_order_relaxed);
+        if (limit == 0)
+        {
+            return true;
+        }
+
+        // Fixed one second windows. Threads racing on a window change can let a
+        // few extra messages through, which is fine for a rate limit.
+        auto& window = m_windows[static_cast<std::size_t>(category)];
+        const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        auto second = window.second.load(std::memory_order_relaxed);
+        if (second != now && window.second.compare_exchange_strong(second, now, std::memory_order_relaxed))
+        {
+            window.count.store(0, std::memory_order_relaxed);
+            const auto held = window.suppressed.exchange(0, std::memory_order_relaxed);
+            if (held > 0 && isEnabled(LogLevel::WARNING))
+            {
+                enqueue(LogLevel::WARNING, category, "Suppressed {} messages over the rate limit of {} per second",
+                        held, limit);
+            }
+        }
+
+        if (window.count.fetch_add(1, std::memory_order_relaxed) < limit)
+        {
+            return true;
+        }
+        window.suppressed.fetch_add(1, std::memory_order_relaxed);
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Bounded multi-producer queue after Dmitry Vyukov: a producer claims a
+    // position with one CAS, and the slot's sequence tells whether it is free
+    std::uint64_t Logger::reserve()
+    {
+        auto position = m_enqueuePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            auto& slot = m_slots[position % SLOTS];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::int64_t>(sequence - position);
+            if (difference == 0)
+            {
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    return position;
+                }
+            }
+            else if (difference < 0)
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return FULL;
+            }
+            else
+            {
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Logger::publish(std::uint64_t position)
+    {
+        m_slots[position % SLOTS].sequence.store(position + 1, std::memory_order_release);
+    }
+
+    void Logger::run()
+    {
+        std::string lines{};
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_wake.wait_for(lock, DRAIN_INTERVAL, [this]() { return m_stop || m_flushRequested; });
+            const bool stop = m_stop;
+            m_flushRequested = false;
+            lock.unlock();
+
+            lines.clear();
+            const auto position = drain(lines);
+            if (!lines.empty())
+            {
+                m_sink(lines);
+            }
+
+            lock.lock();
+            m_drainedPosition = position;
+            m_drained.notify_all();
+            if (stop)
+            {
+                return;
+            }
+        }
+    }
+
+    std::uint64_t Logger::drain(std::string& lines)
+    {
+        while (true)
+        {
+            auto& slot = m_slots[m_dequeuePosition % SLOTS];
+            if (slot.sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1)
+            {
+                return m_dequeuePosition;
+            }
+
+            const auto time = std::chrono::system_clock::to_time_t(slot.time);
+            const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    slot.time.time_since_epoch()).count() % 1000;
+            std::tm utc{};
+            gmtime_r(&time, &utc);
+
+            fmt::format_to(std::back_inserter(lines), "{:04}-{:02}-{:02}T{:02}:{:02}:{:02}.{:03}Z {} {}: ",
+                           utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+                           utc.tm_hour, utc.tm_min, utc.tm_sec, milliseconds,
+                           toString(slot.level), toString(slot.category));
+            lines.append(slot.text, slot.length);
+            lines.push_back('\n');
+
+            slot.sequence.store(m_dequeuePosition + SLOTS, std::memory_order_release);
+            ++m_dequeuePosition;
+        }
+    }
+
+    LogLevel Logger::parseLevel(const std::string& name)
+    {
+        for (const auto level : {LogLevel::OFF, LogLevel::ERROR, LogLevel::WARNING, LogLevel::INFO, LogLevel::DEBUG})
+        {
+            if (name == toString(level))
+            {
+                return level;
+            }
+        }
+        throw std::invalid_argument(fmt::format("Unknown log level '{}'", name));
+    }
+
+    const char* Logger::toString(LogLevel level)
+    {
+        switch (level)
+        {
+            case LogLevel::OFF: return "off";
+            case LogLevel::ERROR: return "error";
+            case LogLevel::WARNING: return "warning";
+            case LogLevel::INFO: return "info";
+            case LogLevel::DEBUG: return "debug";
+        }
+        return "unknown";
+    }
+
+    const char* Logger::toString(LogCategory category)
+    {
+        switch (category)
+        {
+            case LogCategory::QUERY: return "query";
+            case LogCategory::PROTOCOL: return "protocol";
+            case LogCategory::KEYS: return "keys";
+            case LogCategory::REPOSITORY: return "repository";
+            case LogCategory::CONTROL: return "control";
+            case LogCategory::COUNT: break;
+        }
+        return "unknown";
+    }
+}
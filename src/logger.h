@@ -0,0 +1,149 @@
+#pragma once
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace cppbackend {
+    enum class LogLevel { OFF = 0, ERROR, WARNING, INFO, DEBUG };
+
+    // Each category has its own rate limit, so a flood of one kind of message
+    // can't crowd out the others
+    enum class LogCategory { QUERY = 0, PROTOCOL, KEYS, REPOSITORY, CONTROL, COUNT };
+
+    // Asynchronous logger. log() formats straight into a slot of a fixed size
+    // lock-free ring and returns; a background thread drains the ring and hands
+    // the lines to the sink in batches, one write per batch. When the ring is
+    // full the message is dropped rather than blocking the caller. A disabled
+    // level costs one relaxed atomic load and formats nothing.
+    class Logger {
+    public:
+        // Called on the logging thread with one or more complete lines
+        using Sink = std::function<void(const std::string& lines)>;
+
+        static constexpr std::size_t SLOTS = 1024;
+        static constexpr std::size_t MESSAGE_LENGTH = 512;
+        // Messages per category per second; 0 turns rate limiting off
+        static constexpr std::uint32_t DEFAULT_RATE_LIMIT = 1000;
+
+        // An empty sink writes to stderr
+        explicit Logger(Sink sink = {},
+                        LogLevel level = LogLevel::INFO,
+                        std::uint32_t rateLimit = DEFAULT_RATE_LIMIT);
+        // Writes out everything still in the ring
+        ~Logger();
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        // The process-wide logger, writing to stderr
+        static Logger& global();
+
+        [[nodiscard]] bool isEnabled(LogLevel level) const
+        {
+            return level != LogLevel::OFF &&
+                   static_cast<int>(level) <= m_level.load(std::memory_order_relaxed);
+        }
+
+        template <typename... Args>
+        void log(LogLevel level, LogCategory category, const char* format, const Args&... args)
+        {
+            if (!isEnabled(level) || !admit(category))
+            {
+                return;
+            }
+            enqueue(level, category, format, args...);
+        }
+
+        void setLevel(LogLevel level) { m_level.store(static_cast<int>(level), std::memory_order_relaxed); }
+        [[nodiscard]] LogLevel getLevel() const { return static_cast<LogLevel>(m_level.load(std::memory_order_relaxed)); }
+        void setRateLimit(std::uint32_t perSecond) { m_rateLimit.store(perSecond, std::memory_order_relaxed); }
+        [[nodiscard]] std::uint32_t getRateLimit() const { return m_rateLimit.load(std::memory_order_relaxed); }
+
+        // Blocks until every message logged before the call has reached the sink
+        void flush();
+
+        // Messages lost because the ring was full
+        [[nodiscard]] std::uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+        // Messages held back by the rate limit
+        [[nodiscard]] std::uint64_t getSuppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
+
+        // Throws std::invalid_argument for anything but off, error, warning, info or debug
+        static LogLevel parseLevel(const std::string& name);
+        static const char* toString(LogLevel level);
+        static const char* toString(LogCategory category);
+    private:
+        static constexpr std::uint64_t FULL = ~std::uint64_t{0};
+        static constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(10);
+
+        struct Slot {
+            // Equal to the slot's position when free to write, position + 1 once published
+            std::atomic<std::uint64_t> sequence{0};
+            LogLevel level = LogLevel::INFO;
+            LogCategory category = LogCategory::QUERY;
+            std::chrono::system_clock::time_point time{};
+            std::size_t length = 0;
+            char text[MESSAGE_LENGTH];
+        };
+
+        struct RateWindow {
+            std::atomic<std::int64_t> second{0};
+            std::atomic<std::uint32_t> count{0};
+            std::atomic<std::uint64_t> suppressed{0};
+        };
+
+        const Sink m_sink;
+        std::atomic<int> m_level;
+        std::atomic<std::uint32_t> m_rateLimit;
+
+        std::unique_ptr<Slot[]> m_slots;
+        alignas(64) std::atomic<std::uint64_t> m_enqueuePosition{0};
+        alignas(64) std::uint64_t m_dequeuePosition = 0;
+        std::array<RateWindow, static_cast<std::size_t>(LogCategory::COUNT)> m_windows{};
+        std::atomic<std::uint64_t> m_dropped{0};
+        std::atomic<std::uint64_t> m_suppressed{0};
+
+        // Only the drain thread and flush() use these, never log()
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_drained;
+        std::uint64_t m_drainedPosition = 0;
+        bool m_flushRequested = false;
+        bool m_stop = false;
+        std::thread m_thread;
+
+        template <typename... Args>
+        void enqueue(LogLevel level, LogCategory category, const char* format, const Args&... args)
+        {
+            const auto position = reserve();
+            if (position == FULL)
+            {
+                return;
+            }
+
+            auto& slot = m_slots[position % SLOTS];
+            const auto result = fmt::format_to_n(slot.text, MESSAGE_LENGTH, format, args...);
+            slot.length = std::min<std::size_t>(result.size, MESSAGE_LENGTH);
+            slot.level = level;
+            slot.category = category;
+            slot.time = std::chrono::system_clock::now();
+            publish(position);
+        }
+
+        bool admit(LogCategory category);
+        std::uint64_t reserve();
+        void publish(std::uint64_t position);
+        void run();
+        std::uint64_t drain(std::string& lines);
+    };
+}
@@ -1,33 +1,115 @@
 #include "backend.h"
+#include "commandline.h"
+#include "logger.h"
+#include "statsserver.h"
 
 #include "fmt/format.h"
 
+#include <chrono>
+#include <csignal>
 #include <iostream>
+#include <memory>
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " database_path" << std::endl;
+    // Responses are flushed per answer by Backend; stdio never shares these streams
+    std::ios::sync_with_stdio(false);
+
+    cppbackend::CommandLineOptions options{};
+    try {
+        options = cppbackend::CommandLine::parse(argc, argv);
+    } catch (std::exception& err) {
+        std::cout << err.what() << std::endl;
+        std::cout << cppbackend::CommandLine::usage(argv[0]) << std::endl;
         return EXIT_FAILURE;
     }
 
+    auto& logger = cppbackend::Logger::global();
+    logger.setLevel(options.logLevel);
+    logger.setRateLimit(options.logRateLimit);
+
+    if (!options.createIndexPath.empty()) {
+        try {
+            cppbackend::Repository::createIndexes(options.dbPath, options.createIndexPath);
+        } catch (std::exception& err) {
+            std::cerr << fmt::format("Error in processor: {}", err.what()) << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << fmt::format("Created an indexed copy of '{}' at '{}'", options.dbPath, options.createIndexPath) << std::endl;
+        return EXIT_SUCCESS;
+    }
+
     bool didProcessingSucceed = true;
 
     try {
-        cppbackend::Backend backend(argv[1]);
+        cppbackend::Backend backend(options.dbPath, options.repository, options.keys, options.snapshot, options.zones,
+                                    options.answerCache);
+        std::signal(SIGHUP, [](int) { cppbackend::Backend::requestKeyReload(); });
+        std::signal(SIGUSR1, [](int) { cppbackend::Backend::requestStatsDump(); });
+
+        std::unique_ptr<cppbackend::StatsServer> statsServer{};
+        if (!options.statsSocketPath.empty()) {
+            statsServer = std::make_unique<cppbackend::StatsServer>(
+                    options.statsSocketPath, [&backend] { return backend.getStats().toPrometheus(); });
+        }
+
+        // Answering HELO is what tells PowerDNS we are ready, so be hot first
+        if (!options.warmupFile.empty()) {
+            try {
+                const auto qnames = cppbackend::QueryLog::readFile(options.warmupFile);
+                const auto warmUp = backend.warmUp(qnames, std::chrono::milliseconds(options.warmupTimeMs));
+                logger.log(cppbackend::LogLevel::INFO, cppbackend::LogCategory::CONTROL,
+                           "Warmed up with {} of {} qnames ({} answered) in {} ms, loading {} pages; "
+                           "page cache hit ratio {:.1f}% during warm-up",
+                           warmUp.queries, qnames.size(), warmUp.answered, warmUp.elapsed.count(),
+                           warmUp.pagesLoaded, warmUp.pageCacheHitRatio * 100.0);
+            } catch (std::exception& err) {
+                // A first start has nothing to warm up with; that's no reason not to serve
+                logger.log(cppbackend::LogLevel::WARNING, cppbackend::LogCategory::CONTROL,
+                           "Starting cold: {}", err.what());
+            }
+        }
+
+        std::unique_ptr<cppbackend::QueryLog> queryLog{};
+        if (!options.captureFile.empty()) {
+            queryLog = std::make_unique<cppbackend::QueryLog>(options.captureFile);
+            backend.setQueryLog(queryLog.get());
+        }
 
         const auto result = backend.performHandshake(std::cin);
         if (!result.getSuccess()) {
             std::cerr << fmt::format("Processor failed during handshake: '{}'", result.getMessage()) << std::endl;
             return EXIT_FAILURE;
         }
-        auto results = backend.readFromInput(std::cin);
-        for (const auto &res : results) {
-            if (!res.getSuccess()) {
-                std::cerr << fmt::format("Processor failed while reading input: '{}'", res.getMessage()) << std::endl;
-                didProcessingSucceed = false;
+        // Only what the queries saw, so runs with and without warm-up compare
+        const auto& stats = backend.getStats();
+        const auto hitsBefore = stats.getPageCacheHits();
+        const auto missesBefore = stats.getPageCacheMisses();
+
+        const auto failures = backend.readFromInput(std::cin);
+
+        const auto hits = stats.getPageCacheHits() - hitsBefore;
+        const auto pageLookups = hits + stats.getPageCacheMisses() - missesBefore;
+        if (pageLookups > 0) {
+            logger.log(cppbackend::LogLevel::INFO, cppbackend::LogCategory::CONTROL,
+                       "Page cache hit ratio {:.1f}% over {} page lookups since the handshake",
+                       100.0 * static_cast<double>(hits) / static_cast<double>(pageLookups), pageLookups);
+        }
+        if (queryLog) {
+            try {
+                const auto saved = queryLog->save();
+                logger.log(cppbackend::LogLevel::INFO, cppbackend::LogCategory::CONTROL,
+                           "Wrote {} qnames to '{}'", saved, queryLog->getPath());
+            } catch (std::exception& err) {
+                logger.log(cppbackend::LogLevel::ERROR, cppbackend::LogCategory::CONTROL, "{}", err.what());
             }
         }
+        for (const auto &failure : failures) {
+            std::cerr << fmt::format("Processor failed while reading input: {}", failure.getMessage()) << std::endl;
+            didProcessingSucceed = false;
+        }
     } catch (std::exception& err) {
+        // Let earlier log lines out first so the error is the last thing on stderr
+        logger.flush();
         std::cerr << fmt::format("Error in processor: {}", err.what()) << std::endl;
         return EXIT_FAILURE;
     }
@@ -0,0 +1,206 @@
+#include "perfecthash.h"
+#include "asciicase.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace cppbackend {
+    namespace {
+        constexpr std::uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+        constexpr std::uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+
+        inline std::uint64_t rotateLeft(std::uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        // MurmurHash3's finaliser: every input bit reaches every output bit
+        inline std::uint64_t avalanche(std::uint64_t value)
+        {
+            value ^= value >> 33;
+            value *= 0xFF51AFD7ED558CCDULL;
+            value ^= value >> 33;
+            value *= 0xC4CEB9FE1A85EC53ULL;
+            value ^= value >> 33;
+            return value;
+        }
+
+        // x scaled from [0, 2^32) to [0, n) without a division
+        inline std::uint32_t scale(std::uint32_t x, std::uint32_t n)
+        {
+            return static_cast<std::uint32_t>((static_cast<std::uint64_t>(x) * n) >> 32);
+        }
+
+        inline std::uint32_t bucketOf(std::uint64_t hash, std::uint32_t bucketCount)
+        {
+            return scale(static_cast<std::uint32_t>(hash), bucketCount);
+        }
+
+        // Every displacement rehashes the key, so each one gives the keys of a
+        // bucket new, independent slots. Two keys only collide at every
+        // displacement when their hashes are equal.
+        inline std::uint32_t position(std::uint64_t hash, std::uint32_t displacement, std::uint32_t keyCount)
+        {
+            return scale(static_cast<std::uint32_t>(avalanche(hash + displacement * PRIME2) >> 32), keyCount);
+        }
+    }
+
+    std::uint64_t PerfectHash::hash(std::string_view key, std::uint64_t seed)
+    {
+        std::uint64_t hash = seed ^ (key.size() * PRIME1);
+        std::size_t position = 0;
+        for (; position + sizeof(std::uint64_t) <= key.size(); position += sizeof(std::uint64_t))
+        {
+            std::uint64_t word;
+            std::memcpy(&word, key.data() + position, sizeof(word));
+            hash = rotateLeft(hash ^ (AsciiCase::foldWord(word) * PRIME2), 31) * PRIME1;
+        }
+        if (position < key.size())
+        {
+            std::uint64_t word = 0;
+            std::memcpy(&word, key.data() + position, key.size() - position);
+            hash = rotateLeft(hash ^ (AsciiCase::foldWord(word) * PRIME2), 31) * PRIME1;
+        }
+        return avalanche(hash);
+    }
+
+    std::uint32_t PerfectHash::slot(std::uint64_t hash, std::uint32_t keyCount,
+                                    const std::uint32_t* displacements, std::uint32_t bucketCount)
+    {
+        return position(hash, displacements[bucketOf(hash, bucketCount)], keyCount);
+    }
+
+    std::uint32_t PerfectHash::fingerprint(std::uint64_t hash)
+    {
+        return static_cast<std::uint32_t>(avalanche(hash ^ PRIME2));
+    }
+
+    std::uint32_t PerfectHash::bucketCount(std::size_t keyCount)
+    {
+        return static_cast<std::uint32_t>(std::max<std::size_t>(1, (keyCount + BUCKET_SIZE - 1) / BUCKET_SIZE));
+    }
+
+    PerfectHash::Table PerfectHash::build(std::size_t keyCount, const KeyHasher& hashOf)
+    {
+        if (keyCount >= std::numeric_limits<std::uint32_t>::max())
+        {
+            throw std::runtime_error(fmt::format("Perfect hash tables hold fewer than 2^32 keys, received {}", keyCount));
+        }
+
+        Table table{};
+        std::vector<std::uint64_t> hashes(keyCount);
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt)
+        {
+            table.seed = PRIME1 * static_cast<std::uint64_t>(attempt + 1);
+            for (std::size_t i = 0; i < keyCount; ++i)
+            {
+                hashes[i] = hashOf(i, table.seed);
+            }
+            if (tryBuild(keyCount, hashes, table))
+            {
+                return table;
+            }
+        }
+        throw std::runtime_error(fmt::format("No perfect hash found for {} keys, some of them are equal", keyCount));
+    }
+
+    bool PerfectHash::tryBuild(std::size_t keyCount, const std::vector<std::uint64_t>& hashes, Table& table)
+    {
+        const auto keys = static_cast<std::uint32_t>(keyCount);
+        const auto buckets = bucketCount(keyCount);
+        table.displacements.assign(buckets, 0);
+        table.slots.assign(keyCount, 0);
+        if (keyCount == 0)
+        {
+            return true;
+        }
+
+        // Keys grouped by bucket with a counting sort
+        std::vector<std::uint32_t> bucketStart(buckets + 1, 0);
+        for (const auto hash : hashes)
+        {
+            ++bucketStart[bucketOf(hash, buckets) + 1];
+        }
+        std::uint32_t largest = 0;
+        for (std::uint32_t bucket = 0; bucket < buckets; ++bucket)
+        {
+            largest = std::max(largest, bucketStart[bucket + 1]);
+            bucketStart[bucket + 1] += bucketStart[bucket];
+        }
+        std::vector<std::uint32_t> bucketKeys(keyCount);
+        {
+            auto next = bucketStart;
+            for (std::uint32_t key = 0; key < keys; ++key)
+            {
+                bucketKeys[next[bucketOf(hashes[key], buckets)]++] = key;
+            }
+        }
+
+        // Largest buckets first, while there is still room for them
+        std::vector<std::uint32_t> order(buckets);
+        for (std::uint32_t bucket = 0; bucket < buckets; ++bucket)
+        {
+            order[bucket] = bucket;
+        }
+        std::stable_sort(order.begin(), order.end(), [&bucketStart](std::uint32_t left, std::uint32_t right) {
+            return bucketStart[left + 1] - bucketStart[left] > bucketStart[right + 1] - bucketStart[right];
+        });
+
+        std::vector<bool> taken(keyCount, false);
+        std::vector<std::uint64_t> bucketHashes(largest);
+        std::vector<std::uint32_t> positions(largest);
+        for (const auto bucket : order)
+        {
+            const auto begin = bucketStart[bucket];
+            const auto size = bucketStart[bucket + 1] - begin;
+            if (size == 0)
+            {
+                break;
+            }
+            for (std::uint32_t i = 0; i < size; ++i)
+            {
+                bucketHashes[i] = hashes[bucketKeys[begin + i]];
+            }
+            for (std::uint32_t i = 1; i < size; ++i)
+            {
+                // Equal hashes collide at every displacement
+                if (std::find(bucketHashes.begin(), bucketHashes.begin() + i, bucketHashes[i]) != bucketHashes.begin() + i)
+                {
+                    return false;
+                }
+            }
+
+            bool placed = false;
+            for (std::uint64_t displacement = 0; displacement <= std::numeric_limits<std::uint32_t>::max(); ++displacement)
+            {
+                bool fits = true;
+                for (std::uint32_t i = 0; i < size && fits; ++i)
+                {
+                    positions[i] = position(bucketHashes[i], static_cast<std::uint32_t>(displacement), keys);
+                    fits = !taken[positions[i]] &&
+                           std::find(positions.begin(), positions.begin() + i, positions[i]) == positions.begin() + i;
+                }
+                if (fits)
+                {
+                    table.displacements[bucket] = static_cast<std::uint32_t>(displacement);
+                    for (std::uint32_t i = 0; i < size; ++i)
+                    {
+                        taken[positions[i]] = true;
+                        table.slots[bucketKeys[begin + i]] = positions[i];
+                    }
+                    placed = true;
+                    break;
+                }
+            }
+            if (!placed)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
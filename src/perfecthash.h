@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace cppbackend {
+    // Minimal perfect hashing in the style of CHD (compress, hash and displace):
+    // n keys get the slots 0..n-1, one each. Keys are split over n/BUCKET_SIZE
+    // buckets by one part of their hash. Each bucket stores the displacement
+    // that moves all of its keys into free slots. A lookup costs one key hash,
+    // one displacement read and one remix. There are no key comparisons, so a
+    // key that was not in the set also gets a slot; callers check a fingerprint
+    // (and the key itself) to turn those away.
+    class PerfectHash {
+    public:
+        // Average keys per bucket. At 4 the displacements take one byte per key
+        // and 10^6 keys build in about half a second.
+        static constexpr std::size_t BUCKET_SIZE = 4;
+
+        struct Table {
+            std::uint64_t seed = 0;
+            std::vector<std::uint32_t> displacements{};
+            // Slot of key i
+            std::vector<std::uint32_t> slots{};
+        };
+
+        // Hash of key index with the given seed, normally hash(key, seed)
+        using KeyHasher = std::function<std::uint64_t(std::size_t index, std::uint64_t seed)>;
+
+        // Throws std::runtime_error when no table can be found, which means
+        // some keys are equal
+        static Table build(std::size_t keyCount, const KeyHasher& hashOf);
+
+        // Ignores ASCII case, like DNS names: keys that only differ in case
+        // hash the same, and must not both be in one table
+        static std::uint64_t hash(std::string_view key, std::uint64_t seed);
+        // Slot of the key with this hash in a table of keyCount keys
+        static std::uint32_t slot(std::uint64_t hash, std::uint32_t keyCount,
+                                  const std::uint32_t* displacements, std::uint32_t bucketCount);
+        // 32 bits remixed from the whole hash with another constant than
+        // slot() uses. Two different hashes give the same fingerprint about
+        // once in 2^32, so a key that isn't in the table but lands on a
+        // key's slot is almost always told apart without reading its name.
+        static std::uint32_t fingerprint(std::uint64_t hash);
+
+        static std::uint32_t bucketCount(std::size_t keyCount);
+    private:
+        // Seeds tried before giving up on a key set
+        static constexpr int MAX_ATTEMPTS = 8;
+
+        static bool tryBuild(std::size_t keyCount, const std::vector<std::uint64_t>& hashes, Table& table);
+    };
+}
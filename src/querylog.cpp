@@ -0,0 +1,137 @@
+#include "querylog.h"
+
+#include "fmt/format.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+#include <unistd.h>
+
+namespace cppbackend {
+    QueryLog::QueryLog(std::string path, std::size_t capacity)
+        : m_path{std::move(path)},
+          m_qnames(capacity == 0 ? 1 : capacity)
+    {
+    }
+
+    void QueryLog::record(const std::string& qname)
+    {
+        m_qnames[m_next].assign(qname);
+        if (++m_next == m_qnames.size())
+        {
+            m_next = 0;
+            m_full = true;
+        }
+    }
+
+    std::vector<std::string> QueryLog::getQnames() const
+    {
+        const auto count = m_full ? m_qnames.size() : m_next;
+
+        std::vector<std::string> qnames{};
+        std::unordered_set<std::string> seen{};
+        for (std::size_t i = 1; i <= count; ++i)
+        {
+            const auto& qname = m_qnames[(m_next + m_qnames.size() - i) % m_qnames.size()];
+            if (seen.insert(qname).second)
+            {
+                qnames.push_back(qname);
+            }
+        }
+        return qnames;
+    }
+
+    std::size_t QueryLog::save() const
+    {
+        const auto qnames = getQnames();
+        // Named after the process, so co-processes sharing the path don't write into one file
+        const auto temporary = fmt::format("{}.{}.tmp", m_path, ::getpid());
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            for (const auto& qname : qnames)
+            {
+                file << qname << '\n';
+            }
+            file.flush();
+            if (!file)
+            {
+                std::remove(temporary.c_str());
+                throw std::runtime_error(fmt::format("Error writing query log '{}'", temporary));
+            }
+        }
+        if (std::rename(temporary.c_str(), m_path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            throw std::runtime_error(fmt::format("Error replacing query log '{}'", m_path));
+        }
+        return qnames.size();
+    }
+
+    std::vector<std::string> QueryLog::readFile(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error(fmt::format("Error opening warm-up file '{}'", path));
+        }
+
+        std::vector<std::string> qnames{};
+        std::unordered_set<std::string> seen{};
+        std::string line;
+        while (std::getline(file, line))
+        {
+            auto qname = parseLine(line);
+            if (!qname.empty() && seen.insert(qname).second)
+            {
+                qnames.push_back(std::move(qname));
+            }
+        }
+        return qnames;
+    }
+
+    std::string QueryLog::parseLine(const std::string& line)
+    {
+        static const std::string whitespace = " \t\r";
+        static const std::string wants = " wants '";
+
+        std::string qname{};
+        if (line.compare(0, 2, "Q\t") == 0)
+        {
+            qname = line.substr(2, line.find('\t', 2) - 2);
+        }
+        else if (const auto found = line.find(wants); found != std::string::npos)
+        {
+            const auto start = found + wants.size();
+            const auto end = line.find_first_of("|'", start);
+            if (end == std::string::npos)
+            {
+                return {};
+            }
+            qname = line.substr(start, end - start);
+        }
+        else
+        {
+            const auto start = line.find_first_not_of(whitespace);
+            if (start == std::string::npos || line[start] == '#')
+            {
+                return {};
+            }
+            const auto end = line.find_last_not_of(whitespace);
+            qname = line.substr(start, end - start + 1);
+            if (qname.find_first_of(whitespace) != std::string::npos)
+            {
+                return {};
+            }
+        }
+
+        // PowerDNS logs names in absolute form, the pipe never does
+        if (qname.size() > 1 && qname.back() == '.')
+        {
+            qname.pop_back();
+        }
+        return qname;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cppbackend {
+    // The most recently answered qnames, kept so the next start can warm up
+    // with them. A fixed ring: once it is full, record() reuses the oldest
+    // entry's storage, so capturing allocates nothing for names that fit it.
+    // Not thread-safe; record() is called from the thread reading the pipe.
+    class QueryLog {
+    public:
+        static constexpr std::size_t DEFAULT_CAPACITY = 10000;
+
+        explicit QueryLog(std::string path, std::size_t capacity = DEFAULT_CAPACITY);
+
+        void record(const std::string& qname);
+
+        // The captured qnames, newest first and without repeats
+        [[nodiscard]] std::vector<std::string> getQnames() const;
+        // Writes getQnames() to the path, one per line, replacing the file in
+        // one rename so a crash never leaves half a file. Returns the number of
+        // qnames written; throws std::runtime_error when the file can't be written.
+        std::size_t save() const;
+
+        [[nodiscard]] const std::string& getPath() const { return m_path; }
+
+        // Reads qnames to warm up with, in file order and without repeats. Each
+        // line can be a bare qname (as save() writes them), a pipe backend
+        // query line ("Q\tqname\t..."), or a PowerDNS query-logging line
+        // ("... wants 'qname|TXT' ..."). Other lines and '#' comments are
+        // skipped. Throws std::runtime_error when the file can't be read.
+        static std::vector<std::string> readFile(const std::string& path);
+        // The qname in one line of a warm-up file, empty when there is none
+        static std::string parseLine(const std::string& line);
+    private:
+        const std::string m_path;
+        std::vector<std::string> m_qnames;
+        std::size_t m_next = 0;
+        bool m_full = false;
+    };
+}
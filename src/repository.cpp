@@ -1,33 +1,130 @@
 #include "repository.h"
+#include "logger.h"
 #include "fmt/format.h"
 #include <stdexcept>
-#include <vector>
 
 namespace cppbackend {
-    Repository::Repository(const std::string& dbPath)
+    Repository::Repository(const std::string& dbPath, const RepositoryOptions& options)
     {
         if (dbPath.empty())
         {
             throw std::invalid_argument("Database path cannot be empty");
         }
 
-        auto result = sqlite3_open_v2(dbPath.c_str(),
+        int flags = SQLITE_OPEN_READONLY;
+        if (options.noMutex)
+        {
+            flags |= SQLITE_OPEN_NOMUTEX;
+        }
+        if (options.sharedCache)
+        {
+            flags |= SQLITE_OPEN_SHAREDCACHE;
+        }
+
+        std::string filename = dbPath;
+        if (options.immutable)
+        {
+            flags |= SQLITE_OPEN_URI;
+            filename = toURI(dbPath) + "?immutable=1";
+        }
+
+        auto result = sqlite3_open_v2(filename.c_str(),
                                       &m_database,
-                                      SQLITE_OPEN_READONLY,
+                                      flags,
                                       nullptr);
         if (result != SQLITE_OK)
         {
+            sqlite3_close_v2(m_database);
+            m_database = nullptr;
             // TODO: Create custom exception
             throw std::runtime_error("Error opening database");
         }
 
         m_ready = true;
+
+        std::string pragmas{};
+        if (options.mmapSize > 0)
+        {
+            pragmas += fmt::format("PRAGMA mmap_size={};", options.mmapSize);
+        }
+        if (options.cacheSizeKiB > 0)
+        {
+            // Negative cache_size values are in KiB rather than pages
+            pragmas += fmt::format("PRAGMA cache_size=-{};", options.cacheSizeKiB);
+        }
+        if (options.tempStoreMemory)
+        {
+            pragmas += "PRAGMA temp_store=MEMORY;";
+        }
+        if (!pragmas.empty() &&
+            sqlite3_exec(m_database, pragmas.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            const std::string error = sqlite3_errmsg(m_database);
+            sqlite3_close_v2(m_database);
+            m_ready = false;
+            throw std::runtime_error(fmt::format("Error tuning database connection: {}", error));
+        }
+
+        // SQLite folds ASCII case for COLLATE NOCASE in place, but can only use an
+        // index declared with the same collation. An older --create-index only
+        // made a case-sensitive one; keep exact matching there rather than scan.
+        m_caseInsensitive = checkLookupIndexed(m_database, TXT_RECORD_QUERY) ||
+                            !checkLookupIndexed(m_database, TXT_RECORD_EXACT_QUERY);
+        const auto& query = m_caseInsensitive ? TXT_RECORD_QUERY : TXT_RECORD_EXACT_QUERY;
+        const auto& ttlQuery = m_caseInsensitive ? TXT_RECORD_TTL_QUERY : TXT_RECORD_TTL_EXACT_QUERY;
+
+        // Prepared once and reused by every lookup on this connection. Older
+        // databases have no ttl column, so fall back to the query without it. A
+        // schema without the tables leaves it null and every lookup finds nothing.
+        m_defaultTTL = options.defaultTTL;
+        m_hasTTLColumn = sqlite3_prepare_v3(m_database, ttlQuery.c_str(), -1,
+                                            SQLITE_PREPARE_PERSISTENT, &m_statement, nullptr) == SQLITE_OK;
+        if (m_hasTTLColumn ||
+            sqlite3_prepare_v3(m_database, query.c_str(), -1,
+                               SQLITE_PREPARE_PERSISTENT, &m_statement, nullptr) == SQLITE_OK)
+        {
+            const int expected = m_hasTTLColumn ? 2 : 1;
+            const int cols = sqlite3_column_count(m_statement);
+            if (cols != expected)
+            {
+                sqlite3_finalize(m_statement);
+                sqlite3_close_v2(m_database);
+                m_ready = false;
+                // TODO: Create custom exception
+                throw std::runtime_error(fmt::format("Error in query results. Expected {} column(s), received {}",
+                                                     expected, cols));
+            }
+        }
+        else
+        {
+            m_statement = nullptr;
+        }
+
+        m_lookupIndexed = checkLookupIndexed(m_database, m_hasTTLColumn ? ttlQuery : query);
+        if (!m_caseInsensitive)
+        {
+            Logger::global().log(
+                    LogLevel::WARNING, LogCategory::REPOSITORY,
+                    "TXT record lookups in '{}' are case-sensitive, because its index was made by an older "
+                    "--create-index. Run 'cppbackend --create-index {} NEW_DATABASE_PATH' and serve the copy "
+                    "it creates.",
+                    dbPath, dbPath);
+        }
+        else if (!m_lookupIndexed)
+        {
+            Logger::global().log(
+                    LogLevel::WARNING, LogCategory::REPOSITORY,
+                    "TXT record lookups in '{}' are not index-backed and scan a whole table on every query. "
+                    "Run 'cppbackend --create-index {} NEW_DATABASE_PATH' and serve the copy it creates.",
+                    dbPath, dbPath);
+        }
     }
 
     Repository::~Repository()
     {
         if (m_database && m_ready)
         {
+            sqlite3_finalize(m_statement);
             sqlite3_close_v2(m_database);
             m_ready = false;
         }
@@ -35,44 +132,292 @@ namespace cppbackend {
 
     std::string Repository::getTXTRecord(const std::string &domain, int platform) const
     {
-        const std::string query =
-                fmt::format(
-                        "SELECT txt FROM platform JOIN domain ON platform.domain_id = domain.id WHERE domain.name=\"{}\" AND platform.nbr={}",
-                        domain,
-                        platform);
-        std::vector<std::string> txtRecords{};
+        int ttl = 0;
+        return getTXTRecord(domain, platform, ttl);
+    }
+
+    std::string Repository::getTXTRecord(const std::string &domain, int platform, int& ttl) const
+    {
+        ttl = m_defaultTTL;
+        if (!m_statement)
+        {
+            return "";
+        }
+
+        sqlite3_bind_text(m_statement, 1, domain.c_str(), static_cast<int>(domain.size()), SQLITE_STATIC);
+        sqlite3_bind_int(m_statement, 2, platform);
+
+        std::string txtRecord{};
+        if (sqlite3_step(m_statement) == SQLITE_ROW)
+        {
+            txtRecord.assign(reinterpret_cast<const char*>(sqlite3_column_text(m_statement, 0)),
+                             static_cast<std::size_t>(sqlite3_column_bytes(m_statement, 0)));
+            // A NULL or negative ttl means the row has none of its own
+            if (m_hasTTLColumn && sqlite3_column_type(m_statement, 1) != SQLITE_NULL &&
+                sqlite3_column_int(m_statement, 1) >= 0)
+            {
+                ttl = sqlite3_column_int(m_statement, 1);
+            }
+        }
 
+        // The domain binding points into the caller's string, so never leave it behind
+        sqlite3_reset(m_statement);
+        sqlite3_clear_bindings(m_statement);
+
+        return txtRecord;
+    }
+
+    std::int64_t Repository::warmCache() const
+    {
         sqlite3_stmt* statement;
-        if (sqlite3_prepare_v2(m_database, query.c_str(), -1, &statement, 0) == SQLITE_OK)
+        if (!m_database || sqlite3_prepare_v2(m_database, WARM_CACHE_QUERY.c_str(), -1, &statement, 0) != SQLITE_OK)
         {
-            int cols = sqlite3_column_count(statement);
-            if (cols != 1)
+            throw std::runtime_error(fmt::format("Error warming the page cache: {}",
+                                                 m_database ? sqlite3_errmsg(m_database) : "database is not open"));
+        }
+
+        std::int64_t rows = 0;
+        if (sqlite3_step(statement) == SQLITE_ROW)
+        {
+            rows = sqlite3_column_int64(statement, 0);
+        }
+        sqlite3_finalize(statement);
+
+        return rows;
+    }
+
+    int Repository::releaseCache() const
+    {
+        if (!m_database)
+        {
+            return 0;
+        }
+        int before = 0;
+        int after = 0;
+        int highwater = 0;
+        sqlite3_db_status(m_database, SQLITE_DBSTATUS_CACHE_USED, &before, &highwater, 0);
+        sqlite3_db_release_memory(m_database);
+        sqlite3_db_status(m_database, SQLITE_DBSTATUS_CACHE_USED, &after, &highwater, 0);
+        return before - after;
+    }
+
+    void Repository::forEachRecord(const RecordVisitor& visit) const
+    {
+        const auto& query = m_hasTTLColumn ? ALL_RECORDS_TTL_QUERY : ALL_RECORDS_QUERY;
+        sqlite3_stmt* statement;
+        if (!m_database || sqlite3_prepare_v2(m_database, query.c_str(), -1, &statement, 0) != SQLITE_OK)
+        {
+            throw std::runtime_error(fmt::format("Error reading records: {}",
+                                                 m_database ? sqlite3_errmsg(m_database) : "database is not open"));
+        }
+
+        // Text first, then its length, as sqlite3_column_bytes documents
+        const auto column = [statement](int index) {
+            const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(statement, index));
+            return std::string_view(text ? text : "", static_cast<std::size_t>(sqlite3_column_bytes(statement, index)));
+        };
+
+        int result = sqlite3_step(statement);
+        try {
+            for (; result == SQLITE_ROW; result = sqlite3_step(statement))
             {
-                // TODO: Create custom exception
-                throw std::runtime_error(fmt::format("Error in query results. Expected 1 column, received {}", cols));
+                int ttl = -1;
+                if (m_hasTTLColumn && sqlite3_column_type(statement, 3) != SQLITE_NULL &&
+                    sqlite3_column_int(statement, 3) >= 0)
+                {
+                    ttl = sqlite3_column_int(statement, 3);
+                }
+                visit(column(0), sqlite3_column_int(statement, 1), column(2), ttl);
+            }
+        } catch (...) {
+            sqlite3_finalize(statement);
+            throw;
+        }
+        sqlite3_finalize(statement);
+
+        if (result != SQLITE_DONE)
+        {
+            throw std::runtime_error(fmt::format("Error reading records: {}", sqlite3_errstr(result)));
+        }
+    }
+
+    std::int64_t Repository::getPageCacheHits() const
+    {
+        int hits = 0;
+        int highwater = 0;
+        if (m_database)
+        {
+            sqlite3_db_status(m_database, SQLITE_DBSTATUS_CACHE_HIT, &hits, &highwater, 0);
+        }
+        return hits;
+    }
+
+    std::int64_t Repository::getPageCacheMisses() const
+    {
+        int misses = 0;
+        int highwater = 0;
+        if (m_database)
+        {
+            sqlite3_db_status(m_database, SQLITE_DBSTATUS_CACHE_MISS, &misses, &highwater, 0);
+        }
+        return misses;
+    }
+
+    std::map<int, std::string> Repository::getPlatformKeys() const
+    {
+        sqlite3_stmt* statement;
+        if (!m_database || sqlite3_prepare_v2(m_database, PLATFORM_KEY_QUERY.c_str(), -1, &statement, 0) != SQLITE_OK)
+        {
+            throw std::runtime_error(fmt::format("Error reading platform keys: {}",
+                                                 m_database ? sqlite3_errmsg(m_database) : "database is not open"));
+        }
+
+        std::map<int, std::string> keys{};
+        std::string error{};
+        int result;
+        for (int row = 1; (result = sqlite3_step(statement)) == SQLITE_ROW; ++row)
+        {
+            if (sqlite3_column_type(statement, 0) == SQLITE_NULL || sqlite3_column_type(statement, 1) == SQLITE_NULL)
+            {
+                error = fmt::format("row {} has a NULL nbr or key", row);
+                break;
             }
+            const auto platform = sqlite3_column_int(statement, 0);
+            const auto* key = reinterpret_cast<const char*>(sqlite3_column_text(statement, 1));
+            if (!keys.try_emplace(platform, key, static_cast<std::size_t>(sqlite3_column_bytes(statement, 1))).second)
+            {
+                error = fmt::format("row {} repeats platform {}", row, platform);
+                break;
+            }
+        }
+        if (error.empty() && result != SQLITE_DONE)
+        {
+            error = sqlite3_errmsg(m_database);
+        }
+        sqlite3_finalize(statement);
+
+        if (!error.empty())
+        {
+            throw std::runtime_error(fmt::format("Error reading platform keys: {}", error));
+        }
+        return keys;
+    }
 
-            int result = sqlite3_step(statement);
-            while (result == SQLITE_ROW)
+    std::string Repository::toURI(const std::string& path)
+    {
+        // Only the characters with a meaning inside a file: URI need escaping
+        std::string uri{"file:"};
+        for (const char c : path)
+        {
+            if (c == '%' || c == '?' || c == '#')
             {
-                txtRecords.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(statement, 0)));
-                result = sqlite3_step(statement);
+                uri += fmt::format("%{:02X}", static_cast<unsigned char>(c));
             }
+            else
+            {
+                uri.push_back(c);
+            }
+        }
+        return uri;
+    }
 
-            sqlite3_finalize(statement);
+    bool Repository::checkLookupIndexed(sqlite3* database, const std::string& query)
+    {
+        const auto explain = fmt::format("EXPLAIN QUERY PLAN {}", query);
+
+        sqlite3_stmt* statement;
+        if (sqlite3_prepare_v2(database, explain.c_str(), -1, &statement, 0) != SQLITE_OK)
+        {
+            // The schema doesn't support the query at all; getTXTRecord will find nothing
+            return false;
         }
 
-        if (txtRecords.empty())
+        // Each plan row is (id, parent, notused, detail). Index-backed steps read
+        // "SEARCH ..."; a full table scan reads "SCAN platform" ("SCAN TABLE
+        // platform" before SQLite 3.36).
+        bool indexed = true;
+        while (sqlite3_step(statement) == SQLITE_ROW)
         {
-            return "";
+            const auto detail = reinterpret_cast<const char*>(sqlite3_column_text(statement, 3));
+            if (detail && std::string(detail).rfind("SCAN", 0) == 0)
+            {
+                indexed = false;
+            }
         }
-        else if (txtRecords.size() == 1)
+        sqlite3_finalize(statement);
+
+        return indexed;
+    }
+
+    void Repository::createIndexes(const std::string& sourcePath, const std::string& destinationPath)
+    {
+        if (sourcePath.empty() || destinationPath.empty())
+        {
+            throw std::invalid_argument("Database paths cannot be empty");
+        }
+        if (sourcePath == destinationPath)
         {
-            return txtRecords[0];
+            throw std::invalid_argument("Indexes are created on a copy; the destination must differ from the source");
+        }
+
+        sqlite3* source = nullptr;
+        if (sqlite3_open_v2(sourcePath.c_str(), &source, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+        {
+            sqlite3_close_v2(source);
+            throw std::runtime_error("Error opening database");
+        }
+
+        sqlite3* destination = nullptr;
+        if (sqlite3_open_v2(destinationPath.c_str(), &destination,
+                            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+        {
+            sqlite3_close_v2(source);
+            sqlite3_close_v2(destination);
+            throw std::runtime_error(fmt::format("Error creating database '{}'", destinationPath));
+        }
+
+        std::string error{};
+        auto* backup = sqlite3_backup_init(destination, "main", source, "main");
+        if (!backup)
+        {
+            error = sqlite3_errmsg(destination);
         }
         else
         {
-            throw std::runtime_error(fmt::format("Error in query results. Expected 1 row, received {}", txtRecords.size()));
+            sqlite3_backup_step(backup, -1);
+            if (sqlite3_backup_finish(backup) != SQLITE_OK)
+            {
+                error = sqlite3_errmsg(destination);
+            }
+        }
+
+        if (error.empty())
+        {
+            // Index the query the lookups will actually run
+            sqlite3_stmt* probe = nullptr;
+            const bool hasTTLColumn = sqlite3_prepare_v2(destination, TXT_RECORD_TTL_QUERY.c_str(), -1,
+                                                         &probe, nullptr) == SQLITE_OK;
+            sqlite3_finalize(probe);
+
+            char* message = nullptr;
+            const auto& indexes = hasTTLColumn ? CREATE_TTL_INDEXES : CREATE_INDEXES;
+            if (sqlite3_exec(destination, indexes.c_str(), nullptr, nullptr, &message) != SQLITE_OK)
+            {
+                error = message ? message : "unknown error";
+                sqlite3_free(message);
+            }
+            else if (!checkLookupIndexed(destination, hasTTLColumn ? TXT_RECORD_TTL_QUERY : TXT_RECORD_QUERY))
+            {
+                error = "lookups are still not index-backed after creating the indexes";
+            }
+        }
+
+        sqlite3_close_v2(source);
+        sqlite3_close_v2(destination);
+
+        if (!error.empty())
+        {
+            throw std::runtime_error(fmt::format("Error creating indexes in '{}': {}", destinationPath, error));
         }
     }
 }
@@ -1,18 +1,140 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <string>
+#include <string_view>
 
 #include "sqlite3.h"
 
 namespace cppbackend {
+    // How the read-only connection is opened and tuned. The defaults suit a
+    // database that is only ever read by this process; see README for details.
+    struct RepositoryOptions {
+        // SQLITE_OPEN_NOMUTEX: skip SQLite's per-connection locking. Safe as long
+        // as a connection is never used by two threads at once.
+        bool noMutex = true;
+        // Open as "file:...?immutable=1". SQLite then takes no file locks and
+        // never checks for changes, so only use it when nothing writes the file
+        // while the backend is running.
+        bool immutable = false;
+        // SQLITE_OPEN_SHAREDCACHE: connections in this process share one page cache
+        bool sharedCache = false;
+        // PRAGMA mmap_size in bytes. 0 leaves SQLite's default (no memory mapping).
+        std::int64_t mmapSize = 256 * 1024 * 1024;
+        // PRAGMA cache_size in KiB. 0 leaves SQLite's default.
+        int cacheSizeKiB = 16 * 1024;
+        // PRAGMA temp_store=MEMORY
+        bool tempStoreMemory = true;
+
+        static constexpr int DEFAULT_TTL = 3600;
+        // TTL in seconds for answers whose row has no ttl, or when the platform
+        // table has no ttl column at all
+        int defaultTTL = DEFAULT_TTL;
+    };
+
+    // One read-only SQLite connection with its lookup statement prepared once.
+    // A Repository must not be used by two threads at the same time; share a
+    // RepositoryPool between threads instead.
     class Repository {
     public:
-        Repository(const std::string& dbPath);
+        Repository(const std::string& dbPath, const RepositoryOptions& options = {});
         ~Repository();
 
+        Repository(const Repository&) = delete;
+        Repository& operator=(const Repository&) = delete;
+
+        // Domains match regardless of ASCII case, unless isCaseInsensitive() is
+        // false. When several rows match, the first in RECORD_ORDER answers.
         std::string getTXTRecord(const std::string& domain, int platform) const;
+        // Also sets ttl: the row's ttl column when the schema has one and it is
+        // set, otherwise RepositoryOptions::defaultTTL
+        std::string getTXTRecord(const std::string& domain, int platform, int& ttl) const;
+
+        [[nodiscard]] bool hasTTLColumn() const { return m_hasTTLColumn; }
+
+        // Reads every lookup row once, so the pages TXT_RECORD_QUERY needs are in
+        // this connection's page cache (and the OS cache when mmap is on).
+        // Returns the number of rows read; throws std::runtime_error on failure.
+        std::int64_t warmCache() const;
+        // Frees as much of this connection's page cache as SQLite can. Returns
+        // the number of bytes released.
+        int releaseCache() const;
+        // Page cache lookups on this connection since it was opened: hits found
+        // the page cached, misses had to read it from the file or the mmap
+        [[nodiscard]] std::int64_t getPageCacheHits() const;
+        [[nodiscard]] std::int64_t getPageCacheMisses() const;
+
+        // Calls visit for every TXT record, in RECORD_ORDER. ttl is the
+        // row's own ttl, or -1 when it has none. The views are only valid during
+        // the call. Throws std::runtime_error when the records can't be read.
+        using RecordVisitor = std::function<void(std::string_view domain, int platform, std::string_view txt, int ttl)>;
+        void forEachRecord(const RecordVisitor& visit) const;
+
+        // Every row of the platform_key table, by platform number. Throws
+        // std::runtime_error when the database has no such table.
+        [[nodiscard]] std::map<int, std::string> getPlatformKeys() const;
+
+        // True when SQLite can answer TXT_RECORD_QUERY through indexes instead of
+        // scanning a table. Checked once when the database is opened.
+        [[nodiscard]] bool isLookupIndexed() const { return m_lookupIndexed; }
+        // False only for databases indexed by an older --create-index, whose
+        // case-sensitive index can't serve case-insensitive lookups. Those keep
+        // matching exactly rather than scan a table on every query.
+        [[nodiscard]] bool isCaseInsensitive() const { return m_caseInsensitive; }
+
+        // Copies the database at sourcePath to destinationPath and creates the
+        // covering indexes the lookup needs on the copy: those of CREATE_INDEXES,
+        // or CREATE_TTL_INDEXES when platform has a ttl column. The source is
+        // never modified, so it can stay read-only while PowerDNS is using it.
+        static void createIndexes(const std::string& sourcePath, const std::string& destinationPath);
+
+        // Names that only differ in case, or repeated rows, all match; like the
+        // snapshot, lookups take the first of them in RECORD_ORDER
+        static inline std::string const RECORD_ORDER = " ORDER BY domain.id, platform.rowid";
+        static inline std::string const TXT_RECORD_QUERY =
+                "SELECT txt FROM platform JOIN domain ON platform.domain_id = domain.id "
+                "WHERE domain.name=?1 COLLATE NOCASE AND platform.nbr=?2" + RECORD_ORDER + " LIMIT 1";
+        // Used instead of TXT_RECORD_QUERY when platform has a ttl column
+        static inline std::string const TXT_RECORD_TTL_QUERY =
+                "SELECT txt, ttl FROM platform JOIN domain ON platform.domain_id = domain.id "
+                "WHERE domain.name=?1 COLLATE NOCASE AND platform.nbr=?2" + RECORD_ORDER + " LIMIT 1";
+        // The same when isCaseInsensitive() is false
+        static inline std::string const TXT_RECORD_EXACT_QUERY =
+                "SELECT txt FROM platform JOIN domain ON platform.domain_id = domain.id "
+                "WHERE domain.name=?1 AND platform.nbr=?2" + RECORD_ORDER + " LIMIT 1";
+        static inline std::string const TXT_RECORD_TTL_EXACT_QUERY =
+                "SELECT txt, ttl FROM platform JOIN domain ON platform.domain_id = domain.id "
+                "WHERE domain.name=?1 AND platform.nbr=?2" + RECORD_ORDER + " LIMIT 1";
+        static inline std::string const ALL_RECORDS_QUERY =
+                "SELECT domain.name, platform.nbr, txt FROM platform JOIN domain ON platform.domain_id = domain.id" +
+                RECORD_ORDER;
+        static inline std::string const ALL_RECORDS_TTL_QUERY =
+                "SELECT domain.name, platform.nbr, txt, ttl FROM platform JOIN domain ON platform.domain_id = domain.id" +
+                RECORD_ORDER;
+        static inline std::string const WARM_CACHE_QUERY =
+                "SELECT count(*), sum(length(domain.name)), sum(length(txt)) FROM platform JOIN domain ON platform.domain_id = domain.id";
+        static inline std::string const PLATFORM_KEY_QUERY =
+                "SELECT nbr, key FROM platform_key";
+        static inline std::string const CREATE_INDEXES =
+                "CREATE INDEX IF NOT EXISTS domain_name_nocase_idx ON domain (name COLLATE NOCASE);"
+                "CREATE INDEX IF NOT EXISTS platform_domain_id_nbr_txt_idx ON platform (domain_id, nbr, txt);";
+        // The same with ttl in the platform index, so TXT_RECORD_TTL_QUERY never
+        // reads the table itself
+        static inline std::string const CREATE_TTL_INDEXES =
+                "CREATE INDEX IF NOT EXISTS domain_name_nocase_idx ON domain (name COLLATE NOCASE);"
+                "CREATE INDEX IF NOT EXISTS platform_domain_id_nbr_txt_ttl_idx ON platform (domain_id, nbr, txt, ttl);";
     private:
         bool m_ready = false;
+        bool m_lookupIndexed = false;
+        bool m_caseInsensitive = true;
+        bool m_hasTTLColumn = false;
+        int m_defaultTTL = RepositoryOptions::DEFAULT_TTL;
         sqlite3* m_database = nullptr;
+        sqlite3_stmt* m_statement = nullptr;
+
+        static bool checkLookupIndexed(sqlite3* database, const std::string& query);
+        static std::string toURI(const std::string& path);
     };
 }
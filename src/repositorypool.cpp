@@ -0,0 +1,90 @@
+#include "repositorypool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <utility>
+
+namespace cppbackend {
+    namespace {
+        std::atomic<std::uint64_t> nextPoolId{1};
+
+        struct ThreadRepository {
+            std::uint64_t generation = 0;
+            const Repository* repository = nullptr;
+        };
+
+        // Connections of the current thread, by pool id
+        thread_local std::unordered_map<std::uint64_t, ThreadRepository> threadRepositories{};
+    }
+
+    RepositoryPool::RepositoryPool(std::string dbPath, const RepositoryOptions& options)
+        : m_dbPath{std::move(dbPath)},
+          m_options{options},
+          m_id{nextPoolId.fetch_add(1, std::memory_order_relaxed)}
+    {
+        // Open the constructing thread's connection now, so a bad path fails here
+        // rather than on the first query
+        m_lookupIndexed = local().isLookupIndexed();
+    }
+
+    std::string RepositoryPool::getTXTRecord(const std::string& domain, int platform) const
+    {
+        return local().getTXTRecord(domain, platform);
+    }
+
+    std::string RepositoryPool::getTXTRecord(const std::string& domain, int platform, int& ttl) const
+    {
+        return local().getTXTRecord(domain, platform, ttl);
+    }
+
+    const Repository& RepositoryPool::local() const
+    {
+        const auto generation = m_generation.load(std::memory_order_acquire);
+        const auto found = threadRepositories.find(m_id);
+        if (found != threadRepositories.end() && found->second.generation == generation)
+        {
+            return *found->second.repository;
+        }
+        // Opening the database is the slow part, keep it outside the lock
+        return open(generation, std::make_unique<Repository>(m_dbPath, m_options));
+    }
+
+    void RepositoryPool::reload()
+    {
+        // Opening first means a failure leaves every thread where it was
+        auto repository = std::make_unique<Repository>(m_dbPath, m_options);
+        m_lookupIndexed.store(repository->isLookupIndexed(), std::memory_order_relaxed);
+        const auto generation = m_generation.fetch_add(1, std::memory_order_acq_rel) + 1;
+        open(generation, std::move(repository));
+    }
+
+    std::size_t RepositoryPool::getConnectionCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_repositories.size();
+    }
+
+    const Repository& RepositoryPool::open(std::uint64_t generation, std::unique_ptr<Repository> repository) const
+    {
+        const Repository* opened = repository.get();
+        auto& current = threadRepositories[m_id];
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // The previous connection was only ever used by this thread. It is
+            // swapped out here and closed once the lock is released.
+            const auto previous = std::find_if(m_repositories.begin(), m_repositories.end(),
+                                               [&current](const auto& owned) { return owned.get() == current.repository; });
+            if (previous != m_repositories.end())
+            {
+                previous->swap(repository);
+            }
+            else
+            {
+                m_repositories.push_back(std::move(repository));
+            }
+        }
+        current = ThreadRepository{generation, opened};
+        return *opened;
+    }
+}
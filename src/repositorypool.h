@@ -0,0 +1,61 @@
+#pragma once
+
+#include "repository.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cppbackend {
+    // Hands every thread its own read-only Repository, so lookups can run on
+    // several threads at once without sharing a connection. A thread's
+    // connection is opened the first time it calls getTXTRecord (the only time
+    // a lock is taken) and lives until the thread replaces it after a reload(),
+    // or as long as the pool. reload() makes every thread switch to a fresh
+    // connection at its next lookup.
+    class RepositoryPool {
+    public:
+        explicit RepositoryPool(std::string dbPath, const RepositoryOptions& options = {});
+        ~RepositoryPool() = default;
+
+        RepositoryPool(const RepositoryPool&) = delete;
+        RepositoryPool& operator=(const RepositoryPool&) = delete;
+
+        [[nodiscard]] std::string getTXTRecord(const std::string& domain, int platform) const;
+        [[nodiscard]] std::string getTXTRecord(const std::string& domain, int platform, int& ttl) const;
+
+        // The calling thread's connection
+        [[nodiscard]] const Repository& local() const;
+
+        // Opens a new connection for the calling thread, then retires every
+        // other one: each thread opens a new connection at its next lookup, and
+        // sees the database file as it is now. Only its own thread uses a
+        // connection, so each thread closes its retired one when it opens the
+        // new one; those of threads that never look up again are closed with
+        // the pool. Throws like the constructor if the database can no longer
+        // be opened, in which case the current connections stay in use.
+        void reload();
+        [[nodiscard]] std::uint64_t getGeneration() const { return m_generation.load(std::memory_order_acquire); }
+
+        // Of the database as last opened or reloaded
+        [[nodiscard]] bool isLookupIndexed() const { return m_lookupIndexed.load(std::memory_order_relaxed); }
+        [[nodiscard]] std::size_t getConnectionCount() const;
+    private:
+        const std::string m_dbPath;
+        const RepositoryOptions m_options;
+        // Never reused, so a thread can't mistake a new pool at the address of a
+        // destroyed one for the pool it has a connection to
+        const std::uint64_t m_id;
+        std::atomic<bool> m_lookupIndexed{false};
+        std::atomic<std::uint64_t> m_generation{0};
+
+        mutable std::mutex m_mutex;
+        mutable std::vector<std::unique_ptr<Repository>> m_repositories;
+
+        // Makes a new connection the calling thread's, closing its previous one
+        const Repository& open(std::uint64_t generation, std::unique_ptr<Repository> repository) const;
+    };
+}
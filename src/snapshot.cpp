@@ -0,0 +1,499 @@
+#include "snapshot.h"
+#include "asciicase.h"
+#include "base64encoder.h"
+#include "labelpool.h"
+#include "logger.h"
+#include "perfecthash.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cppbackend {
+    struct Snapshot::Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t headerSize;
+        DatabaseIdentity identity;
+        std::uint64_t recordCount;
+        std::uint64_t domainCount;
+        std::uint64_t hashSeed;
+        std::uint64_t bucketCount;
+        std::uint64_t displacementsOffset;
+        std::uint64_t domainsOffset;
+        std::uint64_t stringsOffset;
+        std::uint64_t stringsSize;
+        // Of everything but itself: the header fields above seed the one of
+        // everything after the header
+        std::uint64_t checksum;
+    };
+
+    // Everything a lookup reads apart from the strings, in one cache line
+    struct alignas(Snapshot::CACHE_LINE_SIZE) Snapshot::Domain {
+        // Of the name, checked before the name itself is read
+        std::uint32_t fingerprint;
+        // Of the name's length byte, as in LabelPool
+        std::uint32_t nameOffset;
+        // The answer of the i-th platform is strings[answerEnds[i], answerEnds[i + 1])
+        std::uint32_t answerEnds[PLATFORMS + 1];
+        // NO_ANSWER for platforms without a record
+        std::int32_t ttls[PLATFORMS];
+    };
+
+    namespace {
+        // Also tells a snapshot written on a machine of the other byte order apart
+        constexpr char MAGIC[8] = {'C', 'P', 'P', 'B', 'S', 'N', 'A', 'P'};
+        constexpr std::size_t SQLITE_CHANGE_COUNTER_OFFSET = 24;
+        constexpr std::int32_t NO_ANSWER = std::numeric_limits<std::int32_t>::min();
+
+        constexpr std::size_t alignUp(std::size_t value, std::size_t alignment = 8)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        std::int64_t modificationTime(const struct stat& status)
+        {
+            return static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+        }
+
+        std::uint64_t rotateLeft(std::uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        // Throws when the strings would no longer fit 32-bit offsets
+        std::uint32_t append(std::string& strings, std::string_view text)
+        {
+            if (strings.size() + text.size() > std::numeric_limits<std::uint32_t>::max())
+            {
+                throw std::runtime_error("Error building snapshot: the records need more than 4 GiB");
+            }
+            const auto offset = static_cast<std::uint32_t>(strings.size());
+            strings.append(text);
+            return offset;
+        }
+    }
+
+    DatabaseIdentity DatabaseIdentity::of(const std::string& dbPath)
+    {
+        struct stat status{};
+        if (::stat(dbPath.c_str(), &status) != 0)
+        {
+            throw std::runtime_error(fmt::format("Error reading database '{}': {}", dbPath, std::strerror(errno)));
+        }
+
+        DatabaseIdentity identity{};
+        identity.size = static_cast<std::uint64_t>(status.st_size);
+        identity.modifiedNs = modificationTime(status);
+
+        std::ifstream file(dbPath, std::ios::binary);
+        unsigned char counter[4] = {};
+        if (!file.seekg(SQLITE_CHANGE_COUNTER_OFFSET) ||
+            !file.read(reinterpret_cast<char*>(counter), sizeof(counter)))
+        {
+            throw std::runtime_error(fmt::format("Error reading the header of database '{}'", dbPath));
+        }
+        // Big-endian, like every integer in the SQLite header
+        identity.changeCounter = (static_cast<std::uint32_t>(counter[0]) << 24) |
+                                 (static_cast<std::uint32_t>(counter[1]) << 16) |
+                                 (static_cast<std::uint32_t>(counter[2]) << 8) |
+                                 static_cast<std::uint32_t>(counter[3]);
+
+        struct stat walStatus{};
+        if (::stat((dbPath + "-wal").c_str(), &walStatus) == 0)
+        {
+            identity.walSize = static_cast<std::uint64_t>(walStatus.st_size);
+            identity.walModifiedNs = modificationTime(walStatus);
+        }
+
+        return identity;
+    }
+
+    bool DatabaseIdentity::operator==(const DatabaseIdentity& other) const
+    {
+        return size == other.size && modifiedNs == other.modifiedNs && changeCounter == other.changeCounter &&
+               walSize == other.walSize && walModifiedNs == other.walModifiedNs;
+    }
+
+    Snapshot::~Snapshot()
+    {
+        if (m_mapped)
+        {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    std::unique_ptr<const Snapshot> Snapshot::open(const std::string& dbPath,
+                                                   const Repository& repository,
+                                                   const std::string& snapshotPath)
+    {
+        try {
+            return load(snapshotPath, dbPath);
+        } catch (std::runtime_error&) {
+            // Missing, stale or damaged: all mean building a new one
+        }
+
+        auto snapshot = build(dbPath, repository);
+        try {
+            snapshot->save(snapshotPath);
+        } catch (std::runtime_error&) {
+            // Only the next start is slower
+        }
+        return snapshot;
+    }
+
+    std::unique_ptr<const Snapshot> Snapshot::build(const std::string& dbPath, const Repository& repository)
+    {
+        // Taken first, so a write while reading makes the snapshot stale rather than wrong
+        const auto identity = DatabaseIdentity::of(dbPath);
+
+        // Answers as they are read, before they are grouped by domain
+        struct Row {
+            // Offset of the domain's name in names
+            std::uint32_t domain;
+            std::int32_t platform;
+            std::int32_t ttl;
+            std::uint32_t answerOffset;
+            std::uint32_t answerLength;
+        };
+        std::vector<Row> rows{};
+        LabelPool names{};
+        std::string staging{};
+        std::string encoded{};
+        std::string lowered{};
+
+        repository.forEachRecord([&](std::string_view domain, int platform, std::string_view txt, int ttl) {
+            // PowerDNS can't ask for any other platform, nor for names this long
+            if (platform < MIN_PLATFORM || platform > MAX_PLATFORM || domain.size() > LabelPool::MAX_LENGTH)
+            {
+                return;
+            }
+
+            encoded.resize(Base64Encoder::encodedLength(txt.size()));
+            Base64Encoder::encode(reinterpret_cast<const unsigned char*>(txt.data()), txt.size(), encoded.data());
+            // Stored in lowercase, so find() only has to fold the query's case
+            AsciiCase::lower(domain, lowered);
+            rows.push_back(Row{names.intern(lowered), platform, ttl, append(staging, encoded),
+                               static_cast<std::uint32_t>(encoded.size())});
+        });
+
+        // Stable, so the rows of one (domain, platform) stay in the order they were read
+        std::stable_sort(rows.begin(), rows.end(), [](const Row& left, const Row& right) {
+            return left.domain < right.domain || (left.domain == right.domain && left.platform < right.platform);
+        });
+        // Names that only differ in case are one domain here, while SQLite
+        // answers for whichever row it finds first. Keep the first one read.
+        const auto sameRecord = [](const Row& left, const Row& right) {
+            return left.domain == right.domain && left.platform == right.platform;
+        };
+        const auto duplicate = std::adjacent_find(rows.begin(), rows.end(), sameRecord);
+        if (duplicate != rows.end())
+        {
+            const auto example = fmt::format("platform {} of '{}'", duplicate->platform, names.get(duplicate->domain));
+            const auto kept = static_cast<std::size_t>(std::unique(rows.begin(), rows.end(), sameRecord) - rows.begin());
+            Logger::global().log(LogLevel::WARNING, LogCategory::REPOSITORY,
+                                 "Snapshot of '{}' left out {} records whose domain and platform repeat an earlier "
+                                 "one ignoring case, such as {}",
+                                 dbPath, rows.size() - kept, example);
+            rows.resize(kept);
+        }
+
+        std::vector<std::uint32_t> nameOffsets{};
+        nameOffsets.reserve(names.getCount());
+        for (const auto& row : rows)
+        {
+            if (nameOffsets.empty() || nameOffsets.back() != row.domain)
+            {
+                nameOffsets.push_back(row.domain);
+            }
+        }
+
+        // The strings are the interned names followed by the answers, grouped
+        // by domain in platform order. Domains are stored in the order of
+        // their perfect hash slots.
+        const auto table = PerfectHash::build(nameOffsets.size(), [&names, &nameOffsets](std::size_t index, std::uint64_t seed) {
+            return PerfectHash::hash(names.get(nameOffsets[index]), seed);
+        });
+        std::vector<Domain> domains(nameOffsets.size());
+        std::string strings = names.getBuffer();
+        strings.reserve(strings.size() + staging.size());
+        std::size_t row = 0;
+        for (std::size_t index = 0; index < nameOffsets.size(); ++index)
+        {
+            auto& domain = domains[table.slots[index]];
+            domain.fingerprint = PerfectHash::fingerprint(PerfectHash::hash(names.get(nameOffsets[index]), table.seed));
+            domain.nameOffset = nameOffsets[index];
+            domain.answerEnds[0] = static_cast<std::uint32_t>(strings.size());
+            for (int platform = MIN_PLATFORM; platform <= MAX_PLATFORM; ++platform)
+            {
+                const auto i = platform - MIN_PLATFORM;
+                domain.ttls[i] = NO_ANSWER;
+                if (row < rows.size() && rows[row].domain == nameOffsets[index] && rows[row].platform == platform)
+                {
+                    append(strings, std::string_view(staging.data() + rows[row].answerOffset, rows[row].answerLength));
+                    domain.ttls[i] = rows[row].ttl;
+                    ++row;
+                }
+                domain.answerEnds[i + 1] = static_cast<std::uint32_t>(strings.size());
+            }
+        }
+
+        const auto displacementsOffset = alignUp(sizeof(Header));
+        const auto domainsOffset = alignUp(displacementsOffset + table.displacements.size() * sizeof(std::uint32_t),
+                                           CACHE_LINE_SIZE);
+        const auto stringsOffset = domainsOffset + domains.size() * sizeof(Domain);
+        const auto size = stringsOffset + strings.size();
+
+        std::unique_ptr<Snapshot> snapshot(new Snapshot());
+        snapshot->m_buffer.resize(alignUp(size, CACHE_LINE_SIZE) / CACHE_LINE_SIZE);
+        auto* data = reinterpret_cast<char*>(snapshot->m_buffer.data());
+        std::memcpy(data + displacementsOffset, table.displacements.data(),
+                    table.displacements.size() * sizeof(std::uint32_t));
+        std::memcpy(data + domainsOffset, domains.data(), domains.size() * sizeof(Domain));
+        std::memcpy(data + stringsOffset, strings.data(), strings.size());
+
+        auto* header = reinterpret_cast<Header*>(data);
+        std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+        header->version = FORMAT_VERSION;
+        header->headerSize = sizeof(Header);
+        header->identity = identity;
+        header->recordCount = rows.size();
+        header->domainCount = domains.size();
+        header->hashSeed = table.seed;
+        header->bucketCount = table.displacements.size();
+        header->displacementsOffset = displacementsOffset;
+        header->domainsOffset = domainsOffset;
+        header->stringsOffset = stringsOffset;
+        header->stringsSize = strings.size();
+        header->checksum = checksum(data + sizeof(Header), size - sizeof(Header),
+                                    checksum(data, offsetof(Header, checksum)));
+
+        snapshot->m_data = data;
+        snapshot->m_size = size;
+        return snapshot;
+    }
+
+    std::unique_ptr<const Snapshot> Snapshot::load(const std::string& snapshotPath, const std::string& dbPath)
+    {
+        const int file = ::open(snapshotPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+        {
+            throw std::runtime_error(fmt::format("Error opening snapshot '{}': {}", snapshotPath, std::strerror(errno)));
+        }
+        struct stat status{};
+        if (::fstat(file, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(Header))
+        {
+            ::close(file);
+            throw std::runtime_error(fmt::format("Snapshot '{}' is too short", snapshotPath));
+        }
+
+        const auto size = static_cast<std::size_t>(status.st_size);
+        void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (mapped == MAP_FAILED)
+        {
+            throw std::runtime_error(fmt::format("Error mapping snapshot '{}': {}", snapshotPath, std::strerror(errno)));
+        }
+
+        std::unique_ptr<Snapshot> snapshot(new Snapshot());
+        snapshot->m_data = static_cast<const char*>(mapped);
+        snapshot->m_size = size;
+        snapshot->m_mapped = true;
+
+        snapshot->validate();
+        if (snapshot->getIdentity() != DatabaseIdentity::of(dbPath))
+        {
+            throw std::runtime_error(fmt::format("Snapshot '{}' was made from another version of '{}'",
+                                                 snapshotPath, dbPath));
+        }
+        return snapshot;
+    }
+
+    void Snapshot::save(const std::string& snapshotPath) const
+    {
+        // PowerDNS runs a co-process per backend, and they may all save at once:
+        // each writes its own file, so the one renamed into place is whole
+        const auto temporary = fmt::format("{}.{}.tmp", snapshotPath, ::getpid());
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(m_data, static_cast<std::streamsize>(m_size));
+            file.flush();
+            if (!file)
+            {
+                std::remove(temporary.c_str());
+                throw std::runtime_error(fmt::format("Error writing snapshot '{}'", temporary));
+            }
+        }
+        if (std::rename(temporary.c_str(), snapshotPath.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            throw std::runtime_error(fmt::format("Error replacing snapshot '{}'", snapshotPath));
+        }
+    }
+
+    bool Snapshot::find(std::string_view domain, int platform, std::string_view& answer, int& ttl) const
+    {
+        const auto& head = header();
+        if (platform < MIN_PLATFORM || platform > MAX_PLATFORM || head.domainCount == 0)
+        {
+            return false;
+        }
+
+        // One hash, one displacement and one domain. The fingerprint turns
+        // away nearly every unknown name before the name itself is read.
+        const auto hash = PerfectHash::hash(domain, head.hashSeed);
+        const auto slot = PerfectHash::slot(hash, static_cast<std::uint32_t>(head.domainCount),
+                                            reinterpret_cast<const std::uint32_t*>(m_data + head.displacementsOffset),
+                                            static_cast<std::uint32_t>(head.bucketCount));
+        const auto& found = domains()[slot];
+        const auto i = platform - MIN_PLATFORM;
+        if (found.fingerprint != PerfectHash::fingerprint(hash) || found.ttls[i] == NO_ANSWER)
+        {
+            return false;
+        }
+        const auto* text = strings();
+        if (!AsciiCase::equals(LabelPool::get(text, found.nameOffset), domain))
+        {
+            return false;
+        }
+
+        answer = std::string_view(text + found.answerEnds[i], found.answerEnds[i + 1] - found.answerEnds[i]);
+        ttl = found.ttls[i];
+        return true;
+    }
+
+    std::size_t Snapshot::getRecordCount() const
+    {
+        return static_cast<std::size_t>(header().recordCount);
+    }
+
+    std::size_t Snapshot::getDomainCount() const
+    {
+        return static_cast<std::size_t>(header().domainCount);
+    }
+
+    const DatabaseIdentity& Snapshot::getIdentity() const
+    {
+        return header().identity;
+    }
+
+    const Snapshot::Header& Snapshot::header() const
+    {
+        return *reinterpret_cast<const Header*>(m_data);
+    }
+
+    const Snapshot::Domain* Snapshot::domains() const
+    {
+        static_assert(sizeof(Domain) == CACHE_LINE_SIZE, "A domain must fill one cache line");
+        return reinterpret_cast<const Domain*>(m_data + header().domainsOffset);
+    }
+
+    const char* Snapshot::strings() const
+    {
+        return m_data + header().stringsOffset;
+    }
+
+    void Snapshot::validate() const
+    {
+        const auto& head = header();
+        if (std::memcmp(head.magic, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            throw std::runtime_error("Not a snapshot");
+        }
+        if (head.version != FORMAT_VERSION || head.headerSize != sizeof(Header))
+        {
+            throw std::runtime_error(fmt::format("Snapshot format {} is not {}", head.version, FORMAT_VERSION));
+        }
+        if (head.domainCount >= std::numeric_limits<std::uint32_t>::max() ||
+            head.bucketCount != PerfectHash::bucketCount(head.domainCount) ||
+            head.displacementsOffset != alignUp(sizeof(Header)) ||
+            head.domainsOffset != alignUp(head.displacementsOffset + head.bucketCount * sizeof(std::uint32_t),
+                                          CACHE_LINE_SIZE) ||
+            head.domainsOffset > m_size ||
+            head.domainCount > (m_size - head.domainsOffset) / sizeof(Domain) ||
+            head.stringsOffset != head.domainsOffset + head.domainCount * sizeof(Domain) ||
+            head.stringsOffset > m_size ||
+            head.stringsSize != m_size - head.stringsOffset)
+        {
+            throw std::runtime_error("Snapshot sections don't match its size");
+        }
+        if (checksum(m_data + sizeof(Header), m_size - sizeof(Header),
+                     checksum(m_data, offsetof(Header, checksum))) != head.checksum)
+        {
+            throw std::runtime_error("Snapshot checksum mismatch");
+        }
+
+        // Checked once here so find() never has to
+        const auto* first = domains();
+        std::uint64_t records = 0;
+        for (std::size_t i = 0; i < head.domainCount; ++i)
+        {
+            const auto& domain = first[i];
+            bool inside = domain.nameOffset < head.stringsSize &&
+                          static_cast<std::uint64_t>(domain.nameOffset) + 1 + LabelPool::get(strings(), domain.nameOffset).size() <= head.stringsSize &&
+                          domain.answerEnds[PLATFORMS] <= head.stringsSize;
+            for (std::size_t platform = 0; platform < PLATFORMS; ++platform)
+            {
+                inside = inside && domain.answerEnds[platform] <= domain.answerEnds[platform + 1];
+                records += domain.ttls[platform] != NO_ANSWER;
+            }
+            if (!inside)
+            {
+                throw std::runtime_error(fmt::format("Snapshot domain {} points outside the snapshot", i));
+            }
+        }
+        if (records != head.recordCount)
+        {
+            throw std::runtime_error("Snapshot record count doesn't match its domains");
+        }
+    }
+
+    std::uint64_t Snapshot::checksum(const char* data, std::size_t size, std::uint64_t seed)
+    {
+        // Four independent multiply-rotate lanes over 8-byte words, in the
+        // style of xxHash64: several GB/s, so checking a snapshot on load costs
+        // about as much as reading it
+        constexpr std::uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+        constexpr std::uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+        std::uint64_t lanes[4] = {seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1};
+
+        const auto round = [](std::uint64_t lane, std::uint64_t word) {
+            return rotateLeft(lane + word * PRIME2, 31) * PRIME1;
+        };
+
+        std::size_t position = 0;
+        for (; position + 32 <= size; position += 32)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + position + lane * 8, sizeof(word));
+                lanes[lane] = round(lanes[lane], word);
+            }
+        }
+
+        std::uint64_t hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+                             rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18) + size;
+        for (; position < size; ++position)
+        {
+            hash = rotateLeft(hash ^ (static_cast<unsigned char>(data[position]) * PRIME1), 11) * PRIME2;
+        }
+
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        return hash;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "repository.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppbackend {
+    struct SnapshotOptions {
+        // Answer lookups from a snapshot of the database instead of SQLite
+        bool enabled = false;
+        // Where the snapshot is kept; "<database path>.snapshot" when empty
+        std::string path{};
+    };
+
+    // What a snapshot was made from. Any write to the database changes at least
+    // one of these: the change counter in the header (offset 24) is bumped by
+    // every transaction in rollback journal mode, and WAL mode writes go to the
+    // -wal file first.
+    struct DatabaseIdentity {
+        std::uint64_t size = 0;
+        std::int64_t modifiedNs = 0;
+        std::uint32_t changeCounter = 0;
+        std::uint64_t walSize = 0;
+        std::int64_t walModifiedNs = 0;
+
+        // Throws std::runtime_error when the database file can't be read
+        static DatabaseIdentity of(const std::string& dbPath);
+
+        bool operator==(const DatabaseIdentity& other) const;
+        bool operator!=(const DatabaseIdentity& other) const { return !(*this == other); }
+    };
+
+    // Every TXT record of a database with its answer already base64 encoded,
+    // in one read-only block: a header, a minimal perfect hash over the domain
+    // names, one cache line per domain in slot order holding the answer
+    // offsets and ttls of all its platforms, and the strings they point into:
+    // the names as a LabelPool buffer, then the answers. The same bytes are
+    // the file format, so load() only maps the file and checks it. Safe to
+    // share between threads.
+    class Snapshot {
+    public:
+        static constexpr std::uint32_t FORMAT_VERSION = 6;
+        // The platforms PowerDNS can ask for; rows of any other are left out
+        static constexpr int MIN_PLATFORM = 1;
+        static constexpr int MAX_PLATFORM = 5;
+        static constexpr std::size_t PLATFORMS = MAX_PLATFORM - MIN_PLATFORM + 1;
+        static constexpr std::size_t CACHE_LINE_SIZE = 64;
+        // The ttl of a record whose row has none of its own
+        static constexpr int NO_TTL = -1;
+
+        ~Snapshot();
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        // Maps the snapshot at snapshotPath when it was made from the database
+        // as it is now. Otherwise builds a new one from repository and writes
+        // it to snapshotPath for the next start; when that fails the snapshot
+        // is served from memory. Throws when the database can't be read.
+        static std::unique_ptr<const Snapshot> open(const std::string& dbPath,
+                                                    const Repository& repository,
+                                                    const std::string& snapshotPath);
+        // Reads every record of repository. Of records whose (domain, platform)
+        // only differ in case, keeps the first read, as SQLite lookups answer
+        // with the first in Repository::RECORD_ORDER, and logs a warning. Throws
+        // std::runtime_error when the records can't be read or the strings
+        // don't fit in 4 GiB.
+        static std::unique_ptr<const Snapshot> build(const std::string& dbPath, const Repository& repository);
+        // Throws std::runtime_error when snapshotPath can't be mapped, is not a
+        // valid snapshot, or was made from another version of dbPath
+        static std::unique_ptr<const Snapshot> load(const std::string& snapshotPath, const std::string& dbPath);
+        // Replaces the file at snapshotPath in one rename of a temporary file named
+        // after the process. Throws std::runtime_error.
+        void save(const std::string& snapshotPath) const;
+
+        // The base64 answer and ttl (or NO_TTL) of a record. Domains match
+        // regardless of ASCII case, without copying domain.
+        [[nodiscard]] bool find(std::string_view domain, int platform, std::string_view& answer, int& ttl) const;
+
+        [[nodiscard]] std::size_t getRecordCount() const;
+        [[nodiscard]] std::size_t getDomainCount() const;
+        // Bytes in the block, which is also the file size
+        [[nodiscard]] std::size_t getSize() const { return m_size; }
+        [[nodiscard]] bool isMapped() const { return m_mapped; }
+        [[nodiscard]] const DatabaseIdentity& getIdentity() const;
+
+        static std::string defaultPath(const std::string& dbPath) { return dbPath + ".snapshot"; }
+    private:
+        struct Header;
+        struct Domain;
+        struct alignas(CACHE_LINE_SIZE) CacheLine {
+            char bytes[CACHE_LINE_SIZE];
+        };
+
+        const char* m_data = nullptr;
+        std::size_t m_size = 0;
+        bool m_mapped = false;
+        // Holds the block when it was built rather than mapped
+        std::vector<CacheLine> m_buffer{};
+
+        Snapshot() = default;
+
+        [[nodiscard]] const Header& header() const;
+        [[nodiscard]] const Domain* domains() const;
+        [[nodiscard]] const char* strings() const;
+        // Throws std::runtime_error naming the first problem
+        void validate() const;
+
+        static std::uint64_t checksum(const char* data, std::size_t size, std::uint64_t seed = 0);
+    };
+}
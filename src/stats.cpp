@@ -0,0 +1,254 @@
+#include "stats.h"
+#include "logger.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace cppbackend {
+    void LatencyHistogram::record(std::chrono::nanoseconds elapsed)
+    {
+        const auto nanoseconds = static_cast<std::uint64_t>(std::max<std::int64_t>(elapsed.count(), 0));
+        m_buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::chrono::nanoseconds LatencyHistogram::getSum() const
+    {
+        return std::chrono::nanoseconds(static_cast<std::int64_t>(m_sum.load(std::memory_order_relaxed)));
+    }
+
+    std::chrono::nanoseconds LatencyHistogram::getQuantile(double quantile) const
+    {
+        // Buckets are read one at a time while others may still record, so
+        // take the total from the same pass rather than from m_count
+        std::array<std::uint64_t, BUCKETS> counts{};
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0)
+        {
+            return std::chrono::nanoseconds{0};
+        }
+
+        const auto rank = std::max<std::uint64_t>(
+                1, static_cast<std::uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * static_cast<double>(total))));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                return std::chrono::nanoseconds(static_cast<std::int64_t>(bucketLowerBound(i)));
+            }
+        }
+        return std::chrono::nanoseconds(static_cast<std::int64_t>(bucketLowerBound(BUCKETS - 1)));
+    }
+
+    std::size_t LatencyHistogram::bucketIndex(std::uint64_t nanoseconds)
+    {
+        if (nanoseconds < SUB_BUCKETS)
+        {
+            return static_cast<std::size_t>(nanoseconds);
+        }
+        const auto highestBit = static_cast<unsigned>(63 - __builtin_clzll(nanoseconds));
+        if (highestBit >= MAX_BITS)
+        {
+            return BUCKETS - 1;
+        }
+        const auto shift = highestBit - SUB_BUCKET_BITS;
+        return static_cast<std::size_t>((shift + 1) * SUB_BUCKETS + ((nanoseconds >> shift) & (SUB_BUCKETS - 1)));
+    }
+
+    std::uint64_t LatencyHistogram::bucketLowerBound(std::size_t index)
+    {
+        if (index < SUB_BUCKETS)
+        {
+            return index;
+        }
+        const auto shift = index / SUB_BUCKETS - 1;
+        return (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    }
+
+    void Stats::recordQuery(int abiVersion, QueryClass queryClass, QueryResult result, std::chrono::nanoseconds elapsed)
+    {
+        m_queryLatency[static_cast<std::size_t>(queryClass)].record(elapsed);
+        const auto abi = static_cast<std::size_t>(std::clamp(abiVersion, 0, MAX_ABI_VERSION));
+        m_queries[abi][static_cast<std::size_t>(result)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Stats::recordOperation(Operation operation, std::chrono::nanoseconds elapsed)
+    {
+        m_operationLatency[static_cast<std::size_t>(operation)].record(elapsed);
+    }
+
+    void Stats::setPageCache(std::int64_t hits, std::int64_t misses)
+    {
+        m_pageCacheHits.store(hits, std::memory_order_relaxed);
+        m_pageCacheMisses.store(misses, std::memory_order_relaxed);
+    }
+
+    void Stats::recordAnswerCache(CacheEvent event)
+    {
+        m_answerCache[static_cast<std::size_t>(event)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Stats::getAnswerCacheCount(CacheEvent event) const
+    {
+        return m_answerCache[static_cast<std::size_t>(event)].load(std::memory_order_relaxed);
+    }
+
+    double Stats::getAnswerCacheHitRatio() const
+    {
+        const auto hits = getAnswerCacheCount(CacheEvent::HIT);
+        const auto lookups = hits + getAnswerCacheCount(CacheEvent::MISS);
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+
+    const LatencyHistogram& Stats::getQueryLatency(QueryClass queryClass) const
+    {
+        return m_queryLatency[static_cast<std::size_t>(queryClass)];
+    }
+
+    const LatencyHistogram& Stats::getOperationLatency(Operation operation) const
+    {
+        return m_operationLatency[static_cast<std::size_t>(operation)];
+    }
+
+    std::uint64_t Stats::getQueryCount(int abiVersion, QueryResult result) const
+    {
+        const auto abi = static_cast<std::size_t>(std::clamp(abiVersion, 0, MAX_ABI_VERSION));
+        return m_queries[abi][static_cast<std::size_t>(result)].load(std::memory_order_relaxed);
+    }
+
+    std::string Stats::toPrometheus() const
+    {
+        static constexpr double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+        std::string text{};
+        auto out = std::back_inserter(text);
+
+        const auto summary = [&out](const char* name, const char* label, const char* value,
+                                    const LatencyHistogram& histogram) {
+            for (const auto quantile : QUANTILES)
+            {
+                fmt::format_to(out, "{}{{{}=\"{}\",quantile=\"{}\"}} {:.9f}\n", name, label, value, quantile,
+                               std::chrono::duration<double>(histogram.getQuantile(quantile)).count());
+            }
+            fmt::format_to(out, "{}_sum{{{}=\"{}\"}} {:.9f}\n", name, label, value,
+                           std::chrono::duration<double>(histogram.getSum()).count());
+            fmt::format_to(out, "{}_count{{{}=\"{}\"}} {}\n", name, label, value, histogram.getCount());
+        };
+
+        text += "# HELP cppbackend_query_duration_seconds Time to answer one pipe query, by query class\n"
+                "# TYPE cppbackend_query_duration_seconds summary\n";
+        for (std::size_t i = 0; i < m_queryLatency.size(); ++i)
+        {
+            summary("cppbackend_query_duration_seconds", "class", toString(static_cast<QueryClass>(i)),
+                    m_queryLatency[i]);
+        }
+
+        text += "# HELP cppbackend_operation_duration_seconds Time spent in one step of a query\n"
+                "# TYPE cppbackend_operation_duration_seconds summary\n";
+        for (std::size_t i = 0; i < m_operationLatency.size(); ++i)
+        {
+            summary("cppbackend_operation_duration_seconds", "operation", toString(static_cast<Operation>(i)),
+                    m_operationLatency[i]);
+        }
+
+        text += "# HELP cppbackend_queries_total Pipe queries answered, by ABI version and final response\n"
+                "# TYPE cppbackend_queries_total counter\n";
+        for (int abi = 1; abi <= MAX_ABI_VERSION; ++abi)
+        {
+            for (std::size_t result = 0; result < static_cast<std::size_t>(QueryResult::COUNT); ++result)
+            {
+                fmt::format_to(out, "cppbackend_queries_total{{abi=\"{}\",result=\"{}\"}} {}\n",
+                               abi, toString(static_cast<QueryResult>(result)),
+                               getQueryCount(abi, static_cast<QueryResult>(result)));
+            }
+        }
+
+        text += "# HELP cppbackend_page_cache_hits_total SQLite page cache hits on the query connection\n"
+                "# TYPE cppbackend_page_cache_hits_total counter\n";
+        fmt::format_to(out, "cppbackend_page_cache_hits_total {}\n", getPageCacheHits());
+        text += "# HELP cppbackend_page_cache_misses_total SQLite page cache misses on the query connection\n"
+                "# TYPE cppbackend_page_cache_misses_total counter\n";
+        fmt::format_to(out, "cppbackend_page_cache_misses_total {}\n", getPageCacheMisses());
+
+        text += "# HELP cppbackend_answer_cache_events_total Answer cache hits, misses, evictions and expiries\n"
+                "# TYPE cppbackend_answer_cache_events_total counter\n";
+        for (std::size_t event = 0; event < m_answerCache.size(); ++event)
+        {
+            fmt::format_to(out, "cppbackend_answer_cache_events_total{{event=\"{}\"}} {}\n",
+                           toString(static_cast<CacheEvent>(event)), m_answerCache[event].load(std::memory_order_relaxed));
+        }
+        text += "# HELP cppbackend_answer_cache_hit_ratio Answer cache hits over lookups since the start\n"
+                "# TYPE cppbackend_answer_cache_hit_ratio gauge\n";
+        fmt::format_to(out, "cppbackend_answer_cache_hit_ratio {:.6f}\n", getAnswerCacheHitRatio());
+
+        const auto& logger = Logger::global();
+        text += "# HELP cppbackend_log_messages_dropped_total Log messages lost to a full ring\n"
+                "# TYPE cppbackend_log_messages_dropped_total counter\n";
+        fmt::format_to(out, "cppbackend_log_messages_dropped_total {}\n", logger.getDropped());
+        text += "# HELP cppbackend_log_messages_suppressed_total Log messages held back by the rate limit\n"
+                "# TYPE cppbackend_log_messages_suppressed_total counter\n";
+        fmt::format_to(out, "cppbackend_log_messages_suppressed_total {}\n", logger.getSuppressed());
+
+        return text;
+    }
+
+    const char* Stats::toString(QueryClass queryClass)
+    {
+        switch (queryClass)
+        {
+            case QueryClass::HIT: return "hit";
+            case QueryClass::MISS: return "miss";
+            case QueryClass::EPOCH: return "oc";
+            case QueryClass::MALFORMED: return "malformed";
+            case QueryClass::COUNT: break;
+        }
+        return "unknown";
+    }
+
+    const char* Stats::toString(QueryResult result)
+    {
+        switch (result)
+        {
+            case QueryResult::DATA: return "data";
+            case QueryResult::END: return "end";
+            case QueryResult::FAIL: return "fail";
+            case QueryResult::COUNT: break;
+        }
+        return "unknown";
+    }
+
+    const char* Stats::toString(Operation operation)
+    {
+        switch (operation)
+        {
+            case Operation::LOOKUP: return "lookup";
+            case Operation::ENCRYPT: return "encrypt";
+            case Operation::COUNT: break;
+        }
+        return "unknown";
+    }
+
+    const char* Stats::toString(CacheEvent event)
+    {
+        switch (event)
+        {
+            case CacheEvent::HIT: return "hit";
+            case CacheEvent::MISS: return "miss";
+            case CacheEvent::EVICTION: return "eviction";
+            case CacheEvent::EXPIRY: return "expiry";
+            case CacheEvent::COUNT: break;
+        }
+        return "unknown";
+    }
+}
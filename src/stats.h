@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cppbackend {
+    // Latency histogram with HDR-style log-linear buckets: every power of two
+    // is split into SUB_BUCKETS equal buckets, so any recorded value is known
+    // to within 1/SUB_BUCKETS (about 6%) from 1 ns up to about 18 minutes.
+    // record() is a couple of relaxed atomic adds and safe from any thread.
+    class LatencyHistogram {
+    public:
+        static constexpr unsigned SUB_BUCKET_BITS = 4;
+        static constexpr std::uint64_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+        // Values at or above 2^MAX_BITS ns land in the last bucket
+        static constexpr unsigned MAX_BITS = 40;
+        static constexpr std::size_t BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        void record(std::chrono::nanoseconds elapsed);
+
+        [[nodiscard]] std::uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+        [[nodiscard]] std::chrono::nanoseconds getSum() const;
+        // The lower bound of the bucket holding the value at this quantile, 0 when empty
+        [[nodiscard]] std::chrono::nanoseconds getQuantile(double quantile) const;
+
+        static std::size_t bucketIndex(std::uint64_t nanoseconds);
+        static std::uint64_t bucketLowerBound(std::size_t index);
+    private:
+        std::array<std::atomic<std::uint64_t>, BUCKETS> m_buckets{};
+        std::atomic<std::uint64_t> m_count{0};
+        std::atomic<std::uint64_t> m_sum{0};
+    };
+
+    enum class QueryClass { HIT = 0, MISS, EPOCH, MALFORMED, COUNT };
+    enum class QueryResult { DATA = 0, END, FAIL, COUNT };
+    enum class Operation { LOOKUP = 0, ENCRYPT, COUNT };
+    // Lookups that found a live answer or not, and answers dropped for room or age
+    enum class CacheEvent { HIT = 0, MISS, EVICTION, EXPIRY, COUNT };
+
+    // Everything the backend measures about itself. Recording never locks.
+    class Stats {
+    public:
+        static constexpr int MAX_ABI_VERSION = 3;
+
+        // One pipe query, from reading its line to writing its last response
+        void recordQuery(int abiVersion, QueryClass queryClass, QueryResult result, std::chrono::nanoseconds elapsed);
+        // One step inside performQuery
+        void recordOperation(Operation operation, std::chrono::nanoseconds elapsed);
+
+        // Page cache counters of the connection queries run on, as of the
+        // last call. SQLite can't be asked from another thread, so the query
+        // thread copies them here now and then.
+        void setPageCache(std::int64_t hits, std::int64_t misses);
+        [[nodiscard]] std::int64_t getPageCacheHits() const { return m_pageCacheHits.load(std::memory_order_relaxed); }
+        [[nodiscard]] std::int64_t getPageCacheMisses() const { return m_pageCacheMisses.load(std::memory_order_relaxed); }
+
+        // One AnswerCache event
+        void recordAnswerCache(CacheEvent event);
+        [[nodiscard]] std::uint64_t getAnswerCacheCount(CacheEvent event) const;
+        // Hits over lookups, 0 before the first lookup
+        [[nodiscard]] double getAnswerCacheHitRatio() const;
+
+        [[nodiscard]] const LatencyHistogram& getQueryLatency(QueryClass queryClass) const;
+        [[nodiscard]] const LatencyHistogram& getOperationLatency(Operation operation) const;
+        [[nodiscard]] std::uint64_t getQueryCount(int abiVersion, QueryResult result) const;
+
+        // Prometheus text exposition format, version 0.0.4
+        [[nodiscard]] std::string toPrometheus() const;
+
+        static const char* toString(QueryClass queryClass);
+        static const char* toString(QueryResult result);
+        static const char* toString(Operation operation);
+        static const char* toString(CacheEvent event);
+    private:
+        std::array<LatencyHistogram, static_cast<std::size_t>(QueryClass::COUNT)> m_queryLatency{};
+        std::array<LatencyHistogram, static_cast<std::size_t>(Operation::COUNT)> m_operationLatency{};
+        // Index 0 counts queries before a handshake, which should never happen
+        std::array<std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(QueryResult::COUNT)>,
+                   MAX_ABI_VERSION + 1> m_queries{};
+        std::atomic<std::int64_t> m_pageCacheHits{0};
+        std::atomic<std::int64_t> m_pageCacheMisses{0};
+        std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(CacheEvent::COUNT)> m_answerCache{};
+    };
+
+    // Times a scope into Stats::recordOperation
+    class OperationTimer {
+    public:
+        OperationTimer(Stats& stats, Operation operation)
+            : m_stats{stats},
+              m_operation{operation},
+              m_start{std::chrono::steady_clock::now()}
+        {}
+        ~OperationTimer()
+        {
+            m_stats.recordOperation(m_operation, std::chrono::steady_clock::now() - m_start);
+        }
+
+        OperationTimer(const OperationTimer&) = delete;
+        OperationTimer& operator=(const OperationTimer&) = delete;
+    private:
+        Stats& m_stats;
+        const Operation m_operation;
+        const std::chrono::steady_clock::time_point m_start;
+    };
+}
@@ -0,0 +1,97 @@
+#include "statsserver.h"
+#include "logger.h"
+
+#include "fmt/format.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace cppbackend {
+    StatsServer::StatsServer(std::string path, Renderer render)
+        : m_path{std::move(path)},
+          m_render{std::move(render)}
+    {
+        sockaddr_un address{};
+        if (m_path.empty() || m_path.size() >= sizeof(address.sun_path))
+        {
+            throw std::runtime_error(fmt::format("Stats socket path '{}' is empty or too long", m_path));
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, m_path.c_str(), m_path.size() + 1);
+
+        m_socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_socket < 0)
+        {
+            throw std::runtime_error(fmt::format("Unable to create the stats socket: {}", std::strerror(errno)));
+        }
+
+        ::unlink(m_path.c_str());
+        if (::bind(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(m_socket, SOMAXCONN) != 0)
+        {
+            const auto error = errno;
+            ::close(m_socket);
+            throw std::runtime_error(fmt::format("Unable to listen on stats socket '{}': {}",
+                                                 m_path, std::strerror(error)));
+        }
+
+        m_thread = std::thread(&StatsServer::serve, this);
+    }
+
+    StatsServer::~StatsServer()
+    {
+        m_stopping.store(true, std::memory_order_relaxed);
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        ::close(m_socket);
+        ::unlink(m_path.c_str());
+    }
+
+    void StatsServer::serve()
+    {
+        pollfd listening{m_socket, POLLIN, 0};
+        while (!m_stopping.load(std::memory_order_relaxed))
+        {
+            if (::poll(&listening, 1, POLL_INTERVAL_MS) <= 0)
+            {
+                continue;
+            }
+
+            const int client = ::accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0)
+            {
+                continue;
+            }
+
+            try {
+                const auto page = m_render();
+                std::size_t written = 0;
+                while (written < page.size())
+                {
+                    const auto result = ::send(client, page.data() + written, page.size() - written, MSG_NOSIGNAL);
+                    if (result < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (result <= 0)
+                    {
+                        break;
+                    }
+                    written += static_cast<std::size_t>(result);
+                }
+            } catch (std::exception& err) {
+                Logger::global().log(LogLevel::ERROR, LogCategory::CONTROL, "Unable to render stats: {}", err.what());
+            }
+            ::close(client);
+        }
+    }
+}
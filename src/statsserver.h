@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace cppbackend {
+    // Serves a text page on a unix domain socket: every connection gets one
+    // render() and is closed, so `socat - UNIX-CONNECT:PATH` or a Prometheus
+    // exporter can scrape it. Connections are handled on a thread of their own,
+    // away from the query path.
+    class StatsServer {
+    public:
+        using Renderer = std::function<std::string()>;
+
+        // Replaces a stale socket left at path. Throws std::runtime_error if the
+        // socket can't be created.
+        StatsServer(std::string path, Renderer render);
+        ~StatsServer();
+
+        StatsServer(const StatsServer&) = delete;
+        StatsServer& operator=(const StatsServer&) = delete;
+
+        [[nodiscard]] const std::string& getPath() const { return m_path; }
+    private:
+        // How often the accept loop checks whether it should stop
+        static constexpr int POLL_INTERVAL_MS = 200;
+
+        const std::string m_path;
+        const Renderer m_render;
+        int m_socket = -1;
+        std::atomic<bool> m_stopping{false};
+        std::thread m_thread;
+
+        void serve();
+    };
+}
@@ -0,0 +1,204 @@
+#include "zonetable.h"
+#include "asciicase.h"
+#include "perfecthash.h"
+
+#include "fmt/format.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace cppbackend {
+    namespace {
+        constexpr std::size_t INITIAL_EDGES = 16;
+
+        // A name of non-empty labels of at most 63 bytes, or nothing
+        bool isValidName(std::string_view name)
+        {
+            if (name.empty() || name.size() > ZoneTable::MAX_NAME_LENGTH)
+            {
+                return false;
+            }
+            std::size_t start = 0;
+            while (true)
+            {
+                const auto dot = name.find('.', start);
+                const auto length = (dot == std::string_view::npos ? name.size() : dot) - start;
+                if (length == 0 || length > ZoneTable::MAX_LABEL_LENGTH)
+                {
+                    return false;
+                }
+                if (dot == std::string_view::npos)
+                {
+                    return true;
+                }
+                start = dot + 1;
+            }
+        }
+    }
+
+    ZoneTable::ZoneTable()
+        : m_edges(INITIAL_EDGES, Edge{ROOT, 0, ROOT}),
+          m_values{NO_ZONE}
+    {
+    }
+
+    void ZoneTable::add(std::string_view zone, std::uint32_t value)
+    {
+        // "testnet." names the same zone as "testnet"
+        if (!zone.empty() && zone.back() == '.')
+        {
+            zone.remove_suffix(1);
+        }
+        if (!isValidName(zone))
+        {
+            throw std::invalid_argument(fmt::format("'{}' is not a zone name", zone));
+        }
+        if (value == NO_ZONE)
+        {
+            throw std::invalid_argument(fmt::format("Zone '{}' needs a value other than NO_ZONE", zone));
+        }
+
+        auto node = ROOT;
+        std::string lowered{};
+        for (auto end = zone.size();;)
+        {
+            const auto dot = zone.rfind('.', end - 1);
+            const auto start = dot == std::string_view::npos ? 0 : dot + 1;
+            const auto label = zone.substr(start, end - start);
+
+            if ((m_edgeCount + 1) * 2 > m_edges.size())
+            {
+                grow();
+            }
+            auto& edge = m_edges[findEdge(node, label)];
+            if (edge.child == ROOT)
+            {
+                AsciiCase::lower(label, lowered);
+                edge = Edge{node, m_labels.intern(lowered), static_cast<std::uint32_t>(m_values.size())};
+                m_values.push_back(NO_ZONE);
+                ++m_edgeCount;
+            }
+            node = edge.child;
+
+            if (dot == std::string_view::npos)
+            {
+                break;
+            }
+            end = dot;
+        }
+
+        if (m_values[node] != NO_ZONE)
+        {
+            throw std::invalid_argument(fmt::format("Zone '{}' is listed more than once", zone));
+        }
+        m_values[node] = value;
+        ++m_zoneCount;
+    }
+
+    ZoneTable::Match ZoneTable::match(std::string_view qname, std::size_t minPrefixLength) const
+    {
+        Match best{};
+        auto node = ROOT;
+        for (auto end = qname.size(); end > 0;)
+        {
+            const auto dot = qname.rfind('.', end - 1);
+            const auto start = dot == std::string_view::npos ? 0 : dot + 1;
+            if ((dot == std::string_view::npos ? 0 : dot) < minPrefixLength)
+            {
+                // Any zone from here on leaves even less in front
+                break;
+            }
+
+            const auto& edge = m_edges[findEdge(node, qname.substr(start, end - start))];
+            if (edge.child == ROOT)
+            {
+                break;
+            }
+            node = edge.child;
+            if (m_values[node] != NO_ZONE)
+            {
+                best.value = m_values[node];
+                best.prefixLength = dot == std::string_view::npos ? 0 : dot;
+            }
+
+            if (dot == std::string_view::npos)
+            {
+                break;
+            }
+            end = dot;
+        }
+        return best;
+    }
+
+    std::size_t ZoneTable::findEdge(std::uint32_t parent, std::string_view label) const
+    {
+        // Seeding with the parent spreads the same label under different
+        // zones, "www" say, over different slots
+        const auto mask = m_edges.size() - 1;
+        for (auto slot = static_cast<std::size_t>(PerfectHash::hash(label, parent)) & mask;; slot = (slot + 1) & mask)
+        {
+            const auto& edge = m_edges[slot];
+            if (edge.child == ROOT ||
+                (edge.parent == parent && AsciiCase::equals(m_labels.get(edge.label), label)))
+            {
+                return slot;
+            }
+        }
+    }
+
+    void ZoneTable::grow()
+    {
+        const auto previous = std::move(m_edges);
+        m_edges.assign(previous.size() * 2, Edge{ROOT, 0, ROOT});
+        for (const auto& edge : previous)
+        {
+            if (edge.child != ROOT)
+            {
+                m_edges[findEdge(edge.parent, m_labels.get(edge.label))] = edge;
+            }
+        }
+    }
+
+    Zone ZoneTable::parseZone(const std::string& zone)
+    {
+        const auto colon = zone.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == zone.size())
+        {
+            throw std::invalid_argument(fmt::format("Expected 'zone:handler', received '{}'", zone));
+        }
+        return Zone{zone.substr(0, colon), zone.substr(colon + 1)};
+    }
+
+    std::vector<Zone> ZoneTable::readFile(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error(fmt::format("Error opening zone file '{}'", path));
+        }
+
+        std::vector<Zone> zones{};
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            ++lineNumber;
+            std::istringstream words(line);
+            std::string name{};
+            std::string handler{};
+            std::string rest{};
+            if (!(words >> name) || name[0] == '#')
+            {
+                continue;
+            }
+            if (!(words >> handler) || (words >> rest))
+            {
+                throw std::invalid_argument(fmt::format("{}:{}: expected 'zone handler'", path, lineNumber));
+            }
+            zones.push_back(Zone{name, handler, fmt::format("{}:{}", path, lineNumber)});
+        }
+
+        return zones;
+    }
+}
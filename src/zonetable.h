@@ -0,0 +1,93 @@
+#pragma once
+
+#include "labelpool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppbackend {
+    struct Zone {
+        std::string name;
+        // The AnswerHandlerRegistry name of what answers its qnames
+        std::string handler;
+        // "path:line" for zones read from a file, to point errors at; else empty
+        std::string source{};
+    };
+
+    // The zones served; DEFAULT_ZONES when neither is set
+    struct ZoneOptions {
+        // Lines of "zone handler"
+        std::string file{};
+        // Zones from the command line, served besides those in file
+        std::vector<Zone> zones{};
+    };
+
+    // Zone names compiled into a trie over their labels, last label first, so
+    // the longest zone a qname ends in is found walking its labels once from
+    // the right, however many zones there are. The edges of every node share
+    // one open-addressing table keyed by (node, label); labels are kept
+    // lowercased in a LabelPool and match regardless of ASCII case.
+    class ZoneTable {
+    public:
+        static constexpr std::uint32_t NO_ZONE = 0xFFFFFFFF;
+        // RFC 1035 limits
+        static constexpr std::size_t MAX_LABEL_LENGTH = 63;
+        static constexpr std::size_t MAX_NAME_LENGTH = 253;
+
+        static inline std::vector<Zone> const DEFAULT_ZONES = {
+                {"testnet", "txt"},
+                {"oc.testnet", "epoch"}};
+
+        struct Match {
+            // What add() was given for the zone, NO_ZONE when there is none
+            std::uint32_t value = NO_ZONE;
+            // Bytes of the qname in front of the zone, not counting the dot
+            // between them; 0 when the qname is the zone itself
+            std::size_t prefixLength = 0;
+
+            explicit operator bool() const { return value != NO_ZONE; }
+        };
+
+        ZoneTable();
+
+        // Throws std::invalid_argument when zone is not a valid name or was
+        // added before, ignoring case
+        void add(std::string_view zone, std::uint32_t value);
+        // The longest zone qname is in or equal to that leaves at least
+        // minPrefixLength bytes of qname in front of it
+        [[nodiscard]] Match match(std::string_view qname, std::size_t minPrefixLength = 0) const;
+
+        [[nodiscard]] std::size_t getZoneCount() const { return m_zoneCount; }
+
+        // "NAME:HANDLER", as given with --zone. Throws std::invalid_argument.
+        static Zone parseZone(const std::string& zone);
+        // Lines of "zone handler", '#' starting a comment line. Throws
+        // std::runtime_error when the file can't be read and
+        // std::invalid_argument naming the line that can't be parsed.
+        static std::vector<Zone> readFile(const std::string& path);
+    private:
+        static constexpr std::uint32_t ROOT = 0;
+
+        struct Edge {
+            std::uint32_t parent;
+            // Offset in m_labels
+            std::uint32_t label;
+            // ROOT for an empty slot, since the root is no node's child
+            std::uint32_t child;
+        };
+
+        LabelPool m_labels{};
+        // Kept at most half full
+        std::vector<Edge> m_edges{};
+        std::size_t m_edgeCount = 0;
+        // Per node, the value of the zone ending there or NO_ZONE
+        std::vector<std::uint32_t> m_values{};
+        std::size_t m_zoneCount = 0;
+
+        [[nodiscard]] std::size_t findEdge(std::uint32_t parent, std::string_view label) const;
+        void grow();
+    };
+}
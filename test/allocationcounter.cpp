@@ -0,0 +1,114 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<std::size_t> allocations{0};
+    std::atomic<std::size_t> bytes{0};
+
+    void* countedAllocate(std::size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+
+        // malloc(0) may legitimately return nullptr, operator new may not
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* countedAllocateAligned(std::size_t size, std::align_val_t alignment)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+
+        const auto align = static_cast<std::size_t>(alignment);
+        // aligned_alloc requires the size to be a multiple of the alignment
+        const auto rounded = ((size == 0 ? 1 : size) + align - 1) / align * align;
+        return std::aligned_alloc(align, rounded);
+    }
+}
+
+AllocationCounter::AllocationCounter()
+{
+    reset();
+}
+
+void AllocationCounter::reset()
+{
+    m_startAllocations = allocations.load(std::memory_order_relaxed);
+    m_startBytes = bytes.load(std::memory_order_relaxed);
+}
+
+std::size_t AllocationCounter::getAllocations() const
+{
+    return allocations.load(std::memory_order_relaxed) - m_startAllocations;
+}
+
+std::size_t AllocationCounter::getBytes() const
+{
+    return bytes.load(std::memory_order_relaxed) - m_startBytes;
+}
+
+void* operator new(std::size_t size)
+{
+    void* p = countedAllocate(size);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    void* p = countedAllocateAligned(size, alignment);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
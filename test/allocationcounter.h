@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+// Snapshot of the global operator new counters. The counters are only maintained
+// in builds that link allocationcounter.cpp, which replaces the global allocation
+// functions, so this header is only useful in the testallocations target.
+class AllocationCounter {
+public:
+    AllocationCounter();
+
+    void reset();
+
+    [[nodiscard]] std::size_t getAllocations() const;
+    [[nodiscard]] std::size_t getBytes() const;
+private:
+    std::size_t m_startAllocations = 0;
+    std::size_t m_startBytes = 0;
+};
@@ -0,0 +1,135 @@
+#include "../src/aes128block.h"
+#include "../src/encoder.h"
+
+#include "catch.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using Implementation = cppbackend::AES128Block::Implementation;
+
+static std::vector<Implementation> supportedImplementations()
+{
+    std::vector<Implementation> implementations{};
+    for (const auto implementation : {Implementation::CRYPTOPP, Implementation::AESNI})
+    {
+        if (cppbackend::AES128Block::isSupported(implementation))
+        {
+            implementations.push_back(implementation);
+        }
+    }
+    return implementations;
+}
+
+TEST_CASE("AES block happy path", "[AES128Block]")
+{
+    const std::string original = "[test] 1234";
+    const std::string expected = "vSIVAw46X7/VZEoBa29vkQ==";
+
+    for (const auto implementation : supportedImplementations())
+    {
+        const cppbackend::AES128Block cipher("SECRET_PASS*****", implementation);
+        REQUIRE(cppbackend::Encoder::toAES128(original, cipher) == expected);
+    }
+}
+
+TEST_CASE("AES block matches the Crypto++ pipeline", "[AES128Block]")
+{
+    std::mt19937 random(20201019);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    const auto randomBytes = [&](std::size_t length) {
+        std::string bytes(length, '\0');
+        for (auto& c : bytes)
+        {
+            c = static_cast<char>(byte(random));
+        }
+        return bytes;
+    };
+
+    for (int i = 0; i < 200; ++i)
+    {
+        const auto key = randomBytes(cppbackend::AES128Block::KEY_LENGTH);
+        std::vector<cppbackend::AES128Block> ciphers{};
+        for (const auto implementation : supportedImplementations())
+        {
+            ciphers.emplace_back(key, implementation);
+        }
+
+        // Every single block length, plus longer inputs which take the fallback
+        for (std::size_t length = 0; length <= 40; ++length)
+        {
+            const auto original = randomBytes(length);
+            const auto expected = cppbackend::Encoder::toAES128(original, key);
+            for (const auto& cipher : ciphers)
+            {
+                CAPTURE(i, length, static_cast<int>(cipher.getImplementation()));
+                REQUIRE(cppbackend::Encoder::toAES128(original, cipher) == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("AES block invalid arguments", "[AES128Block]")
+{
+    REQUIRE_THROWS_AS(cppbackend::AES128Block("too short"), std::invalid_argument);
+
+    const cppbackend::AES128Block cipher("SECRET_PASS*****");
+    const std::string block(cppbackend::AES128Block::BLOCK_SIZE, 'x');
+    unsigned char out[cppbackend::AES128Block::BLOCK_SIZE];
+    REQUIRE_THROWS_AS(cipher.encrypt(reinterpret_cast<const unsigned char*>(block.data()), block.size(), out),
+                      std::invalid_argument);
+
+    if (!cppbackend::AES128Block::isSupported(Implementation::AESNI))
+    {
+        REQUIRE_THROWS_AS(cppbackend::AES128Block("SECRET_PASS*****", Implementation::AESNI), std::logic_error);
+    }
+}
+
+TEST_CASE("AES batch matches single block encryption", "[AES128Block]")
+{
+    std::mt19937 random(20201020);
+    std::uniform_int_distribution<std::size_t> length(0, cppbackend::AES128Block::BLOCK_SIZE - 1);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    const std::string key = "SECRET_PASS*****";
+    std::string arena{};
+    for (const auto implementation : supportedImplementations())
+    {
+        const cppbackend::AES128Block cipher(key, implementation);
+
+        // Covers an empty batch, partial lane groups and several full ones
+        for (std::size_t count = 0; count <= 3 * cppbackend::AES128Block::LANES + 1; ++count)
+        {
+            std::vector<std::string> plaintexts(count);
+            for (auto& plaintext : plaintexts)
+            {
+                plaintext.resize(length(random));
+                for (auto& c : plaintext)
+                {
+                    c = static_cast<char>(byte(random));
+                }
+            }
+
+            cppbackend::Encoder::toAES128Batch(plaintexts.data(), count, cipher, arena);
+            REQUIRE(arena.size() == count * cppbackend::Encoder::AES128_TOKEN_LENGTH);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                CAPTURE(count, i, static_cast<int>(implementation));
+                REQUIRE(arena.substr(i * cppbackend::Encoder::AES128_TOKEN_LENGTH,
+                                     cppbackend::Encoder::AES128_TOKEN_LENGTH)
+                        == cppbackend::Encoder::toAES128(plaintexts[i], key));
+            }
+        }
+    }
+}
+
+TEST_CASE("AES batch rejects plaintexts longer than a block", "[AES128Block]")
+{
+    const cppbackend::AES128Block cipher("SECRET_PASS*****");
+    const std::vector<std::string> plaintexts{"1600000000", std::string(cppbackend::AES128Block::BLOCK_SIZE, 'x')};
+    std::string arena{};
+    REQUIRE_THROWS_AS(cppbackend::Encoder::toAES128Batch(plaintexts.data(), plaintexts.size(), cipher, arena),
+                      std::invalid_argument);
+}
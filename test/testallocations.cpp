@@ -0,0 +1,271 @@
+#include "../src/answercache.h"
+#include "../src/backend.h"
+#include "../src/encoder.h"
+#include "../src/logger.h"
+#include "allocationcounter.h"
+#include "common.h"
+
+#include "catch.hpp"
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Maximum number of global operator new calls allowed on each path. These are
+// regression guards for the hot path: when a change reduces the count, lower
+// the matching budget so the improvement cannot silently be lost again.
+static constexpr std::size_t TXT_ANSWER_BUDGET = 4;
+static constexpr std::size_t EPOCH_ANSWER_BUDGET = 5;
+static constexpr std::size_t MISSING_DOMAIN_BUDGET = 4;
+static constexpr std::size_t REJECTED_QUERY_BUDGET = 3;
+static constexpr std::size_t SNAPSHOT_TXT_ANSWER_BUDGET = 4;
+static constexpr std::size_t SNAPSHOT_MISSING_DOMAIN_BUDGET = 4;
+static constexpr std::size_t BASE64_BUDGET = 0;
+static constexpr std::size_t AES_BUDGET = 5;
+static constexpr std::size_t AES_BLOCK_BUDGET = 1;
+static constexpr std::size_t AES_BATCH_BUDGET = 0;
+static constexpr std::size_t LOG_BUDGET = 0;
+static constexpr std::size_t ANSWER_CACHE_HIT_BUDGET = 0;
+// All of them Backend::split's: the copy its stringstream takes of the line,
+// the token buffer, the qname (the only field past the short string buffer)
+// and four growths of the vector to the 7 fields of ABI 2
+static constexpr std::size_t PIPE_CACHE_HIT_BUDGET = 7;
+
+// Runs the query once untimed so one-off allocations (locale facets, lazily
+// prepared state) are not charged to the measured call.
+static std::size_t countQueryAllocations(const cppbackend::Backend& backend,
+                                         const std::string& qname,
+                                         bool expectedResult)
+{
+    std::string warmUp{};
+    REQUIRE(backend.performQuery(qname, warmUp) == expectedResult);
+
+    std::string output{};
+    output.reserve(64);
+
+    AllocationCounter counter;
+    const bool result = backend.performQuery(qname, output);
+    const auto allocations = counter.getAllocations();
+
+    REQUIRE(result == expectedResult);
+    return allocations;
+}
+
+TEST_CASE("Perform query allocation budget", "[Allocations]")
+{
+    cppbackend::Backend backend(DB_PATH);
+
+    SECTION("TXT record answer")
+    {
+        const auto allocations = countQueryAllocations(backend, "2.canberra.testnet", true);
+        CAPTURE(allocations);
+        REQUIRE(allocations <= TXT_ANSWER_BUDGET);
+    }
+
+    SECTION("AES epoch answer")
+    {
+        const auto allocations = countQueryAllocations(backend, "2.canberra.oc.testnet", true);
+        CAPTURE(allocations);
+        REQUIRE(allocations <= EPOCH_ANSWER_BUDGET);
+    }
+
+    SECTION("Domain not in the repository")
+    {
+        const auto allocations = countQueryAllocations(backend, "2.invalid.testnet", false);
+        CAPTURE(allocations);
+        REQUIRE(allocations <= MISSING_DOMAIN_BUDGET);
+    }
+
+    SECTION("Rejected qname")
+    {
+        const auto allocations = countQueryAllocations(backend, "2.canberra.au", false);
+        CAPTURE(allocations);
+        REQUIRE(allocations <= REJECTED_QUERY_BUDGET);
+    }
+}
+
+TEST_CASE("Snapshot query allocation budget", "[Allocations]")
+{
+    cppbackend::SnapshotOptions snapshotOptions{};
+    snapshotOptions.enabled = true;
+    snapshotOptions.path = "/tmp/testallocations.snapshot";
+    cppbackend::Backend backend(DB_PATH, {}, {}, snapshotOptions);
+    // A build on another thread would be counted too
+    backend.waitForSnapshot();
+    REQUIRE(backend.getSnapshot() != nullptr);
+
+    SECTION("TXT record answer")
+    {
+        const auto allocations = countQueryAllocations(backend, "2.canberra.testnet", true);
+        CAPTURE(allocations);
+        REQUIRE(allocations <= SNAPSHOT_TXT_ANSWER_BUDGET);
+    }
+
+    SECTION("Mixed-case qname, matched without a lowercase copy")
+    {
+        const auto allocations = countQueryAllocations(backend, "2.CanBerra.TestNet", true);
+        CAPTURE(allocations);
+        REQUIRE(allocations <= SNAPSHOT_TXT_ANSWER_BUDGET);
+    }
+
+    SECTION("Domain not in the snapshot")
+    {
+        const auto allocations = countQueryAllocations(backend, "2.invalid.testnet", false);
+        CAPTURE(allocations);
+        REQUIRE(allocations <= SNAPSHOT_MISSING_DOMAIN_BUDGET);
+    }
+}
+
+TEST_CASE("Encoder allocation budget", "[Allocations]")
+{
+    SECTION("Base64")
+    {
+        const std::string original{"[bob] 33"};
+        std::string actual{};
+
+        AllocationCounter counter;
+        actual = cppbackend::Encoder::toBase64(original);
+        const auto allocations = counter.getAllocations();
+
+        CAPTURE(allocations);
+        REQUIRE(actual == "W2JvYl0gMzM=");
+        REQUIRE(allocations <= BASE64_BUDGET);
+    }
+
+    SECTION("AES")
+    {
+        const std::string original{"1600000000"};
+        const std::string password{"SECRET_PASS*****"};
+        std::string actual{};
+
+        AllocationCounter counter;
+        actual = cppbackend::Encoder::toAES128(original, password);
+        const auto allocations = counter.getAllocations();
+
+        CAPTURE(allocations);
+        REQUIRE_FALSE(actual.empty());
+        REQUIRE(allocations <= AES_BUDGET);
+    }
+
+    SECTION("AES single block")
+    {
+        const std::string original{"1600000000"};
+        const cppbackend::AES128Block cipher("SECRET_PASS*****");
+        std::string actual{};
+
+        AllocationCounter counter;
+        actual = cppbackend::Encoder::toAES128(original, cipher);
+        const auto allocations = counter.getAllocations();
+
+        CAPTURE(allocations);
+        REQUIRE(actual.size() == 24);
+        REQUIRE(allocations <= AES_BLOCK_BUDGET);
+    }
+
+    SECTION("AES batch into a reused arena")
+    {
+        const std::vector<std::string> plaintexts(16, "1600000000");
+        const cppbackend::AES128Block cipher("SECRET_PASS*****");
+        std::string arena(plaintexts.size() * cppbackend::Encoder::AES128_TOKEN_LENGTH, '\0');
+
+        AllocationCounter counter;
+        cppbackend::Encoder::toAES128Batch(plaintexts.data(), plaintexts.size(), cipher, arena);
+        const auto allocations = counter.getAllocations();
+
+        CAPTURE(allocations);
+        REQUIRE(arena.substr(0, 24) == cppbackend::Encoder::toAES128(plaintexts[0], cipher));
+        REQUIRE(allocations <= AES_BATCH_BUDGET);
+    }
+}
+
+TEST_CASE("Answer cache allocation budget", "[Allocations]")
+{
+    cppbackend::Stats stats{};
+    cppbackend::AnswerCache cache(stats);
+    const auto now = cppbackend::AnswerCache::Clock::now();
+    const std::string qname{"2.canberra.testnet"};
+    const std::string line = cppbackend::Backend::formatResponse(qname, "IN", "1", "W2JvYl0gMzM=", 2, 60);
+    cache.insert(qname, "IN", 2, line, line.size() - 16, 1, 60, false, now);
+
+    std::string output{};
+    output.reserve(128);
+    bool timeBased = false;
+
+    AllocationCounter counter;
+    const bool found = cache.find(qname, "IN", 2, "4711", now, output, timeBased);
+    const auto allocations = counter.getAllocations();
+
+    CAPTURE(allocations);
+    REQUIRE(found);
+    REQUIRE(output == cppbackend::Backend::formatResponse(qname, "IN", "4711", "W2JvYl0gMzM=", 2, 60));
+    REQUIRE(allocations <= ANSWER_CACHE_HIT_BUDGET);
+}
+
+// What readFromInput allocates to answer the queries in input
+static std::size_t countPipeAllocations(cppbackend::Backend& backend, const std::string& input)
+{
+    std::istringstream queryStream(input);
+    AllocationCounter counter;
+    const auto failures = backend.readFromInput(queryStream);
+    const auto allocations = counter.getAllocations();
+
+    REQUIRE(failures.empty());
+    return allocations;
+}
+
+TEST_CASE("Pipe answer cache hit allocation budget", "[Allocations]")
+{
+    cppbackend::Backend backend(DB_PATH);
+    std::istringstream handshakeStream("HELO\t2");
+    REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+    const std::string query{"Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1\t10.1.1.1\n"};
+    countPipeAllocations(backend, query);
+
+    // PowerDNS keeps one readFromInput call going, whose line and answer
+    // buffers are sized by the first query, so a hit costs what one more costs
+    const auto once = countPipeAllocations(backend, query);
+    const auto twice = countPipeAllocations(backend, query + query);
+    const auto allocations = twice - once;
+
+    CAPTURE(once, twice, allocations);
+    REQUIRE(backend.getStats().getAnswerCacheCount(cppbackend::CacheEvent::HIT) == 3);
+    REQUIRE(allocations <= PIPE_CACHE_HIT_BUDGET);
+}
+
+TEST_CASE("Logger allocation budget", "[Allocations]")
+{
+    // The sink runs on the logger's thread; it must not allocate either, or the
+    // process-wide counter would charge it to the caller
+    cppbackend::Logger logger([](const std::string&) {}, cppbackend::LogLevel::INFO, 0);
+    const std::string qname{"2.canberra.testnet"};
+
+    // Let the drain thread size its batch buffer first
+    for (int i = 0; i < 64; ++i)
+    {
+        logger.log(cppbackend::LogLevel::INFO, cppbackend::LogCategory::QUERY, "Received '{}'", qname);
+    }
+    logger.flush();
+
+    AllocationCounter counter;
+    logger.log(cppbackend::LogLevel::DEBUG, cppbackend::LogCategory::QUERY, "Received '{}'", qname);
+    logger.log(cppbackend::LogLevel::INFO, cppbackend::LogCategory::QUERY, "Received '{}'", qname);
+    const auto allocations = counter.getAllocations();
+
+    CAPTURE(allocations);
+    REQUIRE(allocations <= LOG_BUDGET);
+    logger.flush();
+}
+
+TEST_CASE("Allocation counter sees operator new", "[Allocations]")
+{
+    AllocationCounter counter;
+    auto* value = new std::string(64, 'x');
+    const auto allocations = counter.getAllocations();
+    delete value;
+
+    // The std::string object itself plus its heap buffer
+    REQUIRE(allocations == 2);
+    REQUIRE(counter.getBytes() >= 64);
+}
@@ -0,0 +1,267 @@
+#include "../src/answercache.h"
+
+#include "catch.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using cppbackend::AnswerCache;
+using cppbackend::AnswerCacheOptions;
+using cppbackend::CacheEvent;
+using namespace std::chrono_literals;
+
+namespace {
+    // A second boundary plus 250 ms
+    const AnswerCache::Clock::time_point NOW{std::chrono::seconds(1600000000) + 250ms};
+
+    // What formatResponse makes for ABI 1 and 2
+    std::string dataLine(const std::string& qname, const std::string& id)
+    {
+        return "DATA\t" + qname + "\tIN\tTXT\t60\t" + id + "\t\"W2JvYl0gMzM=\"";
+    }
+
+    void insert(AnswerCache& cache, const std::string& qname, int ttl = 60, bool timeBased = false,
+                AnswerCache::Clock::time_point now = NOW)
+    {
+        const auto line = dataLine(qname, "1");
+        cache.insert(qname, "IN", 2, line, line.find("\t1\t") + 1, 1, ttl, timeBased, now);
+    }
+
+    bool cached(AnswerCache& cache, const std::string& qname, AnswerCache::Clock::time_point now = NOW)
+    {
+        std::string line{};
+        bool timeBased = false;
+        return cache.find(qname, "IN", 2, "1", now, line, timeBased);
+    }
+}
+
+TEST_CASE("Answer cache returns the line with the query's id", "[AnswerCache]")
+{
+    cppbackend::Stats stats{};
+    AnswerCache cache(stats);
+    REQUIRE(cache.getCapacity() == AnswerCacheOptions::DEFAULT_CAPACITY);
+    insert(cache, "2.canberra.testnet");
+    REQUIRE(cache.getSize() == 1);
+
+    std::string line{};
+    bool timeBased = true;
+    REQUIRE(cache.find("2.canberra.testnet", "IN", 2, "4711", NOW, line, timeBased));
+    REQUIRE(line == dataLine("2.canberra.testnet", "4711"));
+    REQUIRE_FALSE(timeBased);
+
+    // The qname is echoed as asked, so its case is part of the key, as are
+    // the class and the ABI version that decide the line's layout
+    REQUIRE_FALSE(cache.find("2.Canberra.testnet", "IN", 2, "1", NOW, line, timeBased));
+    REQUIRE_FALSE(cache.find("2.canberra.testnet", "CH", 2, "1", NOW, line, timeBased));
+    REQUIRE_FALSE(cache.find("2.canberra.testnet", "IN", 3, "1", NOW, line, timeBased));
+
+    REQUIRE(stats.getAnswerCacheCount(CacheEvent::HIT) == 1);
+    REQUIRE(stats.getAnswerCacheCount(CacheEvent::MISS) == 3);
+    REQUIRE(stats.getAnswerCacheHitRatio() == Approx(0.25));
+
+    REQUIRE(cache.clear() == 1);
+    REQUIRE(cache.getSize() == 0);
+    REQUIRE_FALSE(cached(cache, "2.canberra.testnet"));
+}
+
+TEST_CASE("Answer cache expiry", "[AnswerCache]")
+{
+    cppbackend::Stats stats{};
+    AnswerCache cache(stats);
+
+    SECTION("Records live for their TTL")
+    {
+        insert(cache, "2.canberra.testnet", 60);
+        REQUIRE(cached(cache, "2.canberra.testnet", NOW + 59s));
+        REQUIRE_FALSE(cached(cache, "2.canberra.testnet", NOW + 60s));
+        REQUIRE(stats.getAnswerCacheCount(CacheEvent::EXPIRY) == 1);
+        REQUIRE(cache.getSize() == 0);
+    }
+
+    SECTION("Time-based answers only until their second ends")
+    {
+        insert(cache, "2.canberra.oc.testnet", 60, true);
+        std::string line{};
+        bool timeBased = false;
+        REQUIRE(cache.find("2.canberra.oc.testnet", "IN", 2, "1", NOW + 749ms, line, timeBased));
+        REQUIRE(timeBased);
+        REQUIRE_FALSE(cached(cache, "2.canberra.oc.testnet", NOW + 750ms));
+    }
+
+    SECTION("Hits give the TTL that is left")
+    {
+        insert(cache, "2.canberra.testnet", 60);
+        std::string line{};
+        bool timeBased = false;
+        REQUIRE(cache.find("2.canberra.testnet", "IN", 2, "7", NOW + 10500ms, line, timeBased));
+        REQUIRE(line == "DATA\t2.canberra.testnet\tIN\tTXT\t50\t7\t\"W2JvYl0gMzM=\"");
+        REQUIRE(cache.find("2.canberra.testnet", "IN", 2, "12345", NOW + 59s, line, timeBased));
+        REQUIRE(line == "DATA\t2.canberra.testnet\tIN\tTXT\t1\t12345\t\"W2JvYl0gMzM=\"");
+
+        // Within their second, epoch answers keep the TTL they were made with
+        insert(cache, "2.canberra.oc.testnet", 60, true);
+        REQUIRE(cache.find("2.canberra.oc.testnet", "IN", 2, "1", NOW + 700ms, line, timeBased));
+        REQUIRE(line == dataLine("2.canberra.oc.testnet", "1"));
+    }
+
+    SECTION("A TTL of 0 is not kept")
+    {
+        insert(cache, "2.canberra.testnet", 0);
+        REQUIRE(cache.getSize() == 0);
+    }
+}
+
+TEST_CASE("Answer cache evicts with CLOCK", "[AnswerCache]")
+{
+    cppbackend::Stats stats{};
+    AnswerCacheOptions options{};
+    options.capacity = 4;
+    options.shards = 1;
+    AnswerCache cache(stats, options);
+
+    SECTION("Referenced entries get a second chance")
+    {
+        for (const auto* qname : {"1.a.testnet", "1.b.testnet", "1.c.testnet", "1.d.testnet"})
+        {
+            insert(cache, qname);
+        }
+        REQUIRE(cached(cache, "1.a.testnet"));
+        REQUIRE(cached(cache, "1.b.testnet"));
+
+        insert(cache, "1.e.testnet");
+        REQUIRE(stats.getAnswerCacheCount(CacheEvent::EVICTION) == 1);
+        REQUIRE(cache.getSize() == 4);
+        REQUIRE_FALSE(cached(cache, "1.c.testnet"));
+        for (const auto* qname : {"1.a.testnet", "1.b.testnet", "1.d.testnet", "1.e.testnet"})
+        {
+            CAPTURE(qname);
+            REQUIRE(cached(cache, qname));
+        }
+    }
+
+    SECTION("Expired entries go before live ones")
+    {
+        insert(cache, "1.a.testnet", 600);
+        insert(cache, "1.b.testnet", 1);
+        insert(cache, "1.c.testnet", 600);
+        insert(cache, "1.d.testnet", 600);
+        insert(cache, "1.e.testnet", 600, false, NOW + 2s);
+        REQUIRE(stats.getAnswerCacheCount(CacheEvent::EVICTION) == 1);
+
+        // a, unreferenced, went first; b expired and is next
+        insert(cache, "1.f.testnet", 600, false, NOW + 2s);
+        REQUIRE(stats.getAnswerCacheCount(CacheEvent::EXPIRY) == 1);
+        REQUIRE(cached(cache, "1.f.testnet", NOW + 2s));
+    }
+
+    SECTION("Replacing a cached answer")
+    {
+        insert(cache, "1.a.testnet", 1);
+        insert(cache, "1.a.testnet", 600);
+        REQUIRE(cache.getSize() == 1);
+        REQUIRE(cached(cache, "1.a.testnet", NOW + 10s));
+    }
+}
+
+TEST_CASE("Answer cache under churn", "[AnswerCache]")
+{
+    // Many more keys than room, so removals keep shifting probe runs
+    cppbackend::Stats stats{};
+    AnswerCacheOptions options{};
+    options.capacity = 64;
+    options.shards = 4;
+    AnswerCache cache(stats, options);
+
+    for (int i = 0; i < 5000; ++i)
+    {
+        insert(cache, "2.domain" + std::to_string(i) + ".testnet");
+        REQUIRE(cached(cache, "2.domain" + std::to_string(i) + ".testnet"));
+    }
+    REQUIRE(cache.getSize() == cache.getCapacity());
+    REQUIRE(stats.getAnswerCacheCount(CacheEvent::EVICTION) == 5000 - cache.getCapacity());
+
+    std::size_t found = 0;
+    for (int i = 0; i < 5000; ++i)
+    {
+        found += cached(cache, "2.domain" + std::to_string(i) + ".testnet") ? 1 : 0;
+    }
+    REQUIRE(found == cache.getCapacity());
+}
+
+TEST_CASE("Answer cache options", "[AnswerCache]")
+{
+    cppbackend::Stats stats{};
+    AnswerCacheOptions options{};
+
+    options.shards = 0;
+    REQUIRE_THROWS_AS(AnswerCache(stats, options), std::invalid_argument);
+    options.shards = 3;
+    REQUIRE_THROWS_AS(AnswerCache(stats, options), std::invalid_argument);
+
+    // The capacity is exact, however it divides over the shards
+    options.shards = 16;
+    for (const std::size_t capacity : {1, 100, 65535})
+    {
+        CAPTURE(capacity);
+        options.capacity = capacity;
+        AnswerCache cache(stats, options);
+        REQUIRE(cache.getCapacity() == capacity);
+    }
+    options.capacity = 1;
+    AnswerCache single(stats, options);
+    insert(single, "1.a.testnet");
+    insert(single, "1.b.testnet");
+    REQUIRE(single.getSize() == 1);
+    REQUIRE(cached(single, "1.b.testnet"));
+
+    const auto misses = stats.getAnswerCacheCount(CacheEvent::MISS);
+
+    options.shards = 4;
+    options.capacity = 0;
+    AnswerCache disabled(stats, options);
+    REQUIRE(disabled.getCapacity() == 0);
+    insert(disabled, "2.canberra.testnet");
+    REQUIRE_FALSE(cached(disabled, "2.canberra.testnet"));
+    REQUIRE(stats.getAnswerCacheCount(CacheEvent::MISS) == misses);
+}
+
+TEST_CASE("Answer cache from several threads", "[AnswerCache]")
+{
+    // Few enough entries that the threads evict each other's answers
+    cppbackend::Stats stats{};
+    AnswerCacheOptions options{};
+    options.capacity = 32;
+    options.shards = 2;
+    AnswerCache cache(stats, options);
+
+    std::vector<std::thread> threads{};
+    for (int thread = 0; thread < 4; ++thread)
+    {
+        threads.emplace_back([&cache, thread] {
+            std::string line{};
+            bool timeBased = false;
+            for (int i = 0; i < 2000; ++i)
+            {
+                const auto qname = std::to_string(thread) + ".domain" + std::to_string(i % 50) + ".testnet";
+                if (!cache.find(qname, "IN", 2, "1", NOW, line, timeBased))
+                {
+                    insert(cache, qname);
+                }
+                else if (line != dataLine(qname, "1"))
+                {
+                    throw std::logic_error("Wrong answer for " + qname);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    REQUIRE(cache.getSize() <= cache.getCapacity());
+    REQUIRE(stats.getAnswerCacheCount(CacheEvent::HIT) + stats.getAnswerCacheCount(CacheEvent::MISS) == 8000);
+}
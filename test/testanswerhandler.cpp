@@ -0,0 +1,112 @@
+#include "../src/answerhandler.h"
+
+#include "catch.hpp"
+
+#include <cctype>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using cppbackend::AnswerContext;
+using cppbackend::AnswerHandler;
+using cppbackend::AnswerHandlerRegistry;
+
+namespace {
+    // One record: platform 2 of "canberra"
+    class FakeRecords : public cppbackend::RecordSource {
+    public:
+        bool findAnswer(std::string_view domain, int platform, std::string* answer, int& ttl) const override
+        {
+            ++lookups;
+            if (domain != "canberra" || platform != 2)
+            {
+                return false;
+            }
+            ttl = 60;
+            if (answer)
+            {
+                *answer = "W2JvYl0gMzM=";
+            }
+            return true;
+        }
+
+        mutable int lookups = 0;
+    };
+
+    class UpperHandler : public AnswerHandler {
+    public:
+        bool answer(int, std::string_view domain, std::string& out, int& ttl) const override
+        {
+            out.assign(domain);
+            for (auto& c : out)
+            {
+                c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            }
+            ttl = 1;
+            return true;
+        }
+    };
+}
+
+TEST_CASE("Built-in answer handlers", "[AnswerHandler]")
+{
+    FakeRecords records{};
+    cppbackend::KeyStore keys({{cppbackend::KeyStore::DEFAULT_PLATFORM, "SECRET_PASS*****"}});
+    cppbackend::Stats stats{};
+    const AnswerContext context{records, keys, stats};
+    const auto& registry = AnswerHandlerRegistry::builtIn();
+
+    SECTION("txt")
+    {
+        const auto handler = registry.create("txt", context);
+        REQUIRE_FALSE(handler->isTimeBased());
+
+        std::string out{};
+        int ttl = 0;
+        REQUIRE(handler->answer(2, "canberra", out, ttl));
+        REQUIRE(out == "W2JvYl0gMzM=");
+        REQUIRE(ttl == 60);
+        REQUIRE_FALSE(handler->answer(3, "canberra", out, ttl));
+    }
+
+    SECTION("epoch")
+    {
+        const auto handler = registry.create("epoch", context);
+        REQUIRE(handler->isTimeBased());
+
+        std::string out{};
+        int ttl = 0;
+        REQUIRE(handler->answer(2, "canberra", out, ttl));
+        REQUIRE(out.size() == 24);
+        REQUIRE(ttl == 60);
+        REQUIRE_FALSE(handler->answer(2, "hobart", out, ttl));
+    }
+
+    SECTION("Unknown names")
+    {
+        REQUIRE(registry.getNames() == std::vector<std::string>{"epoch", "txt"});
+        REQUIRE_THROWS_AS(registry.create("aes", context), std::invalid_argument);
+        REQUIRE(records.lookups == 0);
+    }
+}
+
+TEST_CASE("Answer handler registry", "[AnswerHandler]")
+{
+    FakeRecords records{};
+    cppbackend::KeyStore keys({{cppbackend::KeyStore::DEFAULT_PLATFORM, "SECRET_PASS*****"}});
+    cppbackend::Stats stats{};
+    const AnswerContext context{records, keys, stats};
+
+    AnswerHandlerRegistry registry{};
+    registry.add("upper", [](const AnswerContext&) { return std::make_unique<UpperHandler>(); });
+    REQUIRE_THROWS_AS(registry.add("upper", [](const AnswerContext&) { return std::make_unique<UpperHandler>(); }),
+                      std::invalid_argument);
+
+    const auto handler = registry.create("upper", context);
+    std::string out{};
+    int ttl = 0;
+    REQUIRE(handler->answer(1, "canberra", out, ttl));
+    REQUIRE(out == "CANBERRA");
+    REQUIRE_THROWS_AS(registry.create("txt", context), std::invalid_argument);
+}
@@ -0,0 +1,69 @@
+#include "../src/asciicase.h"
+
+#include "catch.hpp"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using cppbackend::AsciiCase;
+
+TEST_CASE("Word fold matches bytewise lowercasing", "[AsciiCase]")
+{
+    // Every byte value in every position of the word
+    for (int value = 0; value < 256; ++value)
+    {
+        const auto byte = static_cast<unsigned char>(value);
+        const auto expected = static_cast<unsigned char>(value < 128 ? std::tolower(value) : value);
+        for (std::size_t position = 0; position < sizeof(std::uint64_t); ++position)
+        {
+            unsigned char bytes[sizeof(std::uint64_t)] = {'Q', 'x', 0x80, 0xC1, '@', '[', 'Z', 'a'};
+            unsigned char folded[sizeof(std::uint64_t)] = {'q', 'x', 0x80, 0xC1, '@', '[', 'z', 'a'};
+            bytes[position] = byte;
+            folded[position] = expected;
+
+            std::uint64_t word;
+            std::memcpy(&word, bytes, sizeof(word));
+            word = AsciiCase::foldWord(word);
+            CAPTURE(value, position);
+            REQUIRE(std::memcmp(&word, folded, sizeof(word)) == 0);
+        }
+        REQUIRE(static_cast<unsigned char>(AsciiCase::fold(static_cast<char>(byte))) == expected);
+    }
+}
+
+TEST_CASE("Case-insensitive comparison", "[AsciiCase]")
+{
+    REQUIRE(AsciiCase::equals("", ""));
+    REQUIRE(AsciiCase::equals("canberra", "CanBerra"));
+    REQUIRE(AsciiCase::equals("1.CANBERRA.oc.TESTNET", "1.canberra.OC.testnet"));
+    REQUIRE_FALSE(AsciiCase::equals("canberra", "canberr"));
+    REQUIRE_FALSE(AsciiCase::equals("canberra", "canberrb"));
+    // Only A-Z fold: '@' and '`', '[' and '{' are one bit apart as well
+    REQUIRE_FALSE(AsciiCase::equals("@", "`"));
+    REQUIRE_FALSE(AsciiCase::equals("[", "{"));
+    REQUIRE_FALSE(AsciiCase::equals("\xC3\x89", "\xE3\x89"));
+
+    // A difference in any position, in the words and in the tail
+    const std::string name = "abcdefghijklmnopqrstu";
+    for (std::size_t position = 0; position < name.size(); ++position)
+    {
+        auto upper = name;
+        upper[position] = static_cast<char>(std::toupper(upper[position]));
+        auto other = name;
+        other[position] = '-';
+        CAPTURE(position);
+        REQUIRE(AsciiCase::equals(name, upper));
+        REQUIRE_FALSE(AsciiCase::equals(name, other));
+    }
+}
+
+TEST_CASE("Lowercase copy", "[AsciiCase]")
+{
+    std::string out{"left over"};
+    AsciiCase::lower("Hobart.OC.TestNet-01", out);
+    REQUIRE(out == "hobart.oc.testnet-01");
+    AsciiCase::lower("", out);
+    REQUIRE(out.empty());
+}
@@ -1,12 +1,28 @@
 #include "../src/backend.h"
+#include "../src/logger.h"
 #include "common.h"
 
 #include "catch.hpp"
 #include "fmt/format.h"
+#include "sqlite3.h"
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
+
+namespace {
+    // The lines readFromInput answered input with, after checking how many
+    // lines it failed
+    std::vector<std::string> respond(cppbackend::Backend& backend, std::istream& input, std::size_t failures = 0)
+    {
+        std::ostringstream output;
+        REQUIRE(backend.readFromInput(input, output).size() == failures);
+        return cppbackend::Backend::split(output.str(), '\n');
+    }
+}
 
 TEST_CASE("Handshake happy path", "[Backend]")
 {
@@ -64,6 +80,15 @@ TEST_CASE("Perform query happy path", "[Backend]")
         REQUIRE(result);
         REQUIRE_FALSE(actual.empty());
     }
+
+    SECTION("Mixed-case qnames")
+    {
+        std::string actual{};
+        REQUIRE(backend.performQuery("2.CANBERRA.TestNet", actual));
+        REQUIRE(actual == "W2JvYl0gMzM=");
+        REQUIRE(backend.performQuery("2.Canberra.OC.testNET", actual));
+        REQUIRE(backend.isEpochQuery("2.Canberra.OC.testNET"));
+    }
 }
 
 TEST_CASE("Perform query negative path", "[Backend]")
@@ -214,6 +239,109 @@ TEST_CASE("Perform query negative path", "[Backend]")
     }
 }
 
+TEST_CASE("Configured zones", "[Backend]")
+{
+    cppbackend::ZoneOptions zones{};
+    zones.zones = {{"example.org", "txt"}, {"tok.example.org", "epoch"}, {"testnet", "epoch"}};
+    cppbackend::Backend backend(DB_PATH, {}, {}, {}, zones);
+
+    std::string actual{};
+    REQUIRE(backend.performQuery("2.canberra.example.org", actual));
+    REQUIRE(actual == "W2JvYl0gMzM=");
+    REQUIRE_FALSE(backend.isEpochQuery("2.canberra.example.org"));
+
+    REQUIRE(backend.performQuery("2.canberra.tok.example.org", actual));
+    REQUIRE(backend.isEpochQuery("2.canberra.tok.example.org"));
+    REQUIRE(backend.performQuery("2.canberra.testnet", actual));
+    REQUIRE(backend.isEpochQuery("2.canberra.testnet"));
+
+    // The defaults are replaced, not added to
+    REQUIRE_FALSE(backend.performQuery("2.canberra.oc.testnet", actual));
+    REQUIRE_FALSE(backend.performQuery("2.canberra.example.com", actual));
+    REQUIRE_FALSE(backend.performQuery("2.canberra.www.example.org", actual));
+
+    // The zone follows "<platform>.<domain>.", even when a longer zone matches
+    REQUIRE_FALSE(cppbackend::Backend(DB_PATH).isEpochQuery("1.oc.testnet"));
+    zones.zones = {{"example.org", "txt"}, {"canberra.example.org", "epoch"}};
+    cppbackend::Backend nested(DB_PATH, {}, {}, {}, zones);
+    REQUIRE(nested.performQuery("2.canberra.example.org", actual));
+    REQUIRE(actual == "W2JvYl0gMzM=");
+    REQUIRE_FALSE(nested.isEpochQuery("2.canberra.example.org"));
+    REQUIRE(nested.isEpochQuery("2.canberra.canberra.example.org"));
+    REQUIRE_FALSE(nested.isEpochQuery("canberra.example.org"));
+
+    zones.zones.push_back({"Example.Org.", "txt"});
+    REQUIRE_THROWS_AS(cppbackend::Backend(DB_PATH, {}, {}, {}, zones), std::invalid_argument);
+
+    zones.zones = {{"example.org", "aes"}};
+    REQUIRE_THROWS_AS(cppbackend::Backend(DB_PATH, {}, {}, {}, zones), std::invalid_argument);
+
+    // Errors in a zone file name the line
+    const std::string path{"/tmp/testcppbackend_backend_zones.conf"};
+    {
+        std::ofstream file(path, std::ios::trunc);
+        file << "testnet txt\nexample.org aes\n";
+    }
+    zones.zones.clear();
+    zones.file = path;
+    REQUIRE_THROWS_WITH(cppbackend::Backend(DB_PATH, {}, {}, {}, zones),
+                        Catch::Contains(path + ":2: Unknown answer handler 'aes'"));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Answer cache in front of performQuery", "[Backend]")
+{
+    using cppbackend::CacheEvent;
+    using cppbackend::Operation;
+
+    const std::string queries =
+            "Q\t2.canberra.testnet\tIN\tTXT\t7\t192.168.0.1\t10.1.1.1\t10.1.1.1\n"
+            "Q\t2.canberra.testnet\tIN\tANY\t8\t192.168.0.1\t10.1.1.1\t10.1.1.1\n"
+            "Q\t2.canberra.oc.testnet\tIN\tTXT\t9\t192.168.0.1\t10.1.1.1\t10.1.1.1\n"
+            "Q\t2.invalid.testnet\tIN\tTXT\t10\t192.168.0.1\t10.1.1.1\t10.1.1.1\n"
+            "Q\t2.invalid.testnet\tIN\tTXT\t11\t192.168.0.1\t10.1.1.1\t10.1.1.1\n";
+
+    SECTION("Repeated queries skip the lookup")
+    {
+        cppbackend::Backend backend(DB_PATH);
+        std::istringstream handshakeStream("HELO\t3");
+        REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+        std::istringstream queryStream(queries);
+        const auto results = respond(backend, queryStream);
+        REQUIRE(results.size() == 8);
+        REQUIRE(results[0] == "DATA\t21\t1\t2.canberra.testnet\tIN\tTXT\t3600\t7\t\"W2JvYl0gMzM=\"");
+        REQUIRE(results[2] == "DATA\t21\t1\t2.canberra.testnet\tIN\tTXT\t3600\t8\t\"W2JvYl0gMzM=\"");
+
+        const auto& stats = backend.getStats();
+        REQUIRE(stats.getAnswerCacheCount(CacheEvent::HIT) == 1);
+        // Only answers are kept, so both misses went to the database
+        REQUIRE(stats.getAnswerCacheCount(CacheEvent::MISS) == 4);
+        REQUIRE(stats.getOperationLatency(Operation::LOOKUP).getCount() == 4);
+        REQUIRE(stats.getQueryLatency(cppbackend::QueryClass::HIT).getCount() == 2);
+        REQUIRE(stats.getQueryLatency(cppbackend::QueryClass::EPOCH).getCount() == 1);
+
+        REQUIRE(backend.performCommand("cache-flush").find(" and 2 cached answers\n") != std::string::npos);
+        std::istringstream againStream("Q\t2.canberra.testnet\tIN\tTXT\t12\t192.168.0.1\t10.1.1.1\t10.1.1.1\n");
+        REQUIRE(respond(backend, againStream).size() == 2);
+        REQUIRE(stats.getOperationLatency(Operation::LOOKUP).getCount() == 5);
+    }
+
+    SECTION("Disabled")
+    {
+        cppbackend::AnswerCacheOptions cache{};
+        cache.capacity = 0;
+        cppbackend::Backend backend(DB_PATH, {}, {}, {}, {}, cache);
+        std::istringstream handshakeStream("HELO\t3");
+        REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+        std::istringstream queryStream(queries);
+        REQUIRE(respond(backend, queryStream).size() == 8);
+        REQUIRE(backend.getStats().getAnswerCacheCount(CacheEvent::HIT) == 0);
+        REQUIRE(backend.getStats().getOperationLatency(Operation::LOOKUP).getCount() == 5);
+    }
+}
+
 TEST_CASE("Read from input happy path - TXT records", "[Backend]")
 {
     cppbackend::Backend backend(DB_PATH);
@@ -226,12 +354,10 @@ TEST_CASE("Read from input happy path - TXT records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 2);
-        REQUIRE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == "DATA\t2.canberra.testnet\tIN\tTXT\t3600\t1\t\"W2JvYl0gMzM=\"");
-        REQUIRE(pipeResponses[1].getSuccess());
-        REQUIRE(pipeResponses[1].getMessage() == cppbackend::Backend::RESPONSE_END);
+        REQUIRE(pipeResponses[0] == "DATA\t2.canberra.testnet\tIN\tTXT\t3600\t1\t\"W2JvYl0gMzM=\"");
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
     }
 
     SECTION("Multiple TXT records query ABI version 1")
@@ -242,14 +368,12 @@ TEST_CASE("Read from input happy path - TXT records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 6);
         for (int i = 1; i < 6; i += 2)
         {
-            REQUIRE(pipeResponses[i - 1].getSuccess());
-            REQUIRE(pipeResponses[i].getSuccess());
-            REQUIRE(pipeResponses[i - 1].getMessage() == fmt::format("DATA\t2.canberra.testnet\tIN\tTXT\t3600\t{}\t\"W2JvYl0gMzM=\"", (i + 1) / 2));
-            REQUIRE(pipeResponses[i].getMessage() == cppbackend::Backend::RESPONSE_END);
+            REQUIRE(pipeResponses[i - 1] == fmt::format("DATA\t2.canberra.testnet\tIN\tTXT\t3600\t{}\t\"W2JvYl0gMzM=\"", (i + 1) / 2));
+            REQUIRE(pipeResponses[i] == cppbackend::Backend::RESPONSE_END);
         }
     }
 
@@ -261,12 +385,10 @@ TEST_CASE("Read from input happy path - TXT records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 2);
-        REQUIRE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == "DATA\t2.canberra.testnet\tIN\tTXT\t3600\t1\t\"W2JvYl0gMzM=\"");
-        REQUIRE(pipeResponses[1].getSuccess());
-        REQUIRE(pipeResponses[1].getMessage() == cppbackend::Backend::RESPONSE_END);
+        REQUIRE(pipeResponses[0] == "DATA\t2.canberra.testnet\tIN\tTXT\t3600\t1\t\"W2JvYl0gMzM=\"");
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
     }
 
     SECTION("Multiple TXT records query ABI version 2")
@@ -277,14 +399,12 @@ TEST_CASE("Read from input happy path - TXT records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 6);
         for (int i = 1; i < 6; i += 2)
         {
-            REQUIRE(pipeResponses[i - 1].getSuccess());
-            REQUIRE(pipeResponses[i].getSuccess());
-            REQUIRE(pipeResponses[i - 1].getMessage() == fmt::format("DATA\t2.canberra.testnet\tIN\tTXT\t3600\t{}\t\"W2JvYl0gMzM=\"", (i + 1) / 2));
-            REQUIRE(pipeResponses[i].getMessage() == cppbackend::Backend::RESPONSE_END);
+            REQUIRE(pipeResponses[i - 1] == fmt::format("DATA\t2.canberra.testnet\tIN\tTXT\t3600\t{}\t\"W2JvYl0gMzM=\"", (i + 1) / 2));
+            REQUIRE(pipeResponses[i] == cppbackend::Backend::RESPONSE_END);
         }
     }
 
@@ -296,12 +416,10 @@ TEST_CASE("Read from input happy path - TXT records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 2);
-        REQUIRE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == "DATA\t21\t1\t2.canberra.testnet\tIN\tTXT\t3600\t1\t\"W2JvYl0gMzM=\"");
-        REQUIRE(pipeResponses[1].getSuccess());
-        REQUIRE(pipeResponses[1].getMessage() == cppbackend::Backend::RESPONSE_END);
+        REQUIRE(pipeResponses[0] == "DATA\t21\t1\t2.canberra.testnet\tIN\tTXT\t3600\t1\t\"W2JvYl0gMzM=\"");
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
     }
 
     SECTION("Multiple TXT records query ABI version 3")
@@ -312,14 +430,12 @@ TEST_CASE("Read from input happy path - TXT records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 6);
         for (int i = 1; i < 6; i += 2)
         {
-            REQUIRE(pipeResponses[i - 1].getSuccess());
-            REQUIRE(pipeResponses[i].getSuccess());
-            REQUIRE(pipeResponses[i - 1].getMessage() == fmt::format("DATA\t21\t1\t2.canberra.testnet\tIN\tTXT\t3600\t{}\t\"W2JvYl0gMzM=\"", (i + 1) / 2));
-            REQUIRE(pipeResponses[i].getMessage() == cppbackend::Backend::RESPONSE_END);
+            REQUIRE(pipeResponses[i - 1] == fmt::format("DATA\t21\t1\t2.canberra.testnet\tIN\tTXT\t3600\t{}\t\"W2JvYl0gMzM=\"", (i + 1) / 2));
+            REQUIRE(pipeResponses[i] == cppbackend::Backend::RESPONSE_END);
         }
     }
 }
@@ -336,12 +452,10 @@ TEST_CASE("Read from input happy path - epoch records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 2);
-        REQUIRE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage().substr(0, 42) == "DATA\t2.canberra.oc.testnet\tIN\tTXT\t3600\t1\t\"");
-        REQUIRE(pipeResponses[1].getSuccess());
-        REQUIRE(pipeResponses[1].getMessage() == cppbackend::Backend::RESPONSE_END);
+        REQUIRE(pipeResponses[0].substr(0, 42) == "DATA\t2.canberra.oc.testnet\tIN\tTXT\t3600\t1\t\"");
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
     }
 
     SECTION("Multiple epoch records query ABI version 1")
@@ -352,14 +466,12 @@ TEST_CASE("Read from input happy path - epoch records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 6);
         for (int i = 1; i < 6; i += 2)
         {
-            REQUIRE(pipeResponses[i - 1].getSuccess());
-            REQUIRE(pipeResponses[i].getSuccess());
-            REQUIRE(pipeResponses[i - 1].getMessage().substr(0, 42) == fmt::format("DATA\t2.canberra.oc.testnet\tIN\tTXT\t3600\t{}\t\"", (i + 1) / 2));
-            REQUIRE(pipeResponses[i].getMessage() == cppbackend::Backend::RESPONSE_END);
+            REQUIRE(pipeResponses[i - 1].substr(0, 42) == fmt::format("DATA\t2.canberra.oc.testnet\tIN\tTXT\t3600\t{}\t\"", (i + 1) / 2));
+            REQUIRE(pipeResponses[i] == cppbackend::Backend::RESPONSE_END);
         }
     }
 
@@ -371,12 +483,10 @@ TEST_CASE("Read from input happy path - epoch records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 2);
-        REQUIRE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage().substr(0, 42) == "DATA\t2.canberra.oc.testnet\tIN\tTXT\t3600\t1\t\"");
-        REQUIRE(pipeResponses[1].getSuccess());
-        REQUIRE(pipeResponses[1].getMessage() == cppbackend::Backend::RESPONSE_END);
+        REQUIRE(pipeResponses[0].substr(0, 42) == "DATA\t2.canberra.oc.testnet\tIN\tTXT\t3600\t1\t\"");
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
     }
 
     SECTION("Multiple epoch records query ABI version 2")
@@ -387,14 +497,12 @@ TEST_CASE("Read from input happy path - epoch records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 6);
         for (int i = 1; i < 6; i += 2)
         {
-            REQUIRE(pipeResponses[i - 1].getSuccess());
-            REQUIRE(pipeResponses[i].getSuccess());
-            REQUIRE(pipeResponses[i - 1].getMessage().substr(0, 42) == fmt::format("DATA\t2.canberra.oc.testnet\tIN\tTXT\t3600\t{}\t\"", (i + 1) / 2));
-            REQUIRE(pipeResponses[i].getMessage() == cppbackend::Backend::RESPONSE_END);
+            REQUIRE(pipeResponses[i - 1].substr(0, 42) == fmt::format("DATA\t2.canberra.oc.testnet\tIN\tTXT\t3600\t{}\t\"", (i + 1) / 2));
+            REQUIRE(pipeResponses[i] == cppbackend::Backend::RESPONSE_END);
         }
     }
 
@@ -406,12 +514,10 @@ TEST_CASE("Read from input happy path - epoch records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 2);
-        REQUIRE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage().substr(0, 47) == "DATA\t21\t1\t2.canberra.oc.testnet\tIN\tTXT\t3600\t1\t\"");
-        REQUIRE(pipeResponses[1].getSuccess());
-        REQUIRE(pipeResponses[1].getMessage() == cppbackend::Backend::RESPONSE_END);
+        REQUIRE(pipeResponses[0].substr(0, 47) == "DATA\t21\t1\t2.canberra.oc.testnet\tIN\tTXT\t3600\t1\t\"");
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
     }
 
     SECTION("Multiple epoch records query ABI version 3")
@@ -422,14 +528,12 @@ TEST_CASE("Read from input happy path - epoch records", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
+        const auto pipeResponses = respond(backend, queryStream);
         REQUIRE(pipeResponses.size() == 6);
         for (int i = 1; i < 6; i += 2)
         {
-            REQUIRE(pipeResponses[i - 1].getSuccess());
-            REQUIRE(pipeResponses[i].getSuccess());
-            REQUIRE(pipeResponses[i - 1].getMessage().substr(0, 47) == fmt::format("DATA\t21\t1\t2.canberra.oc.testnet\tIN\tTXT\t3600\t{}\t\"", (i + 1) / 2));
-            REQUIRE(pipeResponses[i].getMessage() == cppbackend::Backend::RESPONSE_END);
+            REQUIRE(pipeResponses[i - 1].substr(0, 47) == fmt::format("DATA\t21\t1\t2.canberra.oc.testnet\tIN\tTXT\t3600\t{}\t\"", (i + 1) / 2));
+            REQUIRE(pipeResponses[i] == cppbackend::Backend::RESPONSE_END);
         }
     }
 }
@@ -446,9 +550,8 @@ TEST_CASE("Read from input - unhappy path", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
-        REQUIRE_FALSE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == cppbackend::Backend::RESPONSE_FAIL);
+        const auto pipeResponses = respond(backend, queryStream, 1);
+        REQUIRE(pipeResponses.back() == cppbackend::Backend::RESPONSE_FAIL);
     }
 
     SECTION("Invalid query - wrong length for ABI 2")
@@ -459,9 +562,8 @@ TEST_CASE("Read from input - unhappy path", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
-        REQUIRE_FALSE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == cppbackend::Backend::RESPONSE_FAIL);
+        const auto pipeResponses = respond(backend, queryStream, 1);
+        REQUIRE(pipeResponses.back() == cppbackend::Backend::RESPONSE_FAIL);
     }
 
     SECTION("Invalid query - wrong length for ABI 3")
@@ -472,22 +574,25 @@ TEST_CASE("Read from input - unhappy path", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
-        REQUIRE_FALSE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == cppbackend::Backend::RESPONSE_FAIL);
+        const auto pipeResponses = respond(backend, queryStream, 1);
+        REQUIRE(pipeResponses.back() == cppbackend::Backend::RESPONSE_FAIL);
     }
 
     SECTION("Invalid query - invalid type")
     {
         std::istringstream handshakeStream("HELO\t1");
-        std::istringstream queryStream("R\t2.canberra.oc.testnet\tIN\tTXT\t1\t192.168.0.1\t10.1.1.1");
+        std::istringstream queryStream("R\t2.canberra.oc.testnet\tIN\tTXT\t1\t192.168.0.1");
 
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
-        REQUIRE_FALSE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == cppbackend::Backend::RESPONSE_FAIL);
+        // Only failures are returned, with why
+        std::ostringstream output;
+        const auto failures = backend.readFromInput(queryStream, output);
+        REQUIRE(failures.size() == 1);
+        REQUIRE_FALSE(failures[0].getSuccess());
+        REQUIRE(failures[0].getMessage() == "Bad request type 'R'");
+        REQUIRE(output.str() == "LOG\tReceived a bad request type: 'R'\nFAIL\n");
     }
 
     SECTION("Invalid query - invalid qtype")
@@ -498,9 +603,8 @@ TEST_CASE("Read from input - unhappy path", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
-        REQUIRE_FALSE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == cppbackend::Backend::RESPONSE_FAIL);
+        const auto pipeResponses = respond(backend, queryStream, 1);
+        REQUIRE(pipeResponses.back() == cppbackend::Backend::RESPONSE_FAIL);
     }
 
     SECTION("Invalid query - invalid qname")
@@ -511,8 +615,233 @@ TEST_CASE("Read from input - unhappy path", "[Backend]")
         auto handshakeResponse = backend.performHandshake(handshakeStream);
         REQUIRE(handshakeResponse.getSuccess());
 
-        auto pipeResponses = backend.readFromInput(queryStream);
-        REQUIRE_FALSE(pipeResponses[0].getSuccess());
-        REQUIRE(pipeResponses[0].getMessage() == cppbackend::Backend::RESPONSE_FAIL);
+        const auto pipeResponses = respond(backend, queryStream, 1);
+        REQUIRE(pipeResponses.back() == cppbackend::Backend::RESPONSE_FAIL);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Read from input - record types", "[Backend]")
+{
+    cppbackend::Backend backend(DB_PATH);
+    std::istringstream handshakeStream("HELO\t1");
+    REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+    SECTION("ANY is answered with the TXT record")
+    {
+        std::istringstream queryStream("Q\t2.canberra.testnet\tIN\tANY\t1\t192.168.0.1");
+
+        const auto pipeResponses = respond(backend, queryStream);
+        REQUIRE(pipeResponses.size() == 2);
+        REQUIRE(pipeResponses[0] == "DATA\t2.canberra.testnet\tIN\tTXT\t3600\t1\t\"W2JvYl0gMzM=\"");
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
+    }
+
+    SECTION("Unsupported types get END without DATA")
+    {
+        for (const std::string qtype : {"SOA", "A", "AAAA", "NS", "MX"})
+        {
+            std::istringstream queryStream(fmt::format("Q\t2.canberra.testnet\tIN\t{}\t1\t192.168.0.1", qtype));
+
+            const auto pipeResponses = respond(backend, queryStream);
+            CAPTURE(qtype);
+            REQUIRE(pipeResponses.size() == 1);
+            REQUIRE(pipeResponses[0] == cppbackend::Backend::RESPONSE_END);
+        }
+    }
+}
+
+TEST_CASE("Format response TTL", "[Backend]")
+{
+    REQUIRE(cppbackend::Backend::formatResponse("2.canberra.testnet", "IN", "1", "data", 1, 60)
+            == "DATA\t2.canberra.testnet\tIN\tTXT\t60\t1\t\"data\"");
+    REQUIRE(cppbackend::Backend::formatResponse("2.canberra.testnet", "IN", "1", "data", 3, 60)
+            == "DATA\t21\t1\t2.canberra.testnet\tIN\tTXT\t60\t1\t\"data\"");
+}
+
+TEST_CASE("Per-row TTL", "[Backend]")
+{
+    const std::string copyPath{"/tmp/testcppbackend_ttl.db"};
+    std::remove(copyPath.c_str());
+    cppbackend::Repository::createIndexes(DB_PATH, copyPath);
+
+    // Without a ttl column every answer gets the default
+    {
+        cppbackend::RepositoryOptions options{};
+        options.defaultTTL = 120;
+        cppbackend::Backend backend(copyPath, options);
+
+        std::string actual{};
+        int ttl = 0;
+        REQUIRE(backend.performQuery("2.canberra.testnet", actual, ttl));
+        REQUIRE(ttl == 120);
+    }
+
+    sqlite3* database = nullptr;
+    REQUIRE(sqlite3_open(copyPath.c_str(), &database) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(database,
+                         "ALTER TABLE platform ADD COLUMN ttl INTEGER;"
+                         "UPDATE platform SET ttl = 30 WHERE nbr = 2;",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(database);
+
+    cppbackend::Backend backend(copyPath);
+    std::istringstream handshakeStream("HELO\t1");
+    REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+    std::istringstream queryStream("Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1\n"
+                                   "Q\t3.canberra.testnet\tIN\tTXT\t1\t192.168.0.1");
+    const auto pipeResponses = respond(backend, queryStream);
+    REQUIRE(pipeResponses.size() == 4);
+    REQUIRE(pipeResponses[0] == "DATA\t2.canberra.testnet\tIN\tTXT\t30\t1\t\"W2JvYl0gMzM=\"");
+    // NULL ttl falls back to the default
+    REQUIRE(pipeResponses[2].find("\tTXT\t3600\t") != std::string::npos);
+
+    std::remove(copyPath.c_str());
+}
+
+TEST_CASE("Names that only differ in case", "[Backend]")
+{
+    const std::string copyPath{"/tmp/testcppbackend_case.db"};
+    std::remove(copyPath.c_str());
+    cppbackend::Repository::createIndexes(DB_PATH, copyPath);
+
+    sqlite3* database = nullptr;
+    REQUIRE(sqlite3_open(copyPath.c_str(), &database) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(database,
+                         "INSERT INTO domain (id, name) VALUES (1000, 'CanBerra');"
+                         "INSERT INTO platform (domain_id, nbr, txt) VALUES (1000, 2, 'upper');",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(database);
+
+    // Both rows match; the one whose domain row comes first answers, as in the snapshot
+    cppbackend::Backend backend(copyPath);
+    std::istringstream handshakeStream("HELO\t1");
+    REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+    std::istringstream queryStream("Q\t2.CANBERRA.testnet\tIN\tTXT\t1\t192.168.0.1");
+    const auto pipeResponses = respond(backend, queryStream);
+    REQUIRE(pipeResponses.size() == 2);
+    REQUIRE(pipeResponses[0] == "DATA\t2.CANBERRA.testnet\tIN\tTXT\t3600\t1\t\"W2JvYl0gMzM=\"");
+    REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
+
+    std::remove(copyPath.c_str());
+}
+
+TEST_CASE("Read from input - misses and protocol errors", "[Backend]")
+{
+    cppbackend::Backend backend(DB_PATH);
+    std::istringstream handshakeStream("HELO\t1");
+    REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+    SECTION("Misses get END without DATA")
+    {
+        for (const std::string qname : {"2.notarealdomain.testnet", "1.hobart.testnet", "9.canberra.testnet",
+                                        "x.canberra.testnet", "2.notarealdomain.oc.testnet", "2.canberra.com.au",
+                                        "canberra"})
+        {
+            std::istringstream queryStream(fmt::format("Q\t{}\tIN\tTXT\t1\t192.168.0.1", qname));
+
+            const auto pipeResponses = respond(backend, queryStream);
+            CAPTURE(qname);
+            REQUIRE(pipeResponses.size() == 1);
+            REQUIRE(pipeResponses[0] == cppbackend::Backend::RESPONSE_END);
+        }
+    }
+
+    SECTION("Protocol errors get FAIL")
+    {
+        for (const std::string line : {"Q\t2.canberra.testnet\tIN\tTXT\t1",
+                                       "Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1\t10.1.1.1",
+                                       "AXFR\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1",
+                                       "\n"})
+        {
+            std::istringstream queryStream(line);
+
+            CAPTURE(line);
+            const auto pipeResponses = respond(backend, queryStream, 1);
+            REQUIRE(pipeResponses.size() == 2);
+            REQUIRE(pipeResponses[0].rfind("LOG\t", 0) == 0);
+            REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_FAIL);
+        }
+    }
+
+    SECTION("A miss does not disturb the next answer")
+    {
+        std::istringstream queryStream("Q\t2.notarealdomain.testnet\tIN\tTXT\t1\t192.168.0.1\n"
+                                       "Q\t2.canberra.testnet\tIN\tTXT\t2\t192.168.0.1");
+
+        const auto pipeResponses = respond(backend, queryStream);
+        REQUIRE(pipeResponses.size() == 3);
+        REQUIRE(pipeResponses[0] == cppbackend::Backend::RESPONSE_END);
+        REQUIRE(pipeResponses[1] == "DATA\t2.canberra.testnet\tIN\tTXT\t3600\t2\t\"W2JvYl0gMzM=\"");
+        REQUIRE(pipeResponses[2] == cppbackend::Backend::RESPONSE_END);
+    }
+}
+
+TEST_CASE("Command channel", "[Backend]")
+{
+    cppbackend::Backend backend(DB_PATH);
+
+    SECTION("Answered on ABI 3")
+    {
+        std::istringstream handshakeStream("HELO\t3");
+        REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+        std::istringstream queryStream("CMD\thelp\n"
+                                       "Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1\t10.1.1.1\t0.0.0.0/0");
+        std::ostringstream output;
+        REQUIRE(backend.readFromInput(queryStream, output).empty());
+        const auto help = cppbackend::Backend::COMMAND_HELP + cppbackend::Backend::RESPONSE_END + "\n";
+        REQUIRE(output.str().rfind(help, 0) == 0);
+        const auto pipeResponses = cppbackend::Backend::split(output.str().substr(help.size()), '\n');
+        REQUIRE(pipeResponses.size() == 2);
+        REQUIRE(pipeResponses[0].rfind("DATA\t", 0) == 0);
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_END);
+    }
+
+    SECTION("A protocol error before ABI 3")
+    {
+        std::istringstream handshakeStream("HELO\t2");
+        REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+        std::istringstream queryStream("CMD\thelp");
+        const auto pipeResponses = respond(backend, queryStream, 1);
+        REQUIRE(pipeResponses.size() == 2);
+        REQUIRE(pipeResponses[1] == cppbackend::Backend::RESPONSE_FAIL);
+    }
+
+    SECTION("Commands")
+    {
+        auto& logger = cppbackend::Logger::global();
+        const auto level = logger.getLevel();
+        const auto rate = logger.getRateLimit();
+
+        REQUIRE(backend.performCommand("log-level   debug") == "Log level debug\n");
+        REQUIRE(logger.getLevel() == cppbackend::LogLevel::DEBUG);
+        REQUIRE(backend.performCommand("log-level") == "Log level debug\n");
+        REQUIRE(backend.performCommand("log-level loud").rfind("Error: ", 0) == 0);
+        REQUIRE(backend.performCommand("log-rate 25") == "Log rate 25 per second\n");
+        REQUIRE(logger.getRateLimit() == 25);
+        REQUIRE(backend.performCommand("log-rate -1").rfind("Error: ", 0) == 0);
+        REQUIRE(backend.performCommand("log-rate 2x").rfind("Error: ", 0) == 0);
+        logger.setLevel(level);
+        logger.setRateLimit(rate);
+
+        REQUIRE(backend.performCommand("stats").find("cppbackend_queries_total{abi=\"3\",result=\"data\"} ") != std::string::npos);
+        REQUIRE(backend.performCommand("cache-warm").rfind("Read ", 0) == 0);
+        REQUIRE(backend.performCommand("cache-flush").rfind("Released ", 0) == 0);
+        const auto& stats = backend.getStats();
+        const auto pageLookups = stats.getPageCacheHits() + stats.getPageCacheMisses();
+        REQUIRE(pageLookups > 0);
+        REQUIRE(backend.performCommand("reload") == "Reloaded the database and keys, keys generation 2\n");
+
+        std::string output{};
+        REQUIRE(backend.performQuery("2.canberra.testnet", output));
+        REQUIRE(output == "W2JvYl0gMzM=");
+        // The new connection's counts add to the old one's
+        REQUIRE_FALSE(backend.performCommand("stats").empty());
+        REQUIRE(stats.getPageCacheHits() + stats.getPageCacheMisses() > pageLookups);
+
+        REQUIRE(backend.performCommand("") == "Unknown command '', use 'help' for the list\n");
+        REQUIRE(backend.performCommand("stats now") == "Unknown command 'stats now', use 'help' for the list\n");
+    }
+}
@@ -0,0 +1,142 @@
+#include "../src/base64encoder.h"
+#include "../src/base64/base64.h"
+
+#include "catch.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using Implementation = cppbackend::Base64Encoder::Implementation;
+
+static std::string encodeWith(Implementation implementation, const std::string& s)
+{
+    // One guard byte past the end catches writes beyond encodedLength
+    const auto length = cppbackend::Base64Encoder::encodedLength(s.size());
+    std::string encoded(length + 1, '#');
+    const auto* in = reinterpret_cast<const unsigned char*>(s.data());
+
+    switch (implementation)
+    {
+        case Implementation::SCALAR:
+            cppbackend::Base64Encoder::encodeScalar(in, s.size(), &encoded[0]);
+            break;
+        case Implementation::SSSE3:
+            cppbackend::Base64Encoder::encodeSSSE3(in, s.size(), &encoded[0]);
+            break;
+        case Implementation::AVX2:
+            cppbackend::Base64Encoder::encodeAVX2(in, s.size(), &encoded[0]);
+            break;
+    }
+
+    REQUIRE(encoded[length] == '#');
+    encoded.resize(length);
+    return encoded;
+}
+
+static std::vector<Implementation> supportedImplementations()
+{
+    std::vector<Implementation> implementations{};
+    for (const auto implementation : {Implementation::SCALAR, Implementation::SSSE3, Implementation::AVX2})
+    {
+        if (cppbackend::Base64Encoder::isSupported(implementation))
+        {
+            implementations.push_back(implementation);
+        }
+    }
+    return implementations;
+}
+
+TEST_CASE("Base64 encoder RFC 4648 vectors", "[Base64Encoder]")
+{
+    const std::vector<std::pair<std::string, std::string>> vectors = {
+            {"", ""},
+            {"f", "Zg=="},
+            {"fo", "Zm8="},
+            {"foo", "Zm9v"},
+            {"foob", "Zm9vYg=="},
+            {"fooba", "Zm9vYmE="},
+            {"foobar", "Zm9vYmFy"}};
+
+    for (const auto implementation : supportedImplementations())
+    {
+        for (const auto& [original, expected] : vectors)
+        {
+            REQUIRE(encodeWith(implementation, original) == expected);
+        }
+    }
+}
+
+TEST_CASE("Base64 encoder matches the reference encoder", "[Base64Encoder]")
+{
+    std::mt19937 random(20201019);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    const auto randomBytes = [&](std::size_t length) {
+        std::string bytes(length, '\0');
+        for (auto& c : bytes)
+        {
+            c = static_cast<char>(byte(random));
+        }
+        return bytes;
+    };
+
+    SECTION("Every length up to 256 bytes")
+    {
+        // Covers every tail length after each number of whole SIMD blocks
+        for (std::size_t length = 0; length <= 256; ++length)
+        {
+            const auto original = randomBytes(length);
+            const auto expected = base64_encode(original);
+            for (const auto implementation : supportedImplementations())
+            {
+                CAPTURE(length, static_cast<int>(implementation));
+                REQUIRE(encodeWith(implementation, original) == expected);
+            }
+        }
+    }
+
+    SECTION("Random lengths up to 4 KiB")
+    {
+        std::uniform_int_distribution<std::size_t> length(0, 4096);
+        for (int i = 0; i < 2000; ++i)
+        {
+            const auto original = randomBytes(length(random));
+            const auto expected = base64_encode(original);
+            for (const auto implementation : supportedImplementations())
+            {
+                CAPTURE(original.size(), static_cast<int>(implementation));
+                REQUIRE(encodeWith(implementation, original) == expected);
+            }
+        }
+    }
+
+    SECTION("Dispatching encoder")
+    {
+        for (std::size_t length = 0; length <= 100; ++length)
+        {
+            const auto original = randomBytes(length);
+            std::string encoded(cppbackend::Base64Encoder::encodedLength(length), '\0');
+            cppbackend::Base64Encoder::encode(reinterpret_cast<const unsigned char*>(original.data()),
+                                              original.size(), &encoded[0]);
+            REQUIRE(encoded == base64_encode(original));
+        }
+    }
+}
+
+TEST_CASE("Base64 encoder unsupported implementation", "[Base64Encoder]")
+{
+    const std::string original{"foobar"};
+    std::string encoded(8, '\0');
+    const auto* in = reinterpret_cast<const unsigned char*>(original.data());
+
+    if (!cppbackend::Base64Encoder::isSupported(Implementation::AVX2))
+    {
+        REQUIRE_THROWS(cppbackend::Base64Encoder::encodeAVX2(in, original.size(), &encoded[0]));
+    }
+    if (!cppbackend::Base64Encoder::isSupported(Implementation::SSSE3))
+    {
+        REQUIRE_THROWS(cppbackend::Base64Encoder::encodeSSSE3(in, original.size(), &encoded[0]));
+    }
+    REQUIRE(cppbackend::Base64Encoder::isSupported(Implementation::SCALAR));
+}
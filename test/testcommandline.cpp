@@ -0,0 +1,169 @@
+#include "../src/commandline.h"
+
+#include "catch.hpp"
+
+#include <string>
+
+TEST_CASE("Command line happy path", "[CommandLine]")
+{
+    SECTION("Database path only")
+    {
+        const char* argv[] = {"cppbackend", "/data/records.db"};
+        auto options = cppbackend::CommandLine::parse(2, argv);
+
+        REQUIRE(options.dbPath == "/data/records.db");
+        REQUIRE(options.createIndexPath.empty());
+        REQUIRE(options.repository.noMutex);
+        REQUIRE_FALSE(options.repository.immutable);
+    }
+
+    SECTION("SQLite tuning options")
+    {
+        const char* argv[] = {"cppbackend", "--mmap-size=0", "--cache-size=2048", "--temp-store=default",
+                              "--immutable", "--shared-cache", "--mutex", "/data/records.db"};
+        auto options = cppbackend::CommandLine::parse(8, argv);
+
+        REQUIRE(options.dbPath == "/data/records.db");
+        REQUIRE(options.repository.mmapSize == 0);
+        REQUIRE(options.repository.cacheSizeKiB == 2048);
+        REQUIRE_FALSE(options.repository.tempStoreMemory);
+        REQUIRE(options.repository.immutable);
+        REQUIRE(options.repository.sharedCache);
+        REQUIRE_FALSE(options.repository.noMutex);
+    }
+
+    SECTION("Create index mode")
+    {
+        const char* argv[] = {"cppbackend", "--create-index", "/data/records.db", "/data/indexed.db"};
+        auto options = cppbackend::CommandLine::parse(4, argv);
+
+        REQUIRE(options.dbPath == "/data/records.db");
+        REQUIRE(options.createIndexPath == "/data/indexed.db");
+    }
+
+    SECTION("Default TTL")
+    {
+        const char* argv[] = {"cppbackend", "--ttl=60", "/data/records.db"};
+        auto options = cppbackend::CommandLine::parse(3, argv);
+        REQUIRE(options.repository.defaultTTL == 60);
+    }
+
+    SECTION("Key sources")
+    {
+        const char* fileArgv[] = {"cppbackend", "--key-file=/etc/cppbackend/keys", "/data/records.db"};
+        auto options = cppbackend::CommandLine::parse(3, fileArgv);
+        REQUIRE(options.keys.file == "/etc/cppbackend/keys");
+        REQUIRE_FALSE(options.keys.fromDatabase);
+
+        const char* databaseArgv[] = {"cppbackend", "--keys-from-database", "/data/records.db"};
+        options = cppbackend::CommandLine::parse(3, databaseArgv);
+        REQUIRE(options.keys.file.empty());
+        REQUIRE(options.keys.fromDatabase);
+    }
+
+    SECTION("Snapshot")
+    {
+        const char* defaultArgv[] = {"cppbackend", "--snapshot", "/data/records.db"};
+        auto options = cppbackend::CommandLine::parse(3, defaultArgv);
+        REQUIRE(options.snapshot.enabled);
+        REQUIRE(options.snapshot.path.empty());
+
+        const char* pathArgv[] = {"cppbackend", "--snapshot=/var/cache/records.snapshot", "/data/records.db"};
+        options = cppbackend::CommandLine::parse(3, pathArgv);
+        REQUIRE(options.snapshot.enabled);
+        REQUIRE(options.snapshot.path == "/var/cache/records.snapshot");
+    }
+
+    SECTION("Zones")
+    {
+        const char* argv[] = {"cppbackend", "--zone=example.org:txt", "--zone=tok.example.org:epoch",
+                              "--zone-file=/etc/cppbackend/zones", "/data/records.db"};
+        auto options = cppbackend::CommandLine::parse(5, argv);
+        REQUIRE(options.zones.file == "/etc/cppbackend/zones");
+        REQUIRE(options.zones.zones.size() == 2);
+        REQUIRE(options.zones.zones[0].name == "example.org");
+        REQUIRE(options.zones.zones[0].handler == "txt");
+        REQUIRE(options.zones.zones[1].name == "tok.example.org");
+        REQUIRE(options.zones.zones[1].handler == "epoch");
+    }
+
+    SECTION("Answer cache")
+    {
+        const char* defaultArgv[] = {"cppbackend", "/data/records.db"};
+        auto options = cppbackend::CommandLine::parse(2, defaultArgv);
+        REQUIRE(options.answerCache.capacity == cppbackend::AnswerCacheOptions::DEFAULT_CAPACITY);
+
+        const char* disabledArgv[] = {"cppbackend", "--answer-cache=0", "/data/records.db"};
+        options = cppbackend::CommandLine::parse(3, disabledArgv);
+        REQUIRE(options.answerCache.capacity == 0);
+    }
+}
+
+TEST_CASE("Command line unhappy path", "[CommandLine]")
+{
+    SECTION("No database path")
+    {
+        const char* argv[] = {"cppbackend"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(1, argv));
+    }
+
+    SECTION("Too many database paths")
+    {
+        const char* argv[] = {"cppbackend", "/data/records.db", "/data/other.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+
+    SECTION("Create index without destination")
+    {
+        const char* argv[] = {"cppbackend", "--create-index", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+
+    SECTION("Unknown option")
+    {
+        const char* argv[] = {"cppbackend", "--fast", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+
+    SECTION("Bad number")
+    {
+        const char* argv[] = {"cppbackend", "--mmap-size=lots", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+
+    SECTION("Negative number")
+    {
+        const char* argv[] = {"cppbackend", "--cache-size=-1", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+
+    SECTION("Cache size out of range")
+    {
+        const char* argv[] = {"cppbackend", "--cache-size=2147483648", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+
+    SECTION("TTL out of range")
+    {
+        const char* argv[] = {"cppbackend", "--ttl=2147483648", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+
+    SECTION("Bad zone")
+    {
+        const char* argv[] = {"cppbackend", "--zone=example.org", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+
+    SECTION("Both key sources")
+    {
+        const char* argv[] = {"cppbackend", "--key-file=/etc/cppbackend/keys", "--keys-from-database", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(4, argv));
+    }
+
+    SECTION("Empty key file")
+    {
+        const char* argv[] = {"cppbackend", "--key-file=", "/data/records.db"};
+        REQUIRE_THROWS(cppbackend::CommandLine::parse(3, argv));
+    }
+}
@@ -0,0 +1,234 @@
+#include "../src/backend.h"
+#include "../src/encoder.h"
+#include "../src/keystore.h"
+#include "common.h"
+
+#include "catch.hpp"
+#include "fmt/format.h"
+#include "sqlite3.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+static const std::string KEY_ONE{"platform-one-key"};
+static const std::string KEY_TWO{"platform-two-key"};
+static const std::string KEY_DEFAULT{"default=key=16ch"};
+
+static void writeFile(const std::string& path, const std::string& contents)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << contents;
+}
+
+static std::string epochToken(const std::string& key, std::chrono::seconds offset = std::chrono::seconds{0})
+{
+    const auto now = std::chrono::system_clock::now() + offset;
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
+    return cppbackend::Encoder::toAES128(fmt::format("{}", seconds.count()), key);
+}
+
+// The clock can tick between the query and the check, so accept either second
+static bool isEpochToken(const std::string& token, const std::string& key)
+{
+    return token == epochToken(key) || token == epochToken(key, std::chrono::seconds{-1});
+}
+
+TEST_CASE("Key store lookups", "[KeyStore]")
+{
+    SECTION("Platform keys with a default")
+    {
+        cppbackend::KeyStore keys({{1, KEY_ONE}, {cppbackend::KeyStore::DEFAULT_PLATFORM, KEY_DEFAULT}});
+
+        REQUIRE(keys.getCipher(1)->getKey() == KEY_ONE);
+        for (int platform = 2; platform <= cppbackend::KeyStore::MAX_PLATFORM; ++platform)
+        {
+            REQUIRE(keys.getCipher(platform)->getKey() == KEY_DEFAULT);
+        }
+        REQUIRE(keys.getCipher(0) == nullptr);
+        REQUIRE(keys.getCipher(cppbackend::KeyStore::MAX_PLATFORM + 1) == nullptr);
+        REQUIRE(keys.getGeneration() == 1);
+    }
+
+    SECTION("Platform without a key")
+    {
+        cppbackend::KeyStore keys({{2, KEY_TWO}});
+
+        REQUIRE(keys.getCipher(1) == nullptr);
+        REQUIRE(keys.getCipher(2)->getKey() == KEY_TWO);
+    }
+
+    SECTION("Invalid keys")
+    {
+        REQUIRE_THROWS_AS(cppbackend::KeyStore({{1, "short"}}), std::invalid_argument);
+        REQUIRE_THROWS_AS(cppbackend::KeyStore({{6, KEY_ONE}}), std::invalid_argument);
+        REQUIRE_THROWS_AS(cppbackend::KeyStore({{-1, KEY_ONE}}), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Key store replace", "[KeyStore]")
+{
+    cppbackend::KeyStore keys({{1, KEY_ONE}});
+    auto before = keys.getCipher(1);
+    const std::weak_ptr<const cppbackend::AES128Block> retired = before;
+
+    keys.replace({{1, KEY_TWO}});
+    REQUIRE(keys.getCipher(1)->getKey() == KEY_TWO);
+    REQUIRE(keys.getGeneration() == 2);
+
+    // A cipher handed out before the swap stays usable, and the retired key
+    // goes once it is let go
+    REQUIRE(before->getKey() == KEY_ONE);
+    before.reset();
+    REQUIRE(retired.expired());
+
+    // A bad set leaves the current keys in place
+    REQUIRE_THROWS(keys.replace({{1, KEY_ONE}, {2, "short"}}));
+    REQUIRE(keys.getCipher(1)->getKey() == KEY_TWO);
+    REQUIRE(keys.getGeneration() == 2);
+}
+
+TEST_CASE("Key file", "[KeyStore]")
+{
+    const std::string path{"/tmp/testcppbackend_keys.conf"};
+
+    SECTION("Happy path")
+    {
+        writeFile(path, fmt::format("# rotated 2020-10-19\n\n1={}\r\ndefault={}\n", KEY_ONE, KEY_DEFAULT));
+
+        const auto keys = cppbackend::KeyStore::readFile(path);
+        REQUIRE(keys.size() == 2);
+        REQUIRE(keys.at(1) == KEY_ONE);
+        REQUIRE(keys.at(cppbackend::KeyStore::DEFAULT_PLATFORM) == KEY_DEFAULT);
+    }
+
+    SECTION("Malformed lines")
+    {
+        for (const auto& contents : {"1 " + KEY_ONE, "one=" + KEY_ONE, "0=" + KEY_ONE,
+                                     "1=" + KEY_ONE + "\n1=" + KEY_TWO})
+        {
+            CAPTURE(contents);
+            writeFile(path, contents);
+            REQUIRE_THROWS_AS(cppbackend::KeyStore::readFile(path), std::invalid_argument);
+        }
+    }
+
+    SECTION("Missing file")
+    {
+        REQUIRE_THROWS_AS(cppbackend::KeyStore::readFile("/this/path/does/not/exist.conf"), std::runtime_error);
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Backend per-platform keys", "[KeyStore]")
+{
+    SECTION("Built-in key by default")
+    {
+        cppbackend::Backend backend(DB_PATH);
+        std::string actual{};
+        REQUIRE(backend.performQuery("2.canberra.oc.testnet", actual));
+        REQUIRE(isEpochToken(actual, "SECRET_PASS*****"));
+    }
+
+    SECTION("Key file and reload")
+    {
+        const std::string path{"/tmp/testcppbackend_backend_keys.conf"};
+        writeFile(path, fmt::format("2={}\n", KEY_TWO));
+
+        cppbackend::KeyOptions keyOptions{};
+        keyOptions.file = path;
+        cppbackend::Backend backend(DB_PATH, {}, keyOptions);
+
+        std::string actual{};
+        REQUIRE(backend.performQuery("2.canberra.oc.testnet", actual));
+        REQUIRE(isEpochToken(actual, KEY_TWO));
+
+        // Platform 1 has no key, so its epoch queries have no answer
+        REQUIRE_FALSE(backend.performQuery("1.canberra.oc.testnet", actual));
+
+        writeFile(path, fmt::format("default={}\n", KEY_DEFAULT));
+        backend.reloadKeys();
+        REQUIRE(backend.performQuery("2.canberra.oc.testnet", actual));
+        REQUIRE(isEpochToken(actual, KEY_DEFAULT));
+
+        // A broken file on reload keeps the previous keys
+        writeFile(path, "2=short\n");
+        REQUIRE_THROWS(backend.reloadKeys());
+        REQUIRE(backend.performQuery("2.canberra.oc.testnet", actual));
+        REQUIRE(isEpochToken(actual, KEY_DEFAULT));
+
+        std::remove(path.c_str());
+    }
+
+    SECTION("Reload requested between lines")
+    {
+        const std::string path{"/tmp/testcppbackend_backend_keys.conf"};
+        writeFile(path, fmt::format("default={}\n", KEY_ONE));
+
+        cppbackend::KeyOptions keyOptions{};
+        keyOptions.file = path;
+        cppbackend::Backend backend(DB_PATH, {}, keyOptions);
+
+        std::istringstream handshakeStream("HELO\t1");
+        REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+        writeFile(path, fmt::format("default={}\n", KEY_TWO));
+        cppbackend::Backend::requestKeyReload();
+
+        std::istringstream queryStream("Q\t2.canberra.oc.testnet\tIN\tTXT\t1\t192.168.0.1");
+        std::ostringstream output;
+        REQUIRE(backend.readFromInput(queryStream, output).empty());
+
+        const auto data = output.str().substr(0, output.str().find('\n'));
+        const auto quote = data.find('"');
+        REQUIRE(quote != std::string::npos);
+        REQUIRE(isEpochToken(data.substr(quote + 1, data.size() - quote - 2), KEY_TWO));
+
+        std::remove(path.c_str());
+    }
+
+    SECTION("Keys from the database")
+    {
+        const std::string copyPath{"/tmp/testcppbackend_keys.db"};
+        std::remove(copyPath.c_str());
+        cppbackend::Repository::createIndexes(DB_PATH, copyPath);
+
+        cppbackend::KeyOptions keyOptions{};
+        keyOptions.fromDatabase = true;
+
+        // No platform_key table yet
+        REQUIRE_THROWS(cppbackend::Backend(copyPath, {}, keyOptions));
+
+        sqlite3* database = nullptr;
+        REQUIRE(sqlite3_open(copyPath.c_str(), &database) == SQLITE_OK);
+        const auto sql = fmt::format("CREATE TABLE platform_key (nbr INTEGER PRIMARY KEY, key VARCHAR NOT NULL);"
+                                     "INSERT INTO platform_key VALUES (2, '{}');", KEY_TWO);
+        REQUIRE(sqlite3_exec(database, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+        sqlite3_close(database);
+
+        cppbackend::Backend backend(copyPath, {}, keyOptions);
+        std::string actual{};
+        REQUIRE(backend.performQuery("2.canberra.oc.testnet", actual));
+        REQUIRE(isEpochToken(actual, KEY_TWO));
+
+        // Without the constraints, a repeated platform or a NULL key is refused
+        // rather than one row silently winning
+        for (const auto* rows : {"(2, 'platform-one-key'), (2, 'platform-two-key')", "(2, NULL)",
+                                 "(NULL, 'platform-two-key')"})
+        {
+            CAPTURE(rows);
+            REQUIRE(sqlite3_open(copyPath.c_str(), &database) == SQLITE_OK);
+            const auto loose = fmt::format("DROP TABLE platform_key; CREATE TABLE platform_key (nbr INTEGER, key VARCHAR);"
+                                           "INSERT INTO platform_key VALUES {};", rows);
+            REQUIRE(sqlite3_exec(database, loose.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+            sqlite3_close(database);
+            REQUIRE_THROWS_AS(cppbackend::Backend(copyPath, {}, keyOptions), std::runtime_error);
+        }
+
+        std::remove(copyPath.c_str());
+    }
+}
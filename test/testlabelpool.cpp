@@ -0,0 +1,59 @@
+#include "../src/labelpool.h"
+
+#include "catch.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using cppbackend::LabelPool;
+
+TEST_CASE("Label pool interns each label once", "[LabelPool]")
+{
+    LabelPool pool{};
+    REQUIRE(pool.find("canberra") == LabelPool::NOT_FOUND);
+
+    const auto canberra = pool.intern("canberra");
+    const auto hobart = pool.intern("hobart");
+    REQUIRE(canberra != hobart);
+    REQUIRE(pool.intern("canberra") == canberra);
+    REQUIRE(pool.find("canberra") == canberra);
+    REQUIRE(pool.find("canberr") == LabelPool::NOT_FOUND);
+    REQUIRE(pool.get(canberra) == "canberra");
+    REQUIRE(pool.get(hobart) == "hobart");
+    REQUIRE(pool.getCount() == 2);
+
+    // Length-prefixed, one after the other
+    REQUIRE(pool.getBuffer() == std::string("\x08" "canberra" "\x06" "hobart"));
+    REQUIRE(LabelPool::get(pool.getBuffer().data(), hobart) == "hobart");
+
+    const auto empty = pool.intern("");
+    REQUIRE(pool.get(empty).empty());
+    REQUIRE(pool.find("") == empty);
+}
+
+TEST_CASE("Label pool offsets survive growth", "[LabelPool]")
+{
+    LabelPool pool{};
+    std::vector<std::uint32_t> offsets{};
+    for (int i = 0; i < 100000; ++i)
+    {
+        offsets.push_back(pool.intern(std::to_string(i) + ".example"));
+    }
+    REQUIRE(pool.getCount() == offsets.size());
+    for (int i = 0; i < 100000; ++i)
+    {
+        REQUIRE(pool.get(offsets[i]) == std::to_string(i) + ".example");
+        REQUIRE(pool.find(std::to_string(i) + ".example") == offsets[i]);
+        REQUIRE(pool.intern(std::to_string(i) + ".example") == offsets[i]);
+    }
+    REQUIRE(pool.getCount() == offsets.size());
+}
+
+TEST_CASE("Label pool length limit", "[LabelPool]")
+{
+    LabelPool pool{};
+    const std::string longest(LabelPool::MAX_LENGTH, 'a');
+    REQUIRE(pool.get(pool.intern(longest)) == longest);
+    REQUIRE_THROWS_AS(pool.intern(longest + "a"), std::invalid_argument);
+}
@@ -0,0 +1,151 @@
+#include "../src/logger.h"
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using cppbackend::LogCategory;
+using cppbackend::LogLevel;
+
+// Collects what the logger hands to its sink
+class CapturedLines {
+public:
+    cppbackend::Logger::Sink sink()
+    {
+        return [this](const std::string& lines) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_lines += lines;
+        };
+    }
+
+    std::string lines()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lines;
+    }
+
+    std::size_t count(const std::string& needle)
+    {
+        const auto all = lines();
+        std::size_t found = 0;
+        for (auto position = all.find(needle); position != std::string::npos; position = all.find(needle, position + 1))
+        {
+            ++found;
+        }
+        return found;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::string m_lines{};
+};
+
+TEST_CASE("Logger writes formatted lines", "[Logger]")
+{
+    CapturedLines captured;
+    cppbackend::Logger logger(captured.sink(), LogLevel::INFO, 0);
+
+    logger.log(LogLevel::WARNING, LogCategory::REPOSITORY, "Lookups in '{}' scan {} rows", "test.db", 42);
+    logger.flush();
+
+    const auto lines = captured.lines();
+    REQUIRE(lines.find(" warning repository: Lookups in 'test.db' scan 42 rows\n") != std::string::npos);
+    // 2020-10-19T12:34:56.789Z
+    REQUIRE(lines.size() > 24);
+    REQUIRE(lines[10] == 'T');
+    REQUIRE(lines[23] == 'Z');
+}
+
+TEST_CASE("Logger levels", "[Logger]")
+{
+    CapturedLines captured;
+    cppbackend::Logger logger(captured.sink(), LogLevel::WARNING, 0);
+
+    REQUIRE(logger.isEnabled(LogLevel::ERROR));
+    REQUIRE_FALSE(logger.isEnabled(LogLevel::INFO));
+
+    logger.log(LogLevel::DEBUG, LogCategory::QUERY, "hidden {}", 1);
+    logger.log(LogLevel::ERROR, LogCategory::QUERY, "shown {}", 1);
+
+    logger.setLevel(LogLevel::DEBUG);
+    logger.log(LogLevel::DEBUG, LogCategory::QUERY, "shown {}", 2);
+
+    logger.setLevel(LogLevel::OFF);
+    REQUIRE_FALSE(logger.isEnabled(LogLevel::ERROR));
+    logger.log(LogLevel::ERROR, LogCategory::QUERY, "hidden {}", 2);
+
+    logger.flush();
+    REQUIRE(captured.count("shown") == 2);
+    REQUIRE(captured.count("hidden") == 0);
+
+    REQUIRE(cppbackend::Logger::parseLevel("debug") == LogLevel::DEBUG);
+    REQUIRE(cppbackend::Logger::parseLevel("off") == LogLevel::OFF);
+    REQUIRE_THROWS_AS(cppbackend::Logger::parseLevel("loud"), std::invalid_argument);
+}
+
+TEST_CASE("Logger rate limit is per category", "[Logger]")
+{
+    CapturedLines captured;
+    cppbackend::Logger logger(captured.sink(), LogLevel::DEBUG, 10);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        logger.log(LogLevel::INFO, LogCategory::QUERY, "query {}", i);
+    }
+    logger.log(LogLevel::INFO, LogCategory::KEYS, "keys reloaded");
+    logger.flush();
+
+    // Whole lines, as the category prefix says "query" too. The window can
+    // roll over mid-loop, which lets at most one more batch through.
+    REQUIRE(captured.count("query: query ") >= 10);
+    REQUIRE(captured.count("query: query ") <= 20);
+    REQUIRE(captured.count("keys reloaded") == 1);
+    REQUIRE(logger.getSuppressed() >= 80);
+}
+
+TEST_CASE("Logger truncates long messages", "[Logger]")
+{
+    CapturedLines captured;
+    cppbackend::Logger logger(captured.sink(), LogLevel::INFO, 0);
+
+    const std::string longText(cppbackend::Logger::MESSAGE_LENGTH * 2, 'x');
+    logger.log(LogLevel::INFO, LogCategory::QUERY, "{}", longText);
+    logger.flush();
+
+    REQUIRE(captured.count(std::string(cppbackend::Logger::MESSAGE_LENGTH, 'x') + "\n") == 1);
+}
+
+TEST_CASE("Logger from many threads", "[Logger]")
+{
+    constexpr int THREADS = 8;
+    constexpr int MESSAGES = 2000;
+
+    CapturedLines captured;
+    std::uint64_t dropped = 0;
+    {
+        cppbackend::Logger logger(captured.sink(), LogLevel::INFO, 0);
+
+        std::vector<std::thread> threads{};
+        for (int t = 0; t < THREADS; ++t)
+        {
+            threads.emplace_back([&logger, t]() {
+                for (int i = 0; i < MESSAGES; ++i)
+                {
+                    logger.log(LogLevel::INFO, LogCategory::QUERY, "thread {} message {}", t, i);
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        dropped = logger.getDropped();
+    }
+
+    // The destructor drains the ring, so every message not dropped for a full ring arrived
+    REQUIRE(captured.count("\n") + dropped == THREADS * MESSAGES);
+}
@@ -0,0 +1,96 @@
+#include "../src/perfecthash.h"
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using cppbackend::PerfectHash;
+
+namespace {
+    std::vector<std::string> makeKeys(std::size_t count)
+    {
+        std::vector<std::string> keys{};
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            keys.push_back(std::to_string(i) + ".example.testnet");
+        }
+        return keys;
+    }
+
+    PerfectHash::Table buildTable(const std::vector<std::string>& keys)
+    {
+        return PerfectHash::build(keys.size(), [&keys](std::size_t index, std::uint64_t seed) {
+            return PerfectHash::hash(keys[index], seed);
+        });
+    }
+}
+
+TEST_CASE("Perfect hash gives every key its own slot", "[PerfectHash]")
+{
+    for (const std::size_t count : {1, 2, 3, 10, 1000, 50000})
+    {
+        const auto keys = makeKeys(count);
+        const auto table = buildTable(keys);
+        REQUIRE(table.slots.size() == count);
+        REQUIRE(table.displacements.size() == PerfectHash::bucketCount(count));
+
+        // Minimal: the slots are exactly 0..count-1
+        auto slots = table.slots;
+        std::sort(slots.begin(), slots.end());
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            REQUIRE(slots[i] == i);
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto hash = PerfectHash::hash(keys[i], table.seed);
+            REQUIRE(PerfectHash::slot(hash, static_cast<std::uint32_t>(count), table.displacements.data(),
+                                      static_cast<std::uint32_t>(table.displacements.size())) == table.slots[i]);
+        }
+    }
+}
+
+TEST_CASE("Perfect hash of no keys", "[PerfectHash]")
+{
+    const auto table = buildTable({});
+    REQUIRE(table.slots.empty());
+    REQUIRE(table.displacements.size() == 1);
+}
+
+TEST_CASE("Perfect hash rejects equal keys", "[PerfectHash]")
+{
+    auto keys = makeKeys(100);
+    keys.push_back(keys[42]);
+    REQUIRE_THROWS_AS(buildTable(keys), std::runtime_error);
+}
+
+TEST_CASE("Perfect hash key hashing", "[PerfectHash]")
+{
+    // Every length up to two words, so the tail handling is covered
+    const std::string text = "abcdefghijklmnopq";
+    for (std::size_t length = 0; length <= text.size(); ++length)
+    {
+        const auto key = text.substr(0, length);
+        REQUIRE(PerfectHash::hash(key, 1) == PerfectHash::hash(std::string(key), 1));
+        REQUIRE(PerfectHash::hash(key, 1) != PerfectHash::hash(key, 2));
+        if (length > 0)
+        {
+            REQUIRE(PerfectHash::hash(key, 1) != PerfectHash::hash(text.substr(0, length - 1), 1));
+        }
+    }
+    REQUIRE(PerfectHash::hash("canberra", 7) != PerfectHash::hash("canberrb", 7));
+
+    // Fingerprints of a set of keys are almost all different
+    const auto keys = makeKeys(10000);
+    std::vector<std::uint32_t> fingerprints{};
+    for (const auto& key : keys)
+    {
+        fingerprints.push_back(PerfectHash::fingerprint(PerfectHash::hash(key, 1)));
+    }
+    std::sort(fingerprints.begin(), fingerprints.end());
+    REQUIRE(std::unique(fingerprints.begin(), fingerprints.end()) - fingerprints.begin() > 9990);
+}
@@ -0,0 +1,105 @@
+#include "../src/backend.h"
+#include "../src/querylog.h"
+#include "common.h"
+
+#include "catch.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using cppbackend::QueryLog;
+
+TEST_CASE("Warm-up line formats", "[QueryLog]")
+{
+    REQUIRE(QueryLog::parseLine("2.canberra.testnet") == "2.canberra.testnet");
+    REQUIRE(QueryLog::parseLine("  2.canberra.testnet.\r") == "2.canberra.testnet");
+    REQUIRE(QueryLog::parseLine("Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1") == "2.canberra.testnet");
+    REQUIRE(QueryLog::parseLine("Oct 19 12:00:00 pdns_server[42]: Remote 192.0.2.1 wants "
+                                "'2.canberra.oc.testnet.|TXT', do = 0, bufsize = 1232: packetcache MISS")
+            == "2.canberra.oc.testnet");
+
+    REQUIRE(QueryLog::parseLine("").empty());
+    REQUIRE(QueryLog::parseLine("   ").empty());
+    REQUIRE(QueryLog::parseLine("# recent qnames").empty());
+    REQUIRE(QueryLog::parseLine("Done launching threads, ready to distribute questions").empty());
+    REQUIRE(QueryLog::parseLine("Remote 192.0.2.1 wants '2.canberra.testnet").empty());
+}
+
+TEST_CASE("Capture and read back", "[QueryLog]")
+{
+    const std::string path = "/tmp/cppbackend_testquerylog.txt";
+
+    SECTION("Newest first, without repeats") {
+        QueryLog log(path, 3);
+        REQUIRE(log.getQnames().empty());
+
+        log.record("1.a.testnet");
+        log.record("2.b.testnet");
+        log.record("1.a.testnet");
+        REQUIRE(log.getQnames() == std::vector<std::string>{"1.a.testnet", "2.b.testnet"});
+
+        // The ring keeps the last 3
+        log.record("3.c.testnet");
+        log.record("4.d.testnet");
+        REQUIRE(log.getQnames() == std::vector<std::string>{"4.d.testnet", "3.c.testnet", "1.a.testnet"});
+
+        REQUIRE(log.save() == 3);
+        REQUIRE(QueryLog::readFile(path) == log.getQnames());
+        std::remove(path.c_str());
+    }
+
+    SECTION("Unreadable and unwritable paths") {
+        REQUIRE_THROWS_AS(QueryLog::readFile("/this/path/does/not/exist.txt"), std::runtime_error);
+        QueryLog log("/this/path/does/not/exist.txt");
+        log.record("1.a.testnet");
+        REQUIRE_THROWS_AS(log.save(), std::runtime_error);
+    }
+}
+
+TEST_CASE("Backend warm-up", "[QueryLog]")
+{
+    cppbackend::Backend backend(DB_PATH);
+
+    SECTION("Resolves every qname within the budget") {
+        const std::vector<std::string> qnames{"2.canberra.testnet", "2.canberra.oc.testnet", "2.invalid.testnet", ""};
+        const auto result = backend.warmUp(qnames, std::chrono::seconds(10));
+        REQUIRE(result.complete);
+        REQUIRE(result.queries == 4);
+        REQUIRE(result.answered == 2);
+        REQUIRE(result.pageCacheHitRatio >= 0.0);
+        REQUIRE(result.pageCacheHitRatio <= 1.0);
+        REQUIRE(backend.getStats().getPageCacheHits() + backend.getStats().getPageCacheMisses() > 0);
+    }
+
+    SECTION("Stops when the budget runs out") {
+        const auto result = backend.warmUp({"2.canberra.testnet"}, std::chrono::milliseconds(0));
+        REQUIRE_FALSE(result.complete);
+        REQUIRE(result.queries == 0);
+    }
+
+    SECTION("Captures answered queries") {
+        QueryLog log("/tmp/cppbackend_testquerylog_capture.txt");
+        backend.setQueryLog(&log);
+
+        std::istringstream handshakeStream("HELO\t1");
+        REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+        std::istringstream queryStream("Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1\n"
+                                       "Q\t2.notarealdomain.testnet\tIN\tTXT\t2\t192.168.0.1\n"
+                                       "Q\t3.canberra.oc.testnet\tIN\tTXT\t3\t192.168.0.1\n");
+        std::ostringstream output;
+        REQUIRE(backend.readFromInput(queryStream, output).empty());
+        REQUIRE(cppbackend::Backend::split(output.str(), '\n').size() == 5);
+
+        REQUIRE(log.getQnames() == std::vector<std::string>{"3.canberra.oc.testnet", "2.canberra.testnet"});
+        REQUIRE(backend.performCommand("capture-save") ==
+                "Wrote 2 qnames to '/tmp/cppbackend_testquerylog_capture.txt'\n");
+        std::remove(log.getPath().c_str());
+
+        backend.setQueryLog(nullptr);
+        REQUIRE(backend.performCommand("capture-save").rfind("Not capturing", 0) == 0);
+    }
+}
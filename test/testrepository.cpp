@@ -3,6 +3,7 @@
 
 #include "catch.hpp"
 
+#include <cstdio>
 #include <string>
 
 void emptyPathConstructor()
@@ -50,3 +51,172 @@ TEST_CASE("Query unhappy path", "[Repository]")
         REQUIRE(actual.empty());
     }
 }
+
+TEST_CASE("Lookup index check", "[Repository]")
+{
+    SECTION("Fixture database has no indexes")
+    {
+        cppbackend::Repository repository(DB_PATH);
+        REQUIRE_FALSE(repository.isLookupIndexed());
+    }
+
+    SECTION("Indexed copy")
+    {
+        const std::string copyPath{"/tmp/testcppbackend_indexed.db"};
+        std::remove(copyPath.c_str());
+
+        cppbackend::Repository::createIndexes(DB_PATH, copyPath);
+
+        cppbackend::Repository repository(copyPath);
+        REQUIRE(repository.isLookupIndexed());
+        REQUIRE(repository.getTXTRecord("canberra", 2) == "[bob] 33");
+        REQUIRE(repository.getTXTRecord("hobart", 1).empty());
+
+        std::remove(copyPath.c_str());
+    }
+
+    SECTION("Indexed copy with a ttl column")
+    {
+        const std::string withTTLPath{"/tmp/testcppbackend_ttl.db"};
+        const std::string copyPath{"/tmp/testcppbackend_indexed.db"};
+        std::remove(withTTLPath.c_str());
+        std::remove(copyPath.c_str());
+        cppbackend::Repository::createIndexes(DB_PATH, withTTLPath);
+        sqlite3* database = nullptr;
+        REQUIRE(sqlite3_open(withTTLPath.c_str(), &database) == SQLITE_OK);
+        REQUIRE(sqlite3_exec(database, "DROP INDEX platform_domain_id_nbr_txt_idx;"
+                                       "ALTER TABLE platform ADD COLUMN ttl INTEGER;",
+                             nullptr, nullptr, nullptr) == SQLITE_OK);
+        sqlite3_close(database);
+
+        cppbackend::Repository::createIndexes(withTTLPath, copyPath);
+        cppbackend::Repository repository(copyPath);
+        REQUIRE(repository.isLookupIndexed());
+
+        // The TTL lookup is answered from the index alone
+        REQUIRE(sqlite3_open(copyPath.c_str(), &database) == SQLITE_OK);
+        const auto explain = "EXPLAIN QUERY PLAN " + cppbackend::Repository::TXT_RECORD_TTL_QUERY;
+        sqlite3_stmt* statement = nullptr;
+        REQUIRE(sqlite3_prepare_v2(database, explain.c_str(), -1, &statement, nullptr) == SQLITE_OK);
+        bool covered = false;
+        while (sqlite3_step(statement) == SQLITE_ROW)
+        {
+            const std::string detail{reinterpret_cast<const char*>(sqlite3_column_text(statement, 3))};
+            covered = covered || (detail.find("platform") != std::string::npos &&
+                                  detail.find("COVERING INDEX") != std::string::npos);
+        }
+        sqlite3_finalize(statement);
+        sqlite3_close(database);
+        REQUIRE(covered);
+
+        std::remove(withTTLPath.c_str());
+        std::remove(copyPath.c_str());
+    }
+
+    SECTION("Copy onto itself")
+    {
+        REQUIRE_THROWS(cppbackend::Repository::createIndexes(DB_PATH, DB_PATH));
+    }
+}
+
+TEST_CASE("Lookups ignore ASCII case", "[Repository]")
+{
+    SECTION("Fixture database")
+    {
+        cppbackend::Repository repository(DB_PATH);
+        REQUIRE(repository.isCaseInsensitive());
+        REQUIRE(repository.getTXTRecord("CANBERRA", 2) == "[bob] 33");
+        REQUIRE(repository.getTXTRecord("CanBerra", 2) == "[bob] 33");
+    }
+
+    SECTION("Indexed copy")
+    {
+        const std::string copyPath{"/tmp/testcppbackend_indexed.db"};
+        std::remove(copyPath.c_str());
+        cppbackend::Repository::createIndexes(DB_PATH, copyPath);
+
+        cppbackend::Repository repository(copyPath);
+        REQUIRE(repository.isCaseInsensitive());
+        REQUIRE(repository.isLookupIndexed());
+        REQUIRE(repository.getTXTRecord("CanBerra", 2) == "[bob] 33");
+
+        std::remove(copyPath.c_str());
+    }
+
+    SECTION("Copy indexed by an older --create-index")
+    {
+        const std::string copyPath{"/tmp/testcppbackend_indexed.db"};
+        std::remove(copyPath.c_str());
+        cppbackend::Repository::createIndexes(DB_PATH, copyPath);
+        sqlite3* database = nullptr;
+        REQUIRE(sqlite3_open(copyPath.c_str(), &database) == SQLITE_OK);
+        REQUIRE(sqlite3_exec(database, "DROP INDEX domain_name_nocase_idx; CREATE INDEX domain_name_idx ON domain (name);",
+                             nullptr, nullptr, nullptr) == SQLITE_OK);
+        sqlite3_close(database);
+
+        // Still index-backed, at the price of exact matching
+        cppbackend::Repository repository(copyPath);
+        REQUIRE_FALSE(repository.isCaseInsensitive());
+        REQUIRE(repository.isLookupIndexed());
+        REQUIRE(repository.getTXTRecord("canberra", 2) == "[bob] 33");
+        REQUIRE(repository.getTXTRecord("CanBerra", 2).empty());
+
+        std::remove(copyPath.c_str());
+    }
+}
+
+TEST_CASE("Query is not open to SQL injection", "[Repository]")
+{
+    cppbackend::Repository repository(DB_PATH);
+
+    auto actual = repository.getTXTRecord("x\" OR \"1\"=\"1", 2);
+    REQUIRE(actual.empty());
+}
+
+TEST_CASE("Connection tuning options", "[Repository]")
+{
+    SECTION("Untuned connection")
+    {
+        cppbackend::RepositoryOptions options{};
+        options.noMutex = false;
+        options.mmapSize = 0;
+        options.cacheSizeKiB = 0;
+        options.tempStoreMemory = false;
+
+        cppbackend::Repository repository(DB_PATH, options);
+        REQUIRE(repository.getTXTRecord("canberra", 2) == "[bob] 33");
+    }
+
+    SECTION("Every option enabled")
+    {
+        cppbackend::RepositoryOptions options{};
+        options.immutable = true;
+        options.sharedCache = true;
+
+        cppbackend::Repository repository(DB_PATH, options);
+        REQUIRE(repository.getTXTRecord("canberra", 2) == "[bob] 33");
+    }
+
+    SECTION("Immutable path with URI characters")
+    {
+        const std::string copyPath{"/tmp/testcppbackend #1?.db"};
+        std::remove(copyPath.c_str());
+        cppbackend::Repository::createIndexes(DB_PATH, copyPath);
+
+        cppbackend::RepositoryOptions options{};
+        options.immutable = true;
+
+        cppbackend::Repository repository(copyPath, options);
+        REQUIRE(repository.getTXTRecord("canberra", 2) == "[bob] 33");
+
+        std::remove(copyPath.c_str());
+    }
+
+    SECTION("Immutable missing file")
+    {
+        cppbackend::RepositoryOptions options{};
+        options.immutable = true;
+
+        REQUIRE_THROWS(cppbackend::Repository("/this/path/does/not/exist.db", options));
+    }
+}
@@ -0,0 +1,216 @@
+#include "../src/backend.h"
+#include "../src/keystore.h"
+#include "../src/repositorypool.h"
+#include "common.h"
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr int THREADS = 8;
+static constexpr int LOOKUPS_PER_THREAD = 500;
+
+TEST_CASE("Pool constructor unhappy path", "[RepositoryPool]")
+{
+    REQUIRE_THROWS(cppbackend::RepositoryPool(""));
+    REQUIRE_THROWS(cppbackend::RepositoryPool("/this/path/does/not/exist.db"));
+}
+
+TEST_CASE("Pool reuses the thread's connection", "[RepositoryPool]")
+{
+    cppbackend::RepositoryPool pool(DB_PATH);
+    REQUIRE(pool.getConnectionCount() == 1);
+
+    REQUIRE(pool.getTXTRecord("canberra", 2) == "[bob] 33");
+    REQUIRE(pool.getTXTRecord("hobart", 1).empty());
+    REQUIRE(&pool.local() == &pool.local());
+    REQUIRE(pool.getConnectionCount() == 1);
+}
+
+TEST_CASE("Pools on one thread stay separate", "[RepositoryPool]")
+{
+    cppbackend::RepositoryPool first(DB_PATH);
+    cppbackend::RepositoryPool second(DB_PATH);
+
+    REQUIRE(&first.local() != &second.local());
+    REQUIRE(first.getTXTRecord("canberra", 2) == second.getTXTRecord("canberra", 2));
+}
+
+TEST_CASE("Pool reload", "[RepositoryPool]")
+{
+    cppbackend::RepositoryPool pool(DB_PATH);
+    const auto* before = &pool.local();
+    REQUIRE(pool.getGeneration() == 0);
+
+    // The calling thread's connection is replaced, not kept alongside
+    pool.reload();
+    REQUIRE(pool.getGeneration() == 1);
+    REQUIRE(&pool.local() != before);
+    REQUIRE(pool.getConnectionCount() == 1);
+    REQUIRE(pool.getTXTRecord("canberra", 2) == "[bob] 33");
+
+    // Another thread that had a connection switches to a new one at its next
+    // lookup, and closes the one it had
+    std::promise<void> opened{};
+    std::promise<void> reloaded{};
+    const cppbackend::Repository* first = nullptr;
+    const cppbackend::Repository* second = nullptr;
+    std::string record{};
+    std::thread other([&pool, &opened, &reloaded, &first, &second, &record] {
+        first = &pool.local();
+        opened.set_value();
+        reloaded.get_future().wait();
+        second = &pool.local();
+        record = pool.getTXTRecord("canberra", 2);
+    });
+    opened.get_future().wait();
+    REQUIRE(pool.getConnectionCount() == 2);
+    pool.reload();
+    reloaded.set_value();
+    other.join();
+
+    REQUIRE(second != first);
+    REQUIRE(record == "[bob] 33");
+    REQUIRE(pool.getConnectionCount() == 2);
+}
+
+TEST_CASE("Concurrent lookups", "[RepositoryPool]")
+{
+    cppbackend::RepositoryPool pool(DB_PATH);
+    std::atomic<int> failures{0};
+
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&pool, &failures, t]() {
+            for (int i = 0; i < LOOKUPS_PER_THREAD; ++i)
+            {
+                const bool hit = (i + t) % 2 == 0;
+                const auto actual = hit ? pool.getTXTRecord("canberra", 2)
+                                        : pool.getTXTRecord("hobart", 1);
+                if (actual != (hit ? "[bob] 33" : ""))
+                {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    REQUIRE(failures == 0);
+    // The constructing thread's connection plus one per worker
+    REQUIRE(pool.getConnectionCount() == THREADS + 1);
+}
+
+TEST_CASE("Concurrent backend queries", "[RepositoryPool]")
+{
+    const cppbackend::Backend backend(DB_PATH);
+    std::atomic<int> failures{0};
+
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&backend, &failures]() {
+            std::string output{};
+            for (int i = 0; i < LOOKUPS_PER_THREAD; ++i)
+            {
+                output.clear();
+                if (!backend.performQuery("2.canberra.testnet", output) || output != "W2JvYl0gMzM=")
+                {
+                    ++failures;
+                }
+                output.clear();
+                if (backend.performQuery("2.invalid.testnet", output))
+                {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    REQUIRE(failures == 0);
+}
+
+TEST_CASE("Concurrent pool reload", "[RepositoryPool]")
+{
+    cppbackend::RepositoryPool pool(DB_PATH);
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&pool, &done, &failures]() {
+            while (!done)
+            {
+                if (pool.getTXTRecord("canberra", 2) != "[bob] 33")
+                {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        pool.reload();
+    }
+    done = true;
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    REQUIRE(failures == 0);
+    REQUIRE(pool.getGeneration() == 10);
+}
+
+TEST_CASE("Concurrent key reload", "[KeyStore]")
+{
+    const std::string keyOne{"platform-one-key"};
+    const std::string keyTwo{"platform-two-key"};
+    cppbackend::KeyStore keys({{cppbackend::KeyStore::DEFAULT_PLATFORM, keyOne}});
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&keys, &done, &failures, &keyOne, &keyTwo]() {
+            const unsigned char plaintext[] = "1600000000";
+            unsigned char cipherText[cppbackend::AES128Block::BLOCK_SIZE];
+            while (!done)
+            {
+                const auto cipher = keys.getCipher(2);
+                cipher->encrypt(plaintext, sizeof(plaintext) - 1, cipherText);
+                if (cipher->getKey() != keyOne && cipher->getKey() != keyTwo)
+                {
+                    ++failures;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < LOOKUPS_PER_THREAD; ++i)
+    {
+        keys.replace({{cppbackend::KeyStore::DEFAULT_PLATFORM, i % 2 == 0 ? keyTwo : keyOne}});
+    }
+    done = true;
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    REQUIRE(failures == 0);
+    REQUIRE(keys.getGeneration() == LOOKUPS_PER_THREAD + 1);
+}
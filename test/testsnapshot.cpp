@@ -0,0 +1,337 @@
+#include "../src/backend.h"
+#include "../src/encoder.h"
+#include "../src/snapshot.h"
+#include "common.h"
+
+#include "catch.hpp"
+#include "sqlite3.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using cppbackend::Snapshot;
+
+namespace {
+    // A writable copy of the fixture, so tests can change it under a snapshot
+    std::string copyDatabase(const std::string& path)
+    {
+        std::remove(path.c_str());
+        std::remove(Snapshot::defaultPath(path).c_str());
+        cppbackend::Repository::createIndexes(DB_PATH, path);
+        return path;
+    }
+
+    void execute(const std::string& path, const std::string& sql)
+    {
+        sqlite3* database = nullptr;
+        REQUIRE(sqlite3_open(path.c_str(), &database) == SQLITE_OK);
+        REQUIRE(sqlite3_exec(database, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+        sqlite3_close(database);
+    }
+
+    const std::vector<std::string> QNAMES{
+            "1.canberra.testnet", "2.canberra.testnet", "3.canberra.testnet", "5.hobart.testnet",
+            "2.notarealdomain.testnet", "2.canberra.oc.testnet", "1.hobart.oc.testnet", "9.canberra.testnet"};
+}
+
+TEST_CASE("Snapshot matches the repository", "[Snapshot]")
+{
+    const auto path = copyDatabase("/tmp/testcppbackend_snapshot.db");
+    const cppbackend::Repository repository(path);
+    const auto snapshot = Snapshot::build(path, repository);
+    REQUIRE_FALSE(snapshot->isMapped());
+
+    std::size_t records = 0;
+    std::set<std::string> domains{};
+    repository.forEachRecord([&](std::string_view domain, int platform, std::string_view txt, int ttl) {
+        ++records;
+        domains.emplace(domain);
+        std::string_view answer{};
+        int snapshotTTL = 0;
+        REQUIRE(snapshot->find(domain, platform, answer, snapshotTTL));
+        REQUIRE(answer == cppbackend::Encoder::toBase64(std::string(txt)));
+        REQUIRE(snapshotTTL == ttl);
+    });
+    REQUIRE(records > 0);
+    REQUIRE(snapshot->getRecordCount() == records);
+    REQUIRE(snapshot->getDomainCount() == domains.size());
+
+    std::string_view answer{};
+    int ttl = 0;
+    REQUIRE(snapshot->find("canberra", 2, answer, ttl));
+    REQUIRE(answer == "W2JvYl0gMzM=");
+    REQUIRE(ttl == Snapshot::NO_TTL);
+    REQUIRE(snapshot->find("CanBerra", 2, answer, ttl));
+    REQUIRE(answer == "W2JvYl0gMzM=");
+    REQUIRE_FALSE(snapshot->find("canberra", 9, answer, ttl));
+    REQUIRE_FALSE(snapshot->find("canbErrb", 2, answer, ttl));
+    REQUIRE_FALSE(snapshot->find("canberr", 2, answer, ttl));
+    REQUIRE_FALSE(snapshot->find("canberraa", 2, answer, ttl));
+    REQUIRE_FALSE(snapshot->find("", 2, answer, ttl));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Snapshot leaves out records that can't be asked for", "[Snapshot]")
+{
+    const auto path = copyDatabase("/tmp/testcppbackend_snapshot.db");
+    const cppbackend::Repository repository(path);
+    const auto before = Snapshot::build(path, repository);
+    execute(path, "INSERT INTO platform (domain_id, nbr, txt) SELECT id, 7, 'seven' FROM domain WHERE name = 'canberra'");
+    // Longer than any DNS name
+    const std::string longName(300, 'a');
+    execute(path, "INSERT INTO domain (id, name) VALUES (1000, '" + longName + "')");
+    execute(path, "INSERT INTO platform (domain_id, nbr, txt) VALUES (1000, 1, 'long')");
+
+    const auto snapshot = Snapshot::build(path, repository);
+    REQUIRE(snapshot->getRecordCount() == before->getRecordCount());
+    REQUIRE(snapshot->getDomainCount() == before->getDomainCount());
+    std::string_view answer{};
+    int ttl = 0;
+    REQUIRE_FALSE(snapshot->find("canberra", 7, answer, ttl));
+    REQUIRE_FALSE(snapshot->find(longName, 1, answer, ttl));
+    REQUIRE(snapshot->find("canberra", 2, answer, ttl));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Snapshot keeps one of records that only differ in case", "[Snapshot]")
+{
+    const auto path = copyDatabase("/tmp/testcppbackend_snapshot.db");
+    const cppbackend::Repository repository(path);
+    const auto before = Snapshot::build(path, repository);
+    execute(path, "INSERT INTO domain (id, name) VALUES (1000, 'CanBerra')");
+    execute(path, "INSERT INTO platform (domain_id, nbr, txt) VALUES (1000, 2, 'upper'), (1000, 5, 'five')");
+
+    // Every platform of canberra has a record already
+    const auto snapshot = Snapshot::build(path, repository);
+    REQUIRE(snapshot->getDomainCount() == before->getDomainCount());
+    REQUIRE(snapshot->getRecordCount() == before->getRecordCount());
+    std::string_view answer{};
+    int ttl = 0;
+    REQUIRE(snapshot->find("CANBERRA", 2, answer, ttl));
+    REQUIRE(answer == "W2JvYl0gMzM=");
+    REQUIRE(snapshot->find("canberra", 5, answer, ttl));
+    REQUIRE(answer == cppbackend::Encoder::toBase64("[green light] 1234"));
+
+    // So the backend still starts on such a database
+    cppbackend::SnapshotOptions snapshotOptions{};
+    snapshotOptions.enabled = true;
+    const cppbackend::Backend backend(path, {}, {}, snapshotOptions);
+    backend.waitForSnapshot();
+    REQUIRE(backend.getSnapshot() != nullptr);
+    std::string output{};
+    REQUIRE(backend.performQuery("2.canberra.testnet", output));
+    REQUIRE(output == "W2JvYl0gMzM=");
+
+    std::remove(Snapshot::defaultPath(path).c_str());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Snapshot file", "[Snapshot]")
+{
+    const auto path = copyDatabase("/tmp/testcppbackend_snapshot.db");
+    const auto snapshotPath = Snapshot::defaultPath(path);
+
+    SECTION("Written on first open, mapped on the next") {
+        const cppbackend::Repository repository(path);
+        const auto built = Snapshot::open(path, repository, snapshotPath);
+        REQUIRE_FALSE(built->isMapped());
+
+        const auto mapped = Snapshot::open(path, repository, snapshotPath);
+        REQUIRE(mapped->isMapped());
+        REQUIRE(mapped->getSize() == built->getSize());
+        REQUIRE(mapped->getRecordCount() == built->getRecordCount());
+
+        std::string_view answer{};
+        int ttl = 0;
+        REQUIRE(mapped->find("canberra", 2, answer, ttl));
+        REQUIRE(answer == "W2JvYl0gMzM=");
+    }
+
+    SECTION("Rebuilt when the database changes") {
+        {
+            const cppbackend::Repository repository(path);
+            REQUIRE_FALSE(Snapshot::open(path, repository, snapshotPath)->isMapped());
+        }
+        execute(path, "UPDATE platform SET txt = 'changed' WHERE nbr = 2 AND domain_id = "
+                      "(SELECT id FROM domain WHERE name = 'canberra')");
+        REQUIRE_THROWS_AS(Snapshot::load(snapshotPath, path), std::runtime_error);
+
+        const cppbackend::Repository repository(path);
+        const auto rebuilt = Snapshot::open(path, repository, snapshotPath);
+        REQUIRE_FALSE(rebuilt->isMapped());
+        std::string_view answer{};
+        int ttl = 0;
+        REQUIRE(rebuilt->find("canberra", 2, answer, ttl));
+        REQUIRE(answer == cppbackend::Encoder::toBase64("changed"));
+        REQUIRE(Snapshot::load(snapshotPath, path)->isMapped());
+    }
+
+    SECTION("Damaged files are rejected") {
+        const cppbackend::Repository repository(path);
+        const auto snapshot = Snapshot::build(path, repository);
+
+        // 72 is in the hash seed, which only the checksum guards
+        for (const std::size_t offset : {std::size_t{0}, std::size_t{12}, std::size_t{72}, snapshot->getSize() - 1})
+        {
+            snapshot->save(snapshotPath);
+            {
+                std::fstream file(snapshotPath, std::ios::in | std::ios::out | std::ios::binary);
+                file.seekg(static_cast<std::streamoff>(offset));
+                const char byte = static_cast<char>(file.get() ^ 0x20);
+                file.seekp(static_cast<std::streamoff>(offset));
+                file.put(byte);
+            }
+            CAPTURE(offset);
+            REQUIRE_THROWS_AS(Snapshot::load(snapshotPath, path), std::runtime_error);
+        }
+
+        // Too short to hold a header
+        std::ofstream(snapshotPath, std::ios::trunc) << "CPPBSNAP";
+        REQUIRE_THROWS_AS(Snapshot::load(snapshotPath, path), std::runtime_error);
+        REQUIRE_THROWS_AS(Snapshot::load("/this/path/does/not/exist.snapshot", path), std::runtime_error);
+
+        // open() replaces it
+        REQUIRE_FALSE(Snapshot::open(path, repository, snapshotPath)->isMapped());
+        REQUIRE(Snapshot::load(snapshotPath, path)->isMapped());
+    }
+
+    SECTION("Saved whole when processes save at the same time") {
+        // As PowerDNS does with one co-process per backend
+        const cppbackend::Repository repository(path);
+        const auto snapshot = Snapshot::build(path, repository);
+        std::vector<pid_t> children{};
+        for (int i = 0; i < 4; ++i)
+        {
+            const auto child = ::fork();
+            REQUIRE(child >= 0);
+            if (child == 0)
+            {
+                for (int save = 0; save < 50; ++save)
+                {
+                    snapshot->save(snapshotPath);
+                }
+                ::_exit(0);
+            }
+            children.push_back(child);
+        }
+        for (const auto child : children)
+        {
+            int status = 0;
+            REQUIRE(::waitpid(child, &status, 0) == child);
+            REQUIRE(WIFEXITED(status));
+            REQUIRE(WEXITSTATUS(status) == 0);
+        }
+        REQUIRE(Snapshot::load(snapshotPath, path)->isMapped());
+    }
+
+    SECTION("Served from memory when the file can't be written") {
+        const cppbackend::Repository repository(path);
+        const auto snapshot = Snapshot::open(path, repository, "/this/path/does/not/exist.snapshot");
+        REQUIRE(snapshot->getRecordCount() > 0);
+    }
+
+    std::remove(snapshotPath.c_str());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Backend answers from the snapshot", "[Snapshot]")
+{
+    const auto path = copyDatabase("/tmp/testcppbackend_snapshot.db");
+    execute(path, "ALTER TABLE platform ADD COLUMN ttl INTEGER; "
+                  "UPDATE platform SET ttl = 60 WHERE nbr = 1");
+
+    cppbackend::SnapshotOptions snapshotOptions{};
+    snapshotOptions.enabled = true;
+    const cppbackend::Backend withSnapshot(path, {}, {}, snapshotOptions);
+    const cppbackend::Backend withoutSnapshot(path);
+    withSnapshot.waitForSnapshot();
+    REQUIRE(withSnapshot.getSnapshot() != nullptr);
+    REQUIRE(withoutSnapshot.getSnapshot() == nullptr);
+
+    for (const auto& qname : QNAMES)
+    {
+        CAPTURE(qname);
+        std::string expected{};
+        std::string actual{};
+        int expectedTTL = 0;
+        int actualTTL = 0;
+        const auto found = withoutSnapshot.performQuery(qname, expected, expectedTTL);
+        REQUIRE(withSnapshot.performQuery(qname, actual, actualTTL) == found);
+        if (found)
+        {
+            REQUIRE(actualTTL == expectedTTL);
+            // Epoch tokens change every second, so only compare stored answers
+            if (!withSnapshot.isEpochQuery(qname))
+            {
+                REQUIRE(actual == expected);
+            }
+        }
+    }
+
+    std::remove(Snapshot::defaultPath(path).c_str());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Backend builds the snapshot off the startup path", "[Snapshot]")
+{
+    const auto path = copyDatabase("/tmp/testcppbackend_snapshot.db");
+    cppbackend::SnapshotOptions snapshotOptions{};
+    snapshotOptions.enabled = true;
+
+    {
+        // Without a snapshot file the backend answers from SQLite until it is built
+        const cppbackend::Backend backend(path, {}, {}, snapshotOptions);
+        std::string output{};
+        REQUIRE(backend.performQuery("2.canberra.testnet", output));
+        REQUIRE(output == "W2JvYl0gMzM=");
+        backend.waitForSnapshot();
+        REQUIRE(backend.getSnapshot() != nullptr);
+        REQUIRE_FALSE(backend.getSnapshot()->isMapped());
+    }
+
+    // The next start maps the file the build saved before it returns
+    const cppbackend::Backend backend(path, {}, {}, snapshotOptions);
+    REQUIRE(backend.getSnapshot() != nullptr);
+    REQUIRE(backend.getSnapshot()->isMapped());
+
+    std::remove(Snapshot::defaultPath(path).c_str());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Backend reloads the snapshot only when the database changed", "[Snapshot]")
+{
+    const auto path = copyDatabase("/tmp/testcppbackend_snapshot.db");
+    cppbackend::SnapshotOptions snapshotOptions{};
+    snapshotOptions.enabled = true;
+    cppbackend::Backend backend(path, {}, {}, snapshotOptions);
+    backend.waitForSnapshot();
+
+    std::weak_ptr<const Snapshot> first = backend.getSnapshot();
+    REQUIRE_FALSE(first.expired());
+    backend.reloadSnapshot();
+    REQUIRE(backend.getSnapshot() == first.lock());
+
+    execute(path, "UPDATE platform SET txt = 'changed' WHERE nbr = 2 AND domain_id = "
+                  "(SELECT id FROM domain WHERE name = 'canberra')");
+    backend.reloadSnapshot();
+    backend.waitForSnapshot();
+    REQUIRE(backend.getSnapshot() != nullptr);
+    // Nothing holds the replaced one any more, so it is gone
+    REQUIRE(first.expired());
+
+    std::string output{};
+    REQUIRE(backend.performQuery("2.canberra.testnet", output));
+    REQUIRE(output == cppbackend::Encoder::toBase64("changed"));
+
+    std::remove(Snapshot::defaultPath(path).c_str());
+    std::remove(path.c_str());
+}
@@ -0,0 +1,203 @@
+#include "../src/backend.h"
+#include "../src/stats.h"
+#include "../src/statsserver.h"
+#include "common.h"
+
+#include "catch.hpp"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using cppbackend::LatencyHistogram;
+using cppbackend::Operation;
+using cppbackend::QueryClass;
+using cppbackend::QueryResult;
+using cppbackend::Stats;
+using namespace std::chrono_literals;
+
+namespace {
+    // Everything the server sends before closing the connection
+    std::string scrape(const std::string& path)
+    {
+        const int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+        if (::connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            ::close(client);
+            return {};
+        }
+
+        std::string page{};
+        char buffer[4096];
+        for (auto received = ::recv(client, buffer, sizeof(buffer), 0); received > 0;
+             received = ::recv(client, buffer, sizeof(buffer), 0))
+        {
+            page.append(buffer, static_cast<std::size_t>(received));
+        }
+        ::close(client);
+        return page;
+    }
+}
+
+TEST_CASE("Histogram buckets", "[Stats]")
+{
+    SECTION("Small values are exact") {
+        for (std::uint64_t value = 0; value < LatencyHistogram::SUB_BUCKETS; ++value)
+        {
+            REQUIRE(LatencyHistogram::bucketLowerBound(LatencyHistogram::bucketIndex(value)) == value);
+        }
+    }
+
+    SECTION("Larger values are within one sub-bucket") {
+        for (std::uint64_t value = 1; value < (1ull << LatencyHistogram::MAX_BITS); value = value * 3 + 1)
+        {
+            const auto index = LatencyHistogram::bucketIndex(value);
+            const auto lower = LatencyHistogram::bucketLowerBound(index);
+            REQUIRE(lower <= value);
+            REQUIRE(value - lower <= value / LatencyHistogram::SUB_BUCKETS);
+            REQUIRE(LatencyHistogram::bucketLowerBound(index + 1) > value);
+        }
+    }
+
+    SECTION("Huge values land in the last bucket") {
+        REQUIRE(LatencyHistogram::bucketIndex(~0ull) == LatencyHistogram::BUCKETS - 1);
+        REQUIRE(LatencyHistogram::bucketIndex(1ull << LatencyHistogram::MAX_BITS) == LatencyHistogram::BUCKETS - 1);
+    }
+}
+
+TEST_CASE("Histogram quantiles", "[Stats]")
+{
+    LatencyHistogram histogram;
+    REQUIRE(histogram.getQuantile(0.5) == 0ns);
+
+    for (int i = 1; i <= 1000; ++i)
+    {
+        histogram.record(std::chrono::microseconds(i));
+    }
+
+    REQUIRE(histogram.getCount() == 1000);
+    REQUIRE(histogram.getSum() == std::chrono::microseconds(500500));
+
+    const auto median = histogram.getQuantile(0.5);
+    REQUIRE(median <= 500us);
+    REQUIRE(median >= 500us - 500us / LatencyHistogram::SUB_BUCKETS);
+    const auto p99 = histogram.getQuantile(0.99);
+    REQUIRE(p99 <= 990us);
+    REQUIRE(p99 >= 990us - 990us / LatencyHistogram::SUB_BUCKETS);
+    // The lowest bucket is reported by its lower bound, 992 ns
+    REQUIRE(histogram.getQuantile(0.0) <= 1us);
+    REQUIRE(histogram.getQuantile(0.0) >= 1000ns - 1000ns / LatencyHistogram::SUB_BUCKETS);
+}
+
+TEST_CASE("Prometheus text", "[Stats]")
+{
+    Stats stats;
+    stats.recordQuery(1, QueryClass::HIT, QueryResult::DATA, 20us);
+    stats.recordQuery(3, QueryClass::MALFORMED, QueryResult::FAIL, 5us);
+    stats.recordQuery(3, QueryClass::MALFORMED, QueryResult::FAIL, 5us);
+    stats.recordOperation(Operation::LOOKUP, 10us);
+
+    const auto text = stats.toPrometheus();
+    REQUIRE(text.find("# TYPE cppbackend_query_duration_seconds summary\n") != std::string::npos);
+    REQUIRE(text.find("cppbackend_query_duration_seconds_count{class=\"hit\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("cppbackend_query_duration_seconds_count{class=\"malformed\"} 2\n") != std::string::npos);
+    REQUIRE(text.find("cppbackend_query_duration_seconds{class=\"hit\",quantile=\"0.5\"} 0.00001") != std::string::npos);
+    REQUIRE(text.find("cppbackend_operation_duration_seconds_count{operation=\"lookup\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("cppbackend_queries_total{abi=\"1\",result=\"data\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("cppbackend_queries_total{abi=\"3\",result=\"fail\"} 2\n") != std::string::npos);
+    REQUIRE(text.find("cppbackend_queries_total{abi=\"2\",result=\"end\"} 0\n") != std::string::npos);
+    REQUIRE(text.find("cppbackend_answer_cache_events_total{event=\"eviction\"} 0\n") != std::string::npos);
+    REQUIRE(text.find("cppbackend_answer_cache_hit_ratio 0.000000\n") != std::string::npos);
+    REQUIRE(text.back() == '\n');
+}
+
+TEST_CASE("Backend records query classes", "[Stats]")
+{
+    cppbackend::Backend backend(DB_PATH);
+    std::istringstream handshakeStream("HELO\t2");
+    REQUIRE(backend.performHandshake(handshakeStream).getSuccess());
+
+    std::istringstream queryStream(
+            "Q\t2.canberra.testnet\tIN\tTXT\t1\t192.168.0.1\t10.1.1.1\n"
+            "Q\t2.canberra.oc.testnet\tIN\tTXT\t2\t192.168.0.1\t10.1.1.1\n"
+            "Q\t2.invalid.testnet\tIN\tTXT\t3\t192.168.0.1\t10.1.1.1\n"
+            "Q\t2.canberra.testnet\tIN\tSOA\t4\t192.168.0.1\t10.1.1.1\n"
+            "Q\t2.canberra.testnet\tIN\tTXT\t5\n");
+    std::ostringstream output;
+    REQUIRE(backend.readFromInput(queryStream, output).size() == 1);
+    REQUIRE(cppbackend::Backend::split(output.str(), '\n').size() == 8);
+
+    const auto& stats = backend.getStats();
+    REQUIRE(stats.getQueryLatency(QueryClass::HIT).getCount() == 1);
+    REQUIRE(stats.getQueryLatency(QueryClass::EPOCH).getCount() == 1);
+    REQUIRE(stats.getQueryLatency(QueryClass::MISS).getCount() == 2);
+    REQUIRE(stats.getQueryLatency(QueryClass::MALFORMED).getCount() == 1);
+    REQUIRE(stats.getQueryCount(2, QueryResult::DATA) == 2);
+    REQUIRE(stats.getQueryCount(2, QueryResult::END) == 2);
+    REQUIRE(stats.getQueryCount(2, QueryResult::FAIL) == 1);
+    REQUIRE(stats.getQueryCount(1, QueryResult::DATA) == 0);
+    // The SOA query never reaches the database
+    REQUIRE(stats.getOperationLatency(Operation::LOOKUP).getCount() == 3);
+    REQUIRE(stats.getOperationLatency(Operation::ENCRYPT).getCount() == 1);
+}
+
+TEST_CASE("Stats server", "[Stats]")
+{
+    const std::string path = "/tmp/cppbackend_teststats.sock";
+
+    SECTION("Serves one page per connection") {
+        int renders = 0;
+        {
+            cppbackend::StatsServer server(path, [&renders] { return "page " + std::to_string(++renders) + "\n"; });
+            REQUIRE(scrape(path) == "page 1\n");
+            REQUIRE(scrape(path) == "page 2\n");
+        }
+        // The socket is removed with the server
+        REQUIRE(::access(path.c_str(), F_OK) != 0);
+    }
+
+    SECTION("Concurrent recording while scraping") {
+        Stats stats;
+        cppbackend::StatsServer server(path, [&stats] { return stats.toPrometheus(); });
+
+        std::vector<std::thread> threads{};
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&stats]() {
+                for (int i = 0; i < 10000; ++i)
+                {
+                    stats.recordQuery(3, QueryClass::HIT, QueryResult::DATA, std::chrono::nanoseconds(i));
+                }
+            });
+        }
+        std::size_t scraped = 0;
+        for (int i = 0; i < 5; ++i)
+        {
+            scraped += scrape(path).size();
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        REQUIRE(scraped > 0);
+        REQUIRE(stats.getQueryCount(3, QueryResult::DATA) == 40000);
+        REQUIRE(scrape(path).find("cppbackend_queries_total{abi=\"3\",result=\"data\"} 40000\n") != std::string::npos);
+    }
+
+    SECTION("Bad path") {
+        REQUIRE_THROWS_AS(cppbackend::StatsServer("/nonexistent/dir/stats.sock", [] { return std::string{}; }),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(cppbackend::StatsServer(std::string(200, 'x'), [] { return std::string{}; }),
+                          std::runtime_error);
+    }
+}
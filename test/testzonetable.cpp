@@ -0,0 +1,147 @@
+#include "../src/zonetable.h"
+
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using cppbackend::ZoneTable;
+
+TEST_CASE("Zone table finds the longest zone", "[ZoneTable]")
+{
+    ZoneTable table{};
+    table.add("testnet", 1);
+    table.add("oc.testnet", 2);
+    table.add("example.org.", 3);
+    REQUIRE(table.getZoneCount() == 3);
+
+    SECTION("Longest match wins")
+    {
+        const auto plain = table.match("2.canberra.testnet");
+        REQUIRE(plain);
+        REQUIRE(plain.value == 1);
+        REQUIRE(plain.prefixLength == 10);
+
+        const auto epoch = table.match("2.canberra.oc.testnet");
+        REQUIRE(epoch.value == 2);
+        REQUIRE(epoch.prefixLength == 10);
+
+        // "oc" is not a zone on its own
+        REQUIRE(table.match("2.canberra.ob.testnet").value == 1);
+        REQUIRE(table.match("example.org").value == 3);
+        REQUIRE(table.match("example.org").prefixLength == 0);
+    }
+
+    SECTION("Shorter zones leaving enough in front")
+    {
+        const auto fallback = table.match("1.oc.testnet", 4);
+        REQUIRE(fallback.value == 1);
+        REQUIRE(fallback.prefixLength == 4);
+        REQUIRE(table.match("2.canberra.oc.testnet", 10).value == 2);
+        REQUIRE(table.match("2.canberra.oc.testnet", 11).value == 1);
+        REQUIRE_FALSE(table.match("oc.testnet", 3));
+    }
+
+    SECTION("Case is ignored")
+    {
+        REQUIRE(table.match("2.Canberra.OC.TestNet").value == 2);
+        REQUIRE(table.match("WWW.EXAMPLE.ORG").value == 3);
+    }
+
+    SECTION("Names outside every zone")
+    {
+        for (const auto* qname : {"", ".", "testnet.", "2.canberra.com", "2.canberratestnet", "org", "www.org",
+                                  "2.canberra.testnet.au", "mytestnet"})
+        {
+            CAPTURE(qname);
+            REQUIRE_FALSE(table.match(qname));
+        }
+    }
+
+    SECTION("Empty labels end the walk")
+    {
+        const auto match = table.match("2..testnet");
+        REQUIRE(match.value == 1);
+        REQUIRE(match.prefixLength == 2);
+        REQUIRE_FALSE(table.match(".oc..testnet").value == 2);
+    }
+}
+
+TEST_CASE("Zone table holds many zones", "[ZoneTable]")
+{
+    // Enough to grow the edge table several times, sharing labels
+    ZoneTable table{};
+    for (std::uint32_t i = 0; i < 1000; ++i)
+    {
+        table.add("zone" + std::to_string(i) + ".example.net", i);
+    }
+    REQUIRE(table.getZoneCount() == 1000);
+    for (std::uint32_t i = 0; i < 1000; ++i)
+    {
+        REQUIRE(table.match("2.domain.zone" + std::to_string(i) + ".example.net").value == i);
+    }
+    REQUIRE_FALSE(table.match("2.domain.zone1000.example.net"));
+    REQUIRE_FALSE(table.match("example.net"));
+}
+
+TEST_CASE("Zone table rejects bad zones", "[ZoneTable]")
+{
+    ZoneTable table{};
+    table.add("testnet", 1);
+
+    const std::string longLabel(64, 'a');
+    for (const auto& zone : {std::string{}, std::string{"."}, std::string{"a..b"}, std::string{".testnet"},
+                             std::string{"testnet.."}, longLabel})
+    {
+        CAPTURE(zone);
+        REQUIRE_THROWS_AS(table.add(zone, 2), std::invalid_argument);
+    }
+    REQUIRE_THROWS_AS(table.add("TestNet", 2), std::invalid_argument);
+    REQUIRE_THROWS_AS(table.add("other", ZoneTable::NO_ZONE), std::invalid_argument);
+    REQUIRE(table.getZoneCount() == 1);
+}
+
+TEST_CASE("Zone configuration", "[ZoneTable]")
+{
+    SECTION("Command line zones")
+    {
+        const auto zone = ZoneTable::parseZone("tok.example.org:epoch");
+        REQUIRE(zone.name == "tok.example.org");
+        REQUIRE(zone.handler == "epoch");
+        REQUIRE_THROWS_AS(ZoneTable::parseZone("example.org"), std::invalid_argument);
+        REQUIRE_THROWS_AS(ZoneTable::parseZone(":txt"), std::invalid_argument);
+        REQUIRE_THROWS_AS(ZoneTable::parseZone("example.org:"), std::invalid_argument);
+    }
+
+    SECTION("Zone file")
+    {
+        const std::string path{"/tmp/testcppbackend_zones.conf"};
+        {
+            std::ofstream file(path, std::ios::trunc);
+            file << "# zone handler\n\ntestnet txt\r\n  oc.testnet\tepoch\n";
+        }
+        const auto zones = ZoneTable::readFile(path);
+        REQUIRE(zones.size() == 2);
+        REQUIRE(zones[0].name == "testnet");
+        REQUIRE(zones[0].handler == "txt");
+        REQUIRE(zones[1].name == "oc.testnet");
+        REQUIRE(zones[1].handler == "epoch");
+        REQUIRE(zones[1].source == path + ":4");
+        REQUIRE(ZoneTable::parseZone("testnet:txt").source.empty());
+
+        for (const auto* contents : {"testnet\n", "testnet txt extra\n"})
+        {
+            CAPTURE(contents);
+            {
+                std::ofstream file(path, std::ios::trunc);
+                file << contents;
+            }
+            REQUIRE_THROWS_AS(ZoneTable::readFile(path), std::invalid_argument);
+        }
+        std::remove(path.c_str());
+
+        REQUIRE_THROWS_AS(ZoneTable::readFile("/this/path/does/not/exist.conf"), std::runtime_error);
+    }
+}